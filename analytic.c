@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "analytic.h"
+#include "debug.h"
+
+#define MACSIM_ANALYTIC_TOLERANCE 1e-13 //Precisión relativa de las ecuaciones de tráfico
+#define MACSIM_ANALYTIC_MAX_SWEEPS 1000000 //Iteraciones máximas de las ecuaciones de tráfico
+
+/* Estructuras */
+struct macsim_analytic_route_t {
+	int to; //Índice de la estación destino
+	double prob; //Probabilidad de ir a ella
+};
+
+struct macsim_analytic_station_t {
+	struct macsim_station_t *station; //Estación de la simulación
+	double service; //Tiempo medio de servicio (o de retardo) en ms
+	int delay; //Estación de retardo (servidores infinitos), p.ej. tiempo de reflexión
+	double arrival_rate; //Llegadas externas en clientes/ms (redes abiertas)
+	struct macsim_analytic_route_t *routes; //Probabilidades de encaminamiento a la salida
+	int route_count, route_size;
+	double visits; //Razón de visitas (cerradas) o tasa de llegadas total (abiertas)
+};
+
+/* Modelo analítico de una red de colas de forma producto definido sobre estaciones
+ * creadas con macsim_station_create. Todas las estaciones tienen un único servidor FCFS
+ * con servicio exponencial, salvo las de retardo. */
+struct macsim_analytic_t {
+	struct macsim_analytic_station_t *stations;
+	int count, size;
+	int *index; //Posición + 1 de cada estación en el modelo, indexado por el id de la estación
+	int index_size;
+};
+
+
+/* Prototipos */
+static int macsim_analytic_index(struct macsim_analytic_t *model, struct macsim_station_t *station);
+static void macsim_analytic_traffic(struct macsim_analytic_t *model, int closed);
+static void macsim_analytic_results(struct macsim_analytic_t *model, double x, double *response, double *mean, struct macsim_result_t *results);
+
+
+/* Funciones */
+/* Crea un modelo analítico vacío */
+struct macsim_analytic_t * macsim_analytic_create(){
+	struct macsim_analytic_t *model = (struct macsim_analytic_t *) calloc(1, sizeof(struct macsim_analytic_t));
+	if(!model)
+		fatal("%s: out of memory", __func__);
+	return model;
+}
+
+
+/* Libera el modelo. Las estaciones son de la simulación y no se tocan. */
+void macsim_analytic_free(struct macsim_analytic_t *model){
+	int i;
+	for(i = 0; i < model->count; i++)
+		free(model->stations[i].routes);
+	free(model->stations);
+	free(model->index);
+	free(model);
+}
+
+
+/* Función privada que añade una estación al modelo */
+static void macsim_analytic_add(struct macsim_analytic_t *model, struct macsim_station_t *station, double service_ms, int delay){
+	struct macsim_analytic_station_t *s;
+	int size;
+
+	if(!station)
+		fatal("%s: unknown station", __func__);
+	if(service_ms <= 0)
+		fatal("%s: service time must be positive", __func__);
+	if(station->id < model->index_size && model->index[station->id])
+		fatal("%s: station \"%s\" already in the model", __func__, station->name);
+
+	/* Índice por id de estación */
+	if(station->id >= model->index_size){
+		size = model->index_size ? model->index_size : 64;
+		while(size <= station->id)
+			size *= 2;
+		model->index = (int *) realloc(model->index, size * sizeof(int));
+		if(!model->index)
+			fatal("%s: out of memory", __func__);
+		memset(model->index + model->index_size, 0, (size - model->index_size) * sizeof(int));
+		model->index_size = size;
+	}
+
+	if(model->count == model->size){
+		model->size = model->size ? model->size * 2 : 16;
+		model->stations = (struct macsim_analytic_station_t *) realloc(model->stations, model->size * sizeof(struct macsim_analytic_station_t));
+		if(!model->stations)
+			fatal("%s: out of memory", __func__);
+	}
+	s = &model->stations[model->count];
+	memset(s, 0, sizeof(*s));
+	s->station = station;
+	s->service = service_ms;
+	s->delay = delay;
+	model->index[station->id] = ++model->count;
+}
+
+
+/* Añade al modelo una estación con un servidor y tiempo medio de servicio \service_ms.
+ * En las redes cerradas la primera estación añadida es la de referencia. */
+void macsim_analytic_station(struct macsim_analytic_t *model, struct macsim_station_t *station, double service_ms){
+	macsim_analytic_add(model, station, service_ms, 0);
+}
+
+
+/* Añade al modelo una estación de retardo puro (tiempo de reflexión) de media \delay_ms */
+void macsim_analytic_delay(struct macsim_analytic_t *model, struct macsim_station_t *station, double delay_ms){
+	macsim_analytic_add(model, station, delay_ms, 1);
+}
+
+
+/* Función privada que devuelve la posición de la estación en el modelo */
+static int macsim_analytic_index(struct macsim_analytic_t *model, struct macsim_station_t *station){
+	if(!station || station->id >= model->index_size || !model->index[station->id])
+		fatal("%s: station not in the model", __func__);
+	return model->index[station->id] - 1;
+}
+
+
+/* Un cliente que sale de \from va a \to con probabilidad \prob.
+ * En las redes abiertas la probabilidad que falte hasta 1 es la de abandonar la red. */
+void macsim_analytic_route(struct macsim_analytic_t *model, struct macsim_station_t *from, struct macsim_station_t *to, double prob){
+	struct macsim_analytic_station_t *s = &model->stations[macsim_analytic_index(model, from)];
+
+	if(prob < 0 || prob > 1)
+		fatal("%s: invalid probability %f", __func__, prob);
+	if(s->route_count == s->route_size){
+		s->route_size = s->route_size ? s->route_size * 2 : 4;
+		s->routes = (struct macsim_analytic_route_t *) realloc(s->routes, s->route_size * sizeof(struct macsim_analytic_route_t));
+		if(!s->routes)
+			fatal("%s: out of memory", __func__);
+	}
+	s->routes[s->route_count].to = macsim_analytic_index(model, to);
+	s->routes[s->route_count].prob = prob;
+	s->route_count++;
+}
+
+
+/* Llegadas externas de Poisson a \station con tiempo medio entre llegadas \interarrival_ms */
+void macsim_analytic_arrivals(struct macsim_analytic_t *model, struct macsim_station_t *station, double interarrival_ms){
+	if(interarrival_ms <= 0)
+		fatal("%s: interarrival time must be positive", __func__);
+	model->stations[macsim_analytic_index(model, station)].arrival_rate = 1.0 / interarrival_ms;
+}
+
+
+/* Devuelve el número de estaciones del modelo, que es el tamaño que deben tener los vectores de resultados */
+int macsim_analytic_count(struct macsim_analytic_t *model){
+	return model->count;
+}
+
+
+/* Función privada que resuelve las ecuaciones de tráfico por Gauss-Seidel sobre las rutas.
+ * Abiertas: visits = tasa total de llegadas. Cerradas: razón de visitas respecto de la
+ * estación de referencia (la primera), que vale 1. */
+static void macsim_analytic_traffic(struct macsim_analytic_t *model, int closed){
+	struct macsim_analytic_station_t *s;
+	int *in_start, *in_from, i, j, r, sweep;
+	double *in_prob, sum, value, delta, max, total;
+
+	/* Rutas de entrada de cada estación en formato CSR */
+	in_start = (int *) calloc(model->count + 1, sizeof(int));
+	if(!in_start)
+		fatal("%s: out of memory", __func__);
+	total = 0;
+	for(i = 0; i < model->count; i++){
+		s = &model->stations[i];
+		sum = 0;
+		for(r = 0; r < s->route_count; r++){
+			in_start[s->routes[r].to + 1]++;
+			sum += s->routes[r].prob;
+		}
+		if(sum > 1 + 1e-9)
+			fatal("%s: routing probabilities of \"%s\" add up to %f", __func__, s->station->name, sum);
+		if(closed && sum < 1 - 1e-9)
+			fatal("%s: clients leave the closed network at \"%s\"", __func__, s->station->name);
+		total += s->route_count;
+	}
+	for(i = 0; i < model->count; i++)
+		in_start[i + 1] += in_start[i];
+	in_from = (int *) malloc((total + 1) * sizeof(int));
+	in_prob = (double *) malloc((total + 1) * sizeof(double));
+	if(!in_from || !in_prob)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < model->count; i++){
+		s = &model->stations[i];
+		for(r = 0; r < s->route_count; r++){
+			j = s->routes[r].to;
+			in_from[in_start[j]] = i;
+			in_prob[in_start[j]] = s->routes[r].prob;
+			in_start[j]++;
+		}
+	}
+	for(i = model->count; i > 0; i--)
+		in_start[i] = in_start[i - 1];
+	in_start[0] = 0;
+
+	/* Iteración */
+	for(i = 0; i < model->count; i++)
+		model->stations[i].visits = closed ? !i : model->stations[i].arrival_rate;
+	for(sweep = 0; sweep < MACSIM_ANALYTIC_MAX_SWEEPS; sweep++){
+		delta = max = 0;
+		for(j = closed ? 1 : 0; j < model->count; j++){
+			value = closed ? 0 : model->stations[j].arrival_rate;
+			for(r = in_start[j]; r < in_start[j + 1]; r++)
+				value += model->stations[in_from[r]].visits * in_prob[r];
+			delta = fmax(delta, fabs(value - model->stations[j].visits));
+			max = fmax(max, value);
+			model->stations[j].visits = value;
+		}
+		if(delta <= MACSIM_ANALYTIC_TOLERANCE * fmax(max, 1))
+			break;
+	}
+	if(sweep == MACSIM_ANALYTIC_MAX_SWEEPS)
+		fatal("%s: traffic equations do not converge (unstable routing?)", __func__);
+
+	free(in_start);
+	free(in_from);
+	free(in_prob);
+}
+
+
+/* Función privada que rellena los resultados a partir de la productividad del sistema \x,
+ * el tiempo de residencia por ciclo y el número medio de clientes de cada estación */
+static void macsim_analytic_results(struct macsim_analytic_t *model, double x, double *response, double *mean, struct macsim_result_t *results){
+	struct macsim_analytic_station_t *s;
+	int k;
+
+	for(k = 0; k < model->count; k++){
+		s = &model->stations[k];
+		memset(&results[k], 0, sizeof(struct macsim_result_t));
+		results[k].name = s->station->name;
+		results[k].service_time = s->service;
+		results[k].throughput = x * s->visits;
+		results[k].response_time = s->visits > 0 ? response[k] / s->visits : s->service; //Por visita, como en la simulación
+		results[k].queue_time = results[k].response_time - s->service;
+		results[k].mean_clients = mean[k];
+		results[k].utilization = results[k].throughput * s->service;
+	}
+}
+
+
+/* Análisis del valor medio (MVA) exacto de la red cerrada con \customers clientes.
+ * Coste O(customers * estaciones). */
+void macsim_analytic_mva(struct macsim_analytic_t *model, int customers, struct macsim_result_t *results){
+	double *r, *q, x = 0, sum;
+	int n, k;
+
+	if(customers < 1)
+		fatal("%s: at least one customer is needed", __func__);
+	macsim_analytic_traffic(model, 1);
+
+	r = (double *) calloc(model->count, sizeof(double));
+	q = (double *) calloc(model->count, sizeof(double));
+	if(!r || !q)
+		fatal("%s: out of memory", __func__);
+
+	for(n = 1; n <= customers; n++){
+		sum = 0;
+		for(k = 0; k < model->count; k++){
+			r[k] = model->stations[k].visits * model->stations[k].service;
+			if(!model->stations[k].delay)
+				r[k] *= 1 + q[k];
+			sum += r[k];
+		}
+		x = n / sum;
+		for(k = 0; k < model->count; k++)
+			q[k] = x * r[k];
+	}
+
+	macsim_analytic_results(model, x, r, q, results);
+	free(r);
+	free(q);
+}
+
+
+/* MVA aproximado de Schweitzer-Bard, iterando hasta que la longitud de las colas
+ * cambie menos de \tolerance. Coste independiente del número de clientes. */
+void macsim_analytic_mva_approx(struct macsim_analytic_t *model, int customers, double tolerance, struct macsim_result_t *results){
+	double *r, *q, x = 0, sum, delta, value, factor;
+	int k, queues = 0;
+
+	if(customers < 1)
+		fatal("%s: at least one customer is needed", __func__);
+	macsim_analytic_traffic(model, 1);
+
+	r = (double *) calloc(model->count, sizeof(double));
+	q = (double *) calloc(model->count, sizeof(double));
+	if(!r || !q)
+		fatal("%s: out of memory", __func__);
+
+	for(k = 0; k < model->count; k++)
+		queues += !model->stations[k].delay;
+	for(k = 0; k < model->count; k++)
+		q[k] = model->stations[k].delay ? 0 : (double) customers / queues;
+
+	factor = (customers - 1.0) / customers;
+	do{
+		sum = 0;
+		for(k = 0; k < model->count; k++){
+			r[k] = model->stations[k].visits * model->stations[k].service;
+			if(!model->stations[k].delay)
+				r[k] *= 1 + factor * q[k];
+			sum += r[k];
+		}
+		x = customers / sum;
+		delta = 0;
+		for(k = 0; k < model->count; k++){
+			value = x * r[k];
+			delta = fmax(delta, fabs(value - q[k]));
+			q[k] = value;
+		}
+	} while(delta > tolerance);
+
+	macsim_analytic_results(model, x, r, q, results);
+	free(r);
+	free(q);
+}
+
+
+/* Solución de la red abierta de Jackson: cada estación se comporta como una M/M/1
+ * (o M/M/inf si es de retardo) con la tasa de llegadas de las ecuaciones de tráfico. */
+void macsim_analytic_jackson(struct macsim_analytic_t *model, struct macsim_result_t *results){
+	struct macsim_analytic_station_t *s;
+	double *r, *q, rho;
+	int k;
+
+	macsim_analytic_traffic(model, 0);
+
+	r = (double *) calloc(model->count, sizeof(double));
+	q = (double *) calloc(model->count, sizeof(double));
+	if(!r || !q)
+		fatal("%s: out of memory", __func__);
+
+	for(k = 0; k < model->count; k++){
+		s = &model->stations[k];
+		rho = s->visits * s->service;
+		if(!s->delay && rho >= 1)
+			fatal("%s: station \"%s\" is saturated (utilization %f)", __func__, s->station->name, rho);
+		r[k] = s->visits * (s->delay ? s->service : s->service / (1 - rho));
+		q[k] = r[k];
+	}
+
+	/* En las abiertas visits ya es la tasa de llegadas, así que la productividad del sistema es 1 */
+	macsim_analytic_results(model, 1, r, q, results);
+	free(r);
+	free(q);
+}
+
+
+/* Imprime los resultados analíticos con el mismo formato que macsim_report */
+void macsim_analytic_report(struct macsim_analytic_t *model, struct macsim_result_t *results){
+	int k;
+
+	printf("\n");
+	printf("RESULTADOS DEL MODELO ANALÍTICO\n");
+	for(k = 0; k < model->count; k++){
+		printf("\n");
+		printf("ESTACION: %s\n", results[k].name);
+		printf("Tiempo de servicio    Tiempo de respuesta   Tiempo en cola        Clientes medios       Productividad         Utilización\n");
+		printf("%-20.4f  %-20.4f  %-20.4f  %-20.4f  %-20.4f  %-20.4f\n", results[k].service_time, results[k].response_time, results[k].queue_time, results[k].mean_clients, results[k].throughput, results[k].utilization);
+		printf("\n");
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef ANALYTIC_H
+#define ANALYTIC_H
+
+#include "macsim.h"
+
+struct macsim_analytic_t;
+
+/* Prototipos */
+struct macsim_analytic_t * macsim_analytic_create();
+void macsim_analytic_free(struct macsim_analytic_t *model);
+void macsim_analytic_station(struct macsim_analytic_t *model, struct macsim_station_t *station, double service_ms);
+void macsim_analytic_delay(struct macsim_analytic_t *model, struct macsim_station_t *station, double delay_ms);
+void macsim_analytic_route(struct macsim_analytic_t *model, struct macsim_station_t *from, struct macsim_station_t *to, double prob);
+void macsim_analytic_arrivals(struct macsim_analytic_t *model, struct macsim_station_t *station, double interarrival_ms);
+int macsim_analytic_count(struct macsim_analytic_t *model);
+void macsim_analytic_mva(struct macsim_analytic_t *model, int customers, struct macsim_result_t *results);
+void macsim_analytic_mva_approx(struct macsim_analytic_t *model, int customers, double tolerance, struct macsim_result_t *results);
+void macsim_analytic_jackson(struct macsim_analytic_t *model, struct macsim_result_t *results);
+void macsim_analytic_report(struct macsim_analytic_t *model, struct macsim_result_t *results);
+
+#endif /* ANALYTIC_H */
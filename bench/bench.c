@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "bench.h"
+#include "debug.h"
+
+/* Contador de reservas de memoria. Los benchmarks se enlazan con
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc para que las llamadas de la librería
+ * pasen por aquí. */
+static long long allocs;
+
+static int failed; //Casos que han fallado en este proceso (ver bench_status)
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size){
+	allocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size){
+	allocs++;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size){
+	allocs++;
+	return __real_realloc(ptr, size);
+}
+
+
+/* Contadores hardware de bench_start a bench_stop */
+static const unsigned long long counter_configs[BENCH_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+static const char *counter_names[BENCH_COUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+static int counter_fds[BENCH_COUNTERS] = {-1, -1, -1, -1};
+
+
+/* Abre y pone en marcha los contadores hardware del proceso. Los que no se pueden abrir
+ * (sin permiso, en una máquina virtual que no los ofrece...) se quedan en -1. */
+static void bench_counters_start(){
+	struct perf_event_attr attr;
+	int i;
+
+	for(i = 0; i < BENCH_COUNTERS; i++){
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = counter_configs[i];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	for(i = 0; i < BENCH_COUNTERS; i++){
+		if(counter_fds[i] >= 0){
+			ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+
+/* Para los contadores hardware y deja sus valores en \counters (-1 los que no se han podido
+ * leer). Si el núcleo los ha ido turnando se escalan al tiempo total. */
+static void bench_counters_stop(double *counters){
+	unsigned long long values[3]; //Valor, tiempo activo y tiempo contando
+	int i;
+
+	for(i = 0; i < BENCH_COUNTERS; i++){
+		if(counter_fds[i] >= 0)
+			ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+	for(i = 0; i < BENCH_COUNTERS; i++){
+		counters[i] = -1;
+		if(counter_fds[i] < 0)
+			continue;
+		if(read(counter_fds[i], values, sizeof(values)) == sizeof(values) && values[2])
+			counters[i] = values[2] < values[1] ? (double) values[0] * values[1] / values[2] : values[0];
+		close(counter_fds[i]);
+		counter_fds[i] = -1;
+	}
+}
+
+
+/* Instante actual en segundos */
+double bench_now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Número de reservas de memoria hechas hasta ahora */
+long long bench_allocs(){
+	return allocs;
+}
+
+
+/* Memoria residente máxima del proceso en KB */
+long bench_peak_rss_kb(){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+
+/* Marca el comienzo de la parte medida */
+void bench_start(struct bench_result_t *result){
+	bench_counters_start();
+	result->allocs = allocs;
+	result->seconds = bench_now();
+}
+
+
+/* Marca el final de la parte medida */
+void bench_stop(struct bench_result_t *result, long long events){
+	result->seconds = bench_now() - result->seconds;
+	result->allocs = allocs - result->allocs;
+	result->events = events;
+	bench_counters_stop(result->counters);
+}
+
+
+/* Ejecuta un caso en un proceso hijo e imprime su resultado.
+ * \params es el contenido JSON (sin llaves) que identifica el caso. */
+void bench_run(const char *name, const char *params, bench_func_t func, void *arg){
+	struct bench_result_t *result;
+	char oracle[64] = "", counters[256] = "";
+	long rss;
+	int status, i, n;
+	pid_t pid;
+
+	/* El hijo deja el resultado en memoria compartida */
+	result = (struct bench_result_t *) mmap(NULL, sizeof(*result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(result == MAP_FAILED)
+		fatal("%s: can't map result", __func__);
+	memset(result, 0, sizeof(*result));
+	for(i = 0; i < BENCH_COUNTERS; i++)
+		result->counters[i] = -1;
+
+	fflush(stdout);
+	pid = fork();
+	if(pid < 0)
+		fatal("%s: can't fork", __func__);
+	if(!pid){
+		func(arg, result);
+		rss = bench_peak_rss_kb();
+		if(result->oracle)
+			snprintf(oracle, sizeof(oracle), ",\"oracle_rel_error\":%.6f", result->oracle_error);
+		for(i = n = 0; i < BENCH_COUNTERS; i++){
+			if(result->counters[i] < 0)
+				n += snprintf(counters + n, sizeof(counters) - n, ",\"%s_per_event\":null", counter_names[i]);
+			else
+				n += snprintf(counters + n, sizeof(counters) - n, ",\"%s_per_event\":%.4f", counter_names[i], result->counters[i] / result->events);
+		}
+		printf("{\"bench\":\"%s\",%s,\"events\":%lld,\"seconds\":%.6f,\"events_per_sec\":%.0f,\"ns_per_event\":%.2f,\"peak_rss_kb\":%ld,\"allocs_per_event\":%.4f%s%s}\n",
+			name, params, result->events, result->seconds,
+			result->events / result->seconds, result->seconds * 1e9 / result->events,
+			rss, (double) result->allocs / result->events, counters, oracle);
+		fflush(stdout);
+		_exit(0);
+	}
+	if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)){
+		fprintf(stderr, "%s: el caso %s falló\n", name, params);
+		failed++;
+	}
+	munmap(result, sizeof(*result));
+}
+
+
+/* Código de salida del benchmark: los casos siguen ejecutándose aunque uno falle (fatal,
+ * código distinto de 0 o señal), pero entonces el proceso tiene que acabar con error
+ * @return 0 si todos los casos de bench_run han terminado bien, 1 si no */
+int bench_status(){
+	return failed > 0;
+}
+
+
+/* Lee un argumento de la forma nombre=valor
+ * @return El valor o \def si no aparece */
+long long bench_arg(int argc, char **argv, const char *name, long long def){
+	int i, len = strlen(name);
+	for(i = 1; i < argc; i++){
+		if(!strncmp(argv[i], name, len) && argv[i][len] == '=')
+			return atoll(argv[i] + len + 1);
+	}
+	return def;
+}
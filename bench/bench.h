@@ -0,0 +1,36 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Utilidades comunes de los benchmarks.
+ * Cada caso se ejecuta en un proceso hijo para que la memoria máxima (peak RSS)
+ * y el estado de la librería sean los de ese caso y no los de los anteriores.
+ * Los resultados se imprimen en stdout como una línea JSON por caso.
+ * Si el sistema deja usar perf_event_open, la línea lleva también los contadores hardware de
+ * la parte medida (ciclos, instrucciones, fallos de caché y de predicción de saltos) por
+ * evento; si no, esos campos valen null y el resto del resultado no cambia. */
+
+#define BENCH_COUNTERS 4 //Contadores hardware: ciclos, instrucciones, fallos de caché y de saltos
+
+/* Resultado de un caso */
+struct bench_result_t {
+	long long events; //Eventos procesados en la parte medida
+	double seconds; //Tiempo de la parte medida
+	long long allocs; //Reservas de memoria en la parte medida
+	int oracle; //Indica si hay resultado analítico con el que comparar
+	double oracle_error; //Error relativo frente al resultado analítico
+	double counters[BENCH_COUNTERS]; //Contadores hardware de la parte medida, -1 si no se han podido leer
+};
+
+typedef void (*bench_func_t)(void *arg, struct bench_result_t *result);
+
+/* Prototipos */
+double bench_now();
+long long bench_allocs();
+long bench_peak_rss_kb();
+void bench_start(struct bench_result_t *result);
+void bench_stop(struct bench_result_t *result, long long events);
+void bench_run(const char *name, const char *params, bench_func_t func, void *arg);
+int bench_status();
+long long bench_arg(int argc, char **argv, const char *name, long long def);
+
+#endif /* BENCH_H */
@@ -0,0 +1,257 @@
+/* Microbenchmarks de los contenedores de libstruct: heap, hash_table y linked_list.
+ * Cada caso mide una operación sobre un contenedor de \size elementos, con las claves o
+ * posiciones en orden (sequential) o al azar (random), para ver cuánto cambian el coste por
+ * operación y los fallos de caché y de predicción de saltos al cambiar una implementación.
+ *
+ * heap: insert llena un montículo vacío, extract lo vacía y hold repite \ops veces extraer el
+ *   mínimo e insertar otro más adelante (a distancia fija o al azar), con tamaño constante.
+ * hash_table: insert mete \size claves, get busca \ops claves de las que hay y remove las
+ *   quita todas; el orden de las claves es el de creación o uno barajado.
+ * linked_list: add añade \size elementos al final, insert los mete en la posición actual
+ *   (al principio o en una posición al azar) y remove los quita (del principio o de una
+ *   posición al azar). Ir a una posición al azar recorre la lista, así que los casos random
+ *   de insert y remove solo se hacen hasta \walk elementos.
+ *
+ * Uso: containers [maxsize=N] [ops=N] [walk=N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap.h"
+#include "hash-table.h"
+#include "linked-list.h"
+#include "random.h"
+#include "debug.h"
+#include "bench.h"
+
+#define CONTAINERS_KEY 16 //Bytes de las claves de la tabla hash
+
+/* Operaciones */
+enum containers_op_t {
+	HEAP_INSERT = 0,
+	HEAP_EXTRACT,
+	HEAP_HOLD,
+	HASH_INSERT,
+	HASH_GET,
+	HASH_REMOVE,
+	LIST_ADD,
+	LIST_INSERT,
+	LIST_REMOVE,
+	CONTAINERS_OPS
+};
+
+static const char *container_names[CONTAINERS_OPS] = {"heap", "heap", "heap", "hash_table", "hash_table", "hash_table",
+	"linked_list", "linked_list", "linked_list"};
+static const char *op_names[CONTAINERS_OPS] = {"insert", "extract", "hold", "insert", "get", "remove", "add", "insert", "remove"};
+
+/* Orden de las claves o posiciones */
+enum containers_pattern_t {
+	CONTAINERS_SEQUENTIAL = 0,
+	CONTAINERS_RANDOM,
+	CONTAINERS_PATTERNS
+};
+
+static const char *pattern_names[CONTAINERS_PATTERNS] = {"sequential", "random"};
+
+struct containers_case_t {
+	int op;
+	int pattern;
+	int size;
+	long long ops;
+};
+
+
+/* Baraja \order con Fisher-Yates */
+static void containers_shuffle(int *order, int size, long *state){
+	int i, j, tmp;
+
+	for(i = size - 1; i > 0; i--){
+		j = macsim_random_r(state) * (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+}
+
+
+/* Permutación de 0..size-1: la identidad o una al azar */
+static int * containers_order(int size, int pattern, long *state){
+	int *order, i;
+
+	order = (int *) malloc(size * sizeof(int));
+	if(!order)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < size; i++)
+		order[i] = i;
+	if(pattern == CONTAINERS_RANDOM)
+		containers_shuffle(order, size, state);
+	return order;
+}
+
+
+static void containers_heap(void *arg, struct bench_result_t *result){
+	struct containers_case_t *c = (struct containers_case_t *) arg;
+	struct heap_t *heap;
+	long long *keys, key, i;
+	long state = 1;
+	int *order;
+	void *data;
+
+	/* Claves de insert y extract, y distancias de hold */
+	order = containers_order(c->size, c->pattern, &state);
+	keys = (long long *) malloc(c->ops * sizeof(long long));
+	if(!keys)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < c->ops; i++)
+		keys[i] = c->pattern == CONTAINERS_RANDOM ? 1 + macsim_random_r(&state) * 2 * c->size : c->size;
+
+	heap = heap_create(c->size);
+	if(c->op == HEAP_INSERT)
+		bench_start(result);
+	for(i = 0; i < c->size; i++)
+		heap_insert(heap, order[i], &order[i]);
+	if(c->op == HEAP_INSERT){
+		bench_stop(result, c->size);
+	}else if(c->op == HEAP_EXTRACT){
+		bench_start(result);
+		for(i = 0; i < c->size; i++)
+			heap_extract(heap, &data);
+		bench_stop(result, c->size);
+	}else{
+		bench_start(result);
+		for(i = 0; i < c->ops; i++){
+			key = heap_extract(heap, &data);
+			heap_insert(heap, key + keys[i], data);
+		}
+		bench_stop(result, c->ops);
+	}
+	if(heap_count(heap) != (c->op == HEAP_EXTRACT ? 0 : c->size))
+		fatal("%s: wrong heap size", __func__);
+	heap_free(heap);
+	free(keys);
+	free(order);
+}
+
+
+static void containers_hash(void *arg, struct bench_result_t *result){
+	struct containers_case_t *c = (struct containers_case_t *) arg;
+	struct hash_table_t *table;
+	char *keys;
+	long state = 1;
+	long long i, found = 0;
+	int *order, *lookups;
+
+	/* Claves y orden en que se usan; las búsquedas de get se sacan al azar o en orden */
+	keys = (char *) malloc((size_t) c->size * CONTAINERS_KEY);
+	lookups = (int *) malloc(c->ops * sizeof(int));
+	if(!keys || !lookups)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < c->size; i++)
+		snprintf(keys + i * CONTAINERS_KEY, CONTAINERS_KEY, "key%lld", i);
+	order = containers_order(c->size, c->pattern, &state);
+	for(i = 0; i < c->ops; i++)
+		lookups[i] = c->pattern == CONTAINERS_RANDOM ? macsim_random_r(&state) * c->size : i % c->size;
+
+	table = hash_table_create(0, 1);
+	if(c->op == HASH_INSERT)
+		bench_start(result);
+	for(i = 0; i < c->size; i++)
+		hash_table_insert(table, keys + (size_t) order[i] * CONTAINERS_KEY, &order[i]);
+	if(c->op == HASH_INSERT){
+		bench_stop(result, c->size);
+	}else if(c->op == HASH_GET){
+		bench_start(result);
+		for(i = 0; i < c->ops; i++)
+			found += hash_table_get(table, keys + (size_t) lookups[i] * CONTAINERS_KEY) != NULL;
+		bench_stop(result, c->ops);
+		if(found != c->ops)
+			fatal("%s: key not found", __func__);
+	}else{
+		bench_start(result);
+		for(i = 0; i < c->size; i++)
+			hash_table_remove(table, keys + (size_t) order[i] * CONTAINERS_KEY);
+		bench_stop(result, c->size);
+	}
+	if(hash_table_count(table) != (c->op == HASH_REMOVE ? 0 : c->size))
+		fatal("%s: wrong table size", __func__);
+	hash_table_free(table);
+	free(lookups);
+	free(order);
+	free(keys);
+}
+
+
+static void containers_list(void *arg, struct bench_result_t *result){
+	struct containers_case_t *c = (struct containers_case_t *) arg;
+	struct linked_list_t *list;
+	long state = 1;
+	int *positions, *items, i;
+
+	/* Posición de cada inserción o borrado, dentro de la lista que hay en ese momento */
+	positions = (int *) malloc(c->size * sizeof(int));
+	items = (int *) malloc(c->size * sizeof(int));
+	if(!positions || !items)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < c->size; i++){
+		items[i] = i;
+		if(c->op == LIST_INSERT)
+			positions[i] = c->pattern == CONTAINERS_RANDOM ? macsim_random_r(&state) * (i + 1) : 0;
+		else
+			positions[i] = c->pattern == CONTAINERS_RANDOM ? macsim_random_r(&state) * (c->size - i) : 0;
+	}
+
+	list = linked_list_create();
+	if(c->op == LIST_ADD){
+		bench_start(result);
+		for(i = 0; i < c->size; i++)
+			linked_list_add(list, &items[i]);
+		bench_stop(result, c->size);
+	}else if(c->op == LIST_INSERT){
+		bench_start(result);
+		for(i = 0; i < c->size; i++){
+			linked_list_goto(list, positions[i]);
+			linked_list_insert(list, &items[i]);
+		}
+		bench_stop(result, c->size);
+	}else{
+		for(i = 0; i < c->size; i++)
+			linked_list_add(list, &items[i]);
+		bench_start(result);
+		for(i = 0; i < c->size; i++){
+			linked_list_goto(list, positions[i]);
+			linked_list_remove(list);
+		}
+		bench_stop(result, c->size);
+	}
+	if(linked_list_count(list) != (c->op == LIST_REMOVE ? 0 : c->size))
+		fatal("%s: wrong list size", __func__);
+	linked_list_free(list);
+	free(items);
+	free(positions);
+}
+
+
+int main(int argc, char **argv){
+	static const bench_func_t funcs[CONTAINERS_OPS] = {containers_heap, containers_heap, containers_heap,
+		containers_hash, containers_hash, containers_hash, containers_list, containers_list, containers_list};
+	struct containers_case_t c;
+	char params[128];
+	long long maxsize = bench_arg(argc, argv, "maxsize", 1000000);
+	long long walk = bench_arg(argc, argv, "walk", 10000);
+
+	c.ops = bench_arg(argc, argv, "ops", 1000000);
+	for(c.op = 0; c.op < CONTAINERS_OPS; c.op++){
+		for(c.pattern = 0; c.pattern < CONTAINERS_PATTERNS; c.pattern++){
+			if(c.op == LIST_ADD && c.pattern == CONTAINERS_RANDOM)
+				continue;
+			for(c.size = 1000; c.size <= maxsize; c.size *= 10){
+				if((c.op == LIST_INSERT || c.op == LIST_REMOVE) && c.pattern == CONTAINERS_RANDOM && c.size > walk)
+					break;
+				snprintf(params, sizeof(params), "\"container\":\"%s\",\"op\":\"%s\",\"pattern\":\"%s\",\"size\":%d",
+					container_names[c.op], op_names[c.op], pattern_names[c.pattern], c.size);
+				bench_run("containers", params, funcs[c.op], &c);
+			}
+		}
+	}
+	return bench_status();
+}
@@ -0,0 +1,249 @@
+/* Benchmark clásico "hold" de la cola de eventos.
+ * Se llena la cola con \size eventos y se repite la operación hold: extraer el evento
+ * más próximo y planificar uno nuevo a una distancia aleatoria del instante actual.
+ * El tamaño de la cola se mantiene constante durante la medida.
+ * El caso hold-loop repite la medida con distancias exponenciales y cada forma de escribir el
+ * bucle de eventos: macsim_extract, macsim_run con manejadores y MACSIM_RUN_FOR_EACH.
+ * El caso hold-batch agrupa los eventos en grupos de \group simultáneos: cada operación extrae
+ * un grupo y lo vuelve a planificar en un mismo instante, con macsim_extract o macsim_extract_all.
+ * El caso fill mide solo el llenado inicial de la cola con \size eventos: uno a uno con
+ * macsim_schedule, lo mismo tras macsim_reserve, o de una vez con macsim_schedule_bulk.
+ *
+ * El caso hold se repite con cada implementación de la cola de eventos (macsim_queue_backend),
+ * sola y con una rueda de tiempos de 16 ms delante (macsim_queue_wheel), y con MACSIM_QUEUE_AUTO,
+ * que incluye lo que cuesta cambiar de configuración; los demás usan el montículo binario.
+ *
+ * Uso: hold [holds=N] [maxsize=N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "macsim.h"
+#include "random.h"
+#include "bench.h"
+
+/* Distribuciones de la distancia de planificación, todas de media 1 ms */
+enum hold_dist_t {
+	HOLD_EXPONENTIAL = 0,
+	HOLD_UNIFORM,
+	HOLD_BIMODAL,
+	HOLD_TRIANGULAR,
+	HOLD_CONSTANT,
+	HOLD_DISTS
+};
+
+static const char *dist_names[HOLD_DISTS] = {"exponential", "uniform", "bimodal", "triangular", "constant"};
+
+/* Bucles de eventos */
+enum hold_loop_t {
+	HOLD_EXTRACT = 0,
+	HOLD_RUN,
+	HOLD_FOR_EACH,
+	HOLD_LOOPS
+};
+
+static const char *loop_names[HOLD_LOOPS] = {"extract", "run", "for_each"};
+
+/* Formas de llenar la cola */
+enum hold_fill_t {
+	HOLD_FILL_ONE = 0,
+	HOLD_FILL_RESERVE,
+	HOLD_FILL_BULK,
+	HOLD_FILLS
+};
+
+static const char *fill_names[HOLD_FILLS] = {"schedule", "reserve", "bulk"};
+
+/* Colas de hold: el bit 0 es la implementación y el 1 si lleva rueda; la última es MACSIM_QUEUE_AUTO */
+static const char *queue_names[] = {"heap", "radix", "heap+wheel", "radix+wheel", "auto"};
+#define HOLD_QUEUES 5
+#define HOLD_AUTO 4
+#define HOLD_WHEEL_MS 16
+
+#define HOLD_BATCH_MAX 1024 //Grupo máximo de hold-batch
+
+struct hold_case_t {
+	int queue; //Índice en queue_names
+	int dist;
+	int loop;
+	int group; //Eventos simultáneos de hold-batch
+	int all; //hold-batch con macsim_extract_all
+	int fill; //enum hold_fill_t
+	long long size;
+	long long holds;
+};
+
+
+/* Distancia de planificación en ms */
+static double hold_sample(int dist){
+	switch(dist){
+	case HOLD_EXPONENTIAL:
+		return macsim_exponential(1.0);
+	case HOLD_UNIFORM:
+		return macsim_uniform(0, 2);
+	case HOLD_BIMODAL:
+		return macsim_random(0) < 0.9 ? macsim_uniform(0, 0.2) : macsim_uniform(0, 18.2);
+	case HOLD_TRIANGULAR:
+		return 1.5 * sqrt(macsim_random(0));
+	}
+	return 1.0;
+}
+
+
+/* Manejador de macsim_run: la misma operación hold */
+static void hold_handler(long long client, void *arg){
+	macsim_schedule(0, client, hold_sample(((struct hold_case_t *) arg)->dist));
+}
+
+
+static void hold(void *arg, struct bench_result_t *result){
+	struct hold_case_t *c = (struct hold_case_t *) arg;
+	macsim_handler_t handlers[1] = {hold_handler};
+	struct macsim_run_t run = {0};
+	long long i, client;
+	int kind;
+
+	macsim_queue_backend(c->queue & 1);
+	macsim_queue_wheel(c->queue & 2 ? HOLD_WHEEL_MS : 0);
+	if(c->queue == HOLD_AUTO) //Empieza con el montículo binario solo
+		macsim_queue_backend(MACSIM_QUEUE_AUTO);
+	macsim_init();
+	macsim_trace(0);
+	for(i = 0; i < c->size; i++)
+		macsim_schedule(0, i, hold_sample(c->dist));
+
+	run.max_events = c->holds;
+	run.quiet = 1;
+	bench_start(result);
+	switch(c->loop){
+	case HOLD_EXTRACT:
+		for(i = 0; i < c->holds; i++){
+			macsim_extract(&kind, &client);
+			macsim_schedule(kind, client, hold_sample(c->dist));
+		}
+		break;
+	case HOLD_RUN:
+		macsim_run(&run, handlers, 1, c);
+		break;
+	case HOLD_FOR_EACH:
+		MACSIM_RUN_FOR_EACH(&run, kind, client)
+			macsim_schedule(kind, client, hold_sample(c->dist));
+		break;
+	}
+	bench_stop(result, c->holds);
+	macsim_exit();
+}
+
+
+static void hold_batch(void *arg, struct bench_result_t *result){
+	struct hold_case_t *c = (struct hold_case_t *) arg;
+	static int kinds[HOLD_BATCH_MAX];
+	static long long clients[HOLD_BATCH_MAX];
+	long long i, k, events = 0;
+	double delay;
+
+	macsim_init();
+	macsim_trace(0);
+	for(i = 0; i < c->size; i += c->group){
+		delay = hold_sample(c->dist);
+		for(k = i; k < i + c->group; k++)
+			macsim_schedule(0, k, delay);
+	}
+
+	bench_start(result);
+	while(events < c->holds){
+		delay = hold_sample(c->dist);
+		if(c->all){
+			k = macsim_extract_all(kinds, clients, HOLD_BATCH_MAX);
+			for(i = 0; i < k; i++)
+				macsim_schedule(kinds[i], clients[i], delay);
+		}
+		else{
+			for(i = 0, k = c->group; i < k; i++){
+				macsim_extract(&kinds[0], &clients[0]);
+				macsim_schedule(kinds[0], clients[0], delay);
+			}
+		}
+		events += k;
+	}
+	bench_stop(result, events);
+	macsim_exit();
+}
+
+
+static void hold_fill(void *arg, struct bench_result_t *result){
+	struct hold_case_t *c = (struct hold_case_t *) arg;
+	long long *clients = (long long *) malloc(c->size * sizeof(long long)), i;
+	double *delays = (double *) malloc(c->size * sizeof(double));
+
+	macsim_init();
+	macsim_trace(0);
+	for(i = 0; i < c->size; i++){
+		clients[i] = i;
+		delays[i] = hold_sample(HOLD_EXPONENTIAL);
+	}
+
+	bench_start(result);
+	switch(c->fill){
+	case HOLD_FILL_RESERVE:
+		macsim_reserve(c->size);
+		/* fall through */
+	case HOLD_FILL_ONE:
+		for(i = 0; i < c->size; i++)
+			macsim_schedule(0, clients[i], delays[i]);
+		break;
+	case HOLD_FILL_BULK:
+		macsim_schedule_bulk(0, clients, delays, c->size);
+		break;
+	}
+	bench_stop(result, c->size);
+	macsim_exit();
+	free(clients);
+	free(delays);
+}
+
+
+int main(int argc, char **argv){
+	struct hold_case_t c;
+	char params[128];
+	long long maxsize = bench_arg(argc, argv, "maxsize", 1000000);
+
+	c.holds = bench_arg(argc, argv, "holds", 1000000);
+	c.loop = HOLD_EXTRACT;
+	for(c.queue = 0; c.queue < HOLD_QUEUES; c.queue++){
+		for(c.dist = 0; c.dist < HOLD_DISTS; c.dist++){
+			for(c.size = 10; c.size <= maxsize; c.size *= 10){
+				snprintf(params, sizeof(params), "\"queue\":\"%s\",\"dist\":\"%s\",\"size\":%lld",
+					queue_names[c.queue], dist_names[c.dist], c.size);
+				bench_run("hold", params, hold, &c);
+			}
+		}
+	}
+	c.queue = 0;
+
+	c.dist = HOLD_EXPONENTIAL;
+	for(c.loop = 0; c.loop < HOLD_LOOPS; c.loop++){
+		for(c.size = 10; c.size <= maxsize; c.size *= 10){
+			snprintf(params, sizeof(params), "\"loop\":\"%s\",\"size\":%lld", loop_names[c.loop], c.size);
+			bench_run("hold-loop", params, hold, &c);
+		}
+	}
+
+	for(c.all = 0; c.all < 2; c.all++){
+		for(c.group = 1; c.group <= 64; c.group *= 8){
+			for(c.size = 1000; c.size <= maxsize; c.size *= 100){
+				snprintf(params, sizeof(params), "\"extract\":\"%s\",\"group\":%d,\"size\":%lld",
+					c.all ? "all" : "one", c.group, c.size);
+				bench_run("hold-batch", params, hold_batch, &c);
+			}
+		}
+	}
+
+	for(c.fill = 0; c.fill < HOLD_FILLS; c.fill++){
+		for(c.size = 1000; c.size <= maxsize; c.size *= 10){
+			snprintf(params, sizeof(params), "\"fill\":\"%s\",\"size\":%lld", fill_names[c.fill], c.size);
+			bench_run("fill", params, hold_fill, &c);
+		}
+	}
+	return bench_status();
+}
@@ -0,0 +1,348 @@
+/* Benchmarks de redes de colas abiertas y cerradas construidas sobre
+ * macsim_station_request/macsim_station_leave, con el bucle de eventos típico de un usuario.
+ * Topologías: tándem, servidor central (estación 0 = CPU, el resto discos) y malla
+ * (toro cuadrado; cada cliente avanza a la derecha o hacia abajo).
+ *
+ * Todas las redes son de forma producto, así que cada caso se compara con la solución
+ * analítica (MVA exacto para las cerradas, Jackson para las abiertas): oracle_rel_error es
+ * el error relativo de la productividad total (cerradas) o del tiempo medio de respuesta
+ * por visita (abiertas). Las redes abiertas empiezan vacías y con menos de NET_ORACLE_EVENTS
+ * eventos medidos por estación su error refleja sobre todo el transitorio, así que en esos
+ * casos no se da oracle_rel_error; para tenerlo hay que aumentar events.
+ *
+ * Las redes cerradas se simulan también con el motor propio de la librería
+ * (macsim_network_run_closed, modelo closed-builtin), sin bucle de usuario.
+ *
+ * Uso: network [events=N] [maxstations=N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "macsim.h"
+#include "random.h"
+#include "analytic.h"
+#include "network.h"
+#include "bench.h"
+
+#define ARRIVE(k) (2 * (k)) //Llegada a la estación k
+#define DEPART(k) (2 * (k) + 1) //Fin de servicio en la estación k
+#define EXIT_PROB 0.1 //Probabilidad de abandonar la red (abiertas)
+#define NET_ORACLE_EVENTS 10000 //Eventos medidos por estación para comparar una red abierta con Jackson
+
+enum net_topology_t {
+	NET_TANDEM = 0,
+	NET_CENTRAL,
+	NET_MESH,
+	NET_TOPOLOGIES
+};
+
+static const char *topology_names[NET_TOPOLOGIES] = {"tandem", "central", "mesh"};
+static const char *model_names[3] = {"open", "closed", "closed-builtin"};
+
+struct net_case_t {
+	int topology;
+	int closed; //0 abierta, 1 cerrada, 2 cerrada con macsim_network_run_closed
+	int stations;
+	long long events;
+};
+
+static struct macsim_station_t **stations;
+static double *service; //Tiempo medio de servicio de cada estación en ms
+static int side; //Lado de la malla
+
+
+/* Estación a la que va un cliente que sale de \k, o -1 si abandona la red */
+static int net_route(struct net_case_t *c, int k){
+	int row, col;
+
+	switch(c->topology){
+	case NET_TANDEM:
+		if(k + 1 < c->stations)
+			return k + 1;
+		return c->closed ? 0 : -1;
+	case NET_CENTRAL:
+		if(k)
+			return 0;
+		if(!c->closed && macsim_random(1) < EXIT_PROB)
+			return -1;
+		return 1 + (int) (macsim_random(1) * (c->stations - 1));
+	}
+
+	if(!c->closed && macsim_random(1) < EXIT_PROB)
+		return -1;
+	row = k / side;
+	col = k % side;
+	if(macsim_random(1) < 0.5)
+		return row * side + (col + 1) % side;
+	return ((row + 1) % side) * side + col;
+}
+
+
+/* Primera estación de un cliente que llega de fuera */
+static int net_entry(struct net_case_t *c){
+	if(c->topology == NET_MESH)
+		return (int) (macsim_random(1) * c->stations);
+	return 0;
+}
+
+
+/* Tiempos de servicio para que la estación más cargada de la red abierta ronde el 70% */
+static void net_service(struct net_case_t *c){
+	int k;
+
+	for(k = 0; k < c->stations; k++){
+		service[k] = 1.0;
+		if(c->closed)
+			continue;
+		switch(c->topology){
+		case NET_TANDEM:
+			service[k] = 0.7;
+			break;
+		case NET_CENTRAL:
+			service[k] = k ? 0.7 * (c->stations - 1) * EXIT_PROB / (1 - EXIT_PROB) : 0.7 * EXIT_PROB;
+			break;
+		case NET_MESH:
+			service[k] = 0.7 * c->stations * EXIT_PROB;
+			break;
+		}
+	}
+	if(c->closed && c->topology == NET_CENTRAL)
+		service[0] = 1.0 / (c->stations - 1);
+}
+
+
+/* Describe la red para el modelo analítico, con el mismo encaminamiento que net_route */
+static struct macsim_analytic_t * net_analytic(struct net_case_t *c){
+	struct macsim_analytic_t *model = macsim_analytic_create();
+	double stay = c->closed ? 1 : 1 - EXIT_PROB;
+	int k, row, col;
+
+	for(k = 0; k < c->stations; k++)
+		macsim_analytic_station(model, stations[k], service[k]);
+
+	for(k = 0; k < c->stations; k++){
+		switch(c->topology){
+		case NET_TANDEM:
+			if(k + 1 < c->stations)
+				macsim_analytic_route(model, stations[k], stations[k + 1], 1);
+			else if(c->closed)
+				macsim_analytic_route(model, stations[k], stations[0], 1);
+			break;
+		case NET_CENTRAL:
+			if(k)
+				macsim_analytic_route(model, stations[k], stations[0], 1);
+			else{
+				for(row = 1; row < c->stations; row++)
+					macsim_analytic_route(model, stations[0], stations[row], stay / (c->stations - 1));
+			}
+			break;
+		case NET_MESH:
+			row = k / side;
+			col = k % side;
+			macsim_analytic_route(model, stations[k], stations[row * side + (col + 1) % side], stay / 2);
+			macsim_analytic_route(model, stations[k], stations[((row + 1) % side) * side + col], stay / 2);
+			break;
+		}
+	}
+
+	if(!c->closed){
+		if(c->topology == NET_MESH){
+			for(k = 0; k < c->stations; k++)
+				macsim_analytic_arrivals(model, stations[k], c->stations);
+		}
+		else
+			macsim_analytic_arrivals(model, stations[0], 1.0);
+	}
+	return model;
+}
+
+
+/* Error relativo de la simulación frente a la solución analítica */
+static double net_oracle(struct net_case_t *c){
+	struct macsim_analytic_t *model = net_analytic(c);
+	struct macsim_result_t *results = (struct macsim_result_t *) malloc(c->stations * sizeof(struct macsim_result_t));
+	double elapsed = macsim_time_ns() - macsim_get_last_reset_time(), expected = 0, measured = 0, visits = 0, completed = 0;
+	int k;
+
+	if(c->closed)
+		macsim_analytic_mva(model, 2 * c->stations, results);
+	else
+		macsim_analytic_jackson(model, results);
+
+	for(k = 0; k < c->stations; k++){
+		if(c->closed){
+			expected += results[k].throughput;
+			measured += stations[k]->total_clients / elapsed * 1000000;
+		}
+		else{
+			expected += results[k].throughput * results[k].response_time;
+			visits += results[k].throughput;
+			measured += stations[k]->total_response_time / 1000000.0;
+			completed += stations[k]->total_clients;
+		}
+	}
+	if(!c->closed){
+		expected /= visits;
+		measured /= completed;
+	}
+
+	macsim_analytic_free(model);
+	free(results);
+	return fabs(measured - expected) / expected;
+}
+
+
+static void network(void *arg, struct bench_result_t *result){
+	struct net_case_t *c = (struct net_case_t *) arg;
+	long long i, client, next_client = 0, warmup = c->events / 10;
+	int kind, k, source = 2 * c->stations;
+	char name[32];
+
+	macsim_init();
+	macsim_trace(0);
+	stations = (struct macsim_station_t **) malloc(c->stations * sizeof(struct macsim_station_t *));
+	service = (double *) malloc(c->stations * sizeof(double));
+	for(k = 0; k < c->stations; k++){
+		snprintf(name, sizeof(name), "s%d", k);
+		stations[k] = macsim_station_create(name);
+	}
+	side = (int) sqrt(c->stations);
+	net_service(c);
+
+	/* Población inicial o primera llegada */
+	if(c->closed){
+		for(next_client = 0; next_client < 2 * c->stations; next_client++)
+			macsim_schedule_ns(ARRIVE(next_client % c->stations), next_client, 0);
+	}
+	else
+		macsim_schedule(source, next_client++, macsim_exponential(1.0));
+
+	for(i = 0; i < c->events + warmup; i++){
+		if(i == warmup){
+			macsim_reset_statistics();
+			bench_start(result);
+		}
+
+		macsim_extract(&kind, &client);
+		if(kind == source){
+			macsim_schedule(source, next_client++, macsim_exponential(1.0));
+			macsim_schedule_ns(ARRIVE(net_entry(c)), client, 0);
+			continue;
+		}
+
+		k = kind / 2;
+		if(kind == ARRIVE(k)){
+			if(macsim_station_request(stations[k], client) == MACSIM_USING_STATION)
+				macsim_schedule(DEPART(k), client, macsim_exponential(service[k]));
+			continue;
+		}
+
+		macsim_station_leave(stations[k], client);
+		k = net_route(c, k);
+		if(k >= 0)
+			macsim_schedule_ns(ARRIVE(k), client, 0);
+	}
+	bench_stop(result, c->events);
+
+	result->oracle = c->closed || c->events / c->stations >= NET_ORACLE_EVENTS;
+	if(result->oracle)
+		result->oracle_error = net_oracle(c);
+
+	macsim_exit();
+	free(stations);
+	free(service);
+}
+
+
+/* La misma red cerrada descrita con macsim_network_t y simulada por el motor de la librería.
+ * El horizonte se elige para procesar unos \events eventos según la productividad de MVA. */
+static void network_builtin(void *arg, struct bench_result_t *result){
+	struct net_case_t *c = (struct net_case_t *) arg;
+	struct macsim_network_t *net = macsim_network_create(c->stations);
+	struct macsim_result_t *results = (struct macsim_result_t *) malloc(c->stations * sizeof(struct macsim_result_t));
+	struct macsim_analytic_t *model;
+	double expected = 0, measured = 0;
+	long long events;
+	int k, row, col;
+	char name[32];
+
+	macsim_init();
+	macsim_trace(0);
+	stations = (struct macsim_station_t **) malloc(c->stations * sizeof(struct macsim_station_t *));
+	service = (double *) malloc(c->stations * sizeof(double));
+	for(k = 0; k < c->stations; k++){
+		snprintf(name, sizeof(name), "s%d", k);
+		stations[k] = macsim_station_create(name);
+	}
+	side = (int) sqrt(c->stations);
+	net_service(c);
+
+	for(k = 0; k < c->stations; k++){
+		macsim_network_service(net, k, MACSIM_DIST_EXPONENTIAL, service[k], 0);
+		macsim_network_population(net, k, 2);
+		switch(c->topology){
+		case NET_TANDEM:
+			macsim_network_route(net, k, (k + 1) % c->stations, 1);
+			break;
+		case NET_CENTRAL:
+			if(k)
+				macsim_network_route(net, k, 0, 1);
+			else{
+				for(row = 1; row < c->stations; row++)
+					macsim_network_route(net, 0, row, 1.0 / (c->stations - 1));
+			}
+			break;
+		case NET_MESH:
+			row = k / side;
+			col = k % side;
+			macsim_network_route(net, k, row * side + (col + 1) % side, 0.5);
+			macsim_network_route(net, k, ((row + 1) % side) * side + col, 0.5);
+			break;
+		}
+	}
+
+	/* Solución analítica */
+	model = net_analytic(c);
+	macsim_analytic_mva(model, 2 * c->stations, results);
+	for(k = 0; k < c->stations; k++)
+		expected += results[k].throughput;
+	macsim_analytic_free(model);
+
+	bench_start(result);
+	events = macsim_network_run_closed(net, c->events / expected, results, NULL);
+	bench_stop(result, events);
+
+	for(k = 0; k < c->stations; k++)
+		measured += results[k].throughput;
+	result->oracle = 1;
+	result->oracle_error = fabs(measured - expected) / expected;
+
+	macsim_network_free(net);
+	macsim_exit();
+	free(results);
+	free(stations);
+	free(service);
+}
+
+
+int main(int argc, char **argv){
+	struct net_case_t c;
+	char params[128];
+	int maxstations = bench_arg(argc, argv, "maxstations", 10000), n;
+
+	c.events = bench_arg(argc, argv, "events", 1000000);
+	for(c.topology = 0; c.topology < NET_TOPOLOGIES; c.topology++){
+		for(c.closed = 0; c.closed < 3; c.closed++){
+			for(n = 10; n <= maxstations; n *= 10){
+				/* La malla necesita un número cuadrado de estaciones */
+				c.stations = n;
+				if(c.topology == NET_MESH)
+					c.stations = (int) sqrt(n) * (int) sqrt(n);
+				snprintf(params, sizeof(params), "\"topology\":\"%s\",\"model\":\"%s\",\"stations\":%d",
+					topology_names[c.topology], model_names[c.closed], c.stations);
+				bench_run("network", params, c.closed == 2 ? network_builtin : network, &c);
+			}
+		}
+	}
+	return bench_status();
+}
@@ -0,0 +1,229 @@
+/* Benchmark de linked_list_sort.
+ * Compara el merge sort de la librería con el quicksort recursivo que usaba antes
+ * (copiado aquí tal cual: vector auxiliar y pivote central) sobre listas de \size
+ * elementos: aleatorias, ordenadas, en orden inverso, con pocas claves distintas
+ * y una entrada adversaria para el quicksort.
+ * La entrada adversaria se construye con el adversario de McIlroy ("A killer adversary
+ * for quicksort"), que necesita tiempo cuadrático, así que usa \killer elementos.
+ * Cada caso comprueba que la lista queda ordenada, y en el merge sort que es estable.
+ *
+ * Uso: sort [size=N] [killer=N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "linked-list.h"
+#include "random.h"
+#include "debug.h"
+#include "bench.h"
+
+enum sort_input_t {
+	SORT_RANDOM = 0,
+	SORT_SORTED,
+	SORT_REVERSED,
+	SORT_FEW_KEYS,
+	SORT_KILLER,
+	SORT_INPUTS
+};
+
+static const char *input_names[SORT_INPUTS] = {"random", "sorted", "reversed", "few_keys", "killer"};
+
+enum sort_algorithm_t {
+	SORT_MERGE = 0,
+	SORT_QUICK,
+	SORT_ALGORITHMS
+};
+
+static const char *algorithm_names[SORT_ALGORITHMS] = {"merge", "quicksort"};
+
+struct sort_item_t {
+	int key;
+	int index; //Posición inicial, para comprobar la estabilidad
+};
+
+struct sort_case_t {
+	int input;
+	int algorithm;
+	int size;
+};
+
+/* Estado del adversario de McIlroy */
+static int *killer_val;
+static int killer_gas, killer_solid, killer_candidate;
+
+
+static int sort_compare(const void *a, const void *b){
+	const struct sort_item_t *x = (const struct sort_item_t *) a, *y = (const struct sort_item_t *) b;
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+
+/* Comparación del adversario: las claves se fijan la primera vez que hace falta,
+ * de modo que el pivote siempre acaba siendo el menor de los que quedan */
+static int killer_compare(const void *a, const void *b){
+	int x = ((const struct sort_item_t *) a)->index, y = ((const struct sort_item_t *) b)->index;
+
+	if(killer_val[x] == killer_gas && killer_val[y] == killer_gas){
+		if(x == killer_candidate)
+			killer_val[x] = killer_solid++;
+		else
+			killer_val[y] = killer_solid++;
+	}
+	if(killer_val[x] == killer_gas)
+		killer_candidate = x;
+	else if(killer_val[y] == killer_gas)
+		killer_candidate = y;
+	return killer_val[x] - killer_val[y];
+}
+
+
+/* Quicksort de linked_list_sort anterior */
+static void quicksort(struct linked_list_elem_t **array, int lo, int hi, int (*comp)(const void *, const void *)){
+	struct linked_list_elem_t *ptr, *tmp;
+	int i = lo, j = hi;
+
+	ptr = array[(lo + hi) / 2];
+	do {
+		while (comp(array[i]->data, ptr->data) < 0)
+			i++;
+		while (comp(array[j]->data, ptr->data) > 0)
+			j--;
+		if (i <= j) {
+			tmp = array[i];
+			array[i] = array[j];
+			array[j] = tmp;
+			i++, j--;
+		}
+	} while (i <= j);
+	if (lo < j)
+		quicksort(array, lo, j, comp);
+	if (i < hi)
+		quicksort(array, i, hi, comp);
+}
+
+
+static void quicksort_list(struct linked_list_t *list, int (*comp)(const void *, const void *)){
+	struct linked_list_elem_t **array;
+	int i;
+
+	if (!list->count)
+		return;
+	array = calloc(list->count, sizeof(struct linked_list_elem_t *));
+	if (!array)
+		fatal("%s: out of memory", __func__);
+	list->current = list->head;
+	for (i = 0; i < list->count; i++)
+	{
+		array[i] = list->current;
+		list->current = list->current->next;
+	}
+	quicksort(array, 0, list->count - 1, comp);
+	list->head = array[0];
+	list->tail = array[list->count - 1];
+	for (i = 0; i < list->count; i++)
+	{
+		array[i]->prev = i > 0 ? array[i - 1] : NULL;
+		array[i]->next = i < list->count - 1 ? array[i + 1] : NULL;
+	}
+	free(array);
+	list->current_index = 0;
+	list->current = list->head;
+}
+
+
+/* Claves de la entrada */
+static void sort_fill(struct sort_item_t *items, int input, int size){
+	struct linked_list_t *list;
+	long state = 1;
+	int i;
+
+	for(i = 0; i < size; i++){
+		items[i].index = i;
+		switch(input){
+		case SORT_RANDOM:
+			items[i].key = macsim_random_r(&state) * size;
+			break;
+		case SORT_SORTED:
+			items[i].key = i;
+			break;
+		case SORT_REVERSED:
+			items[i].key = size - i;
+			break;
+		case SORT_FEW_KEYS:
+			items[i].key = macsim_random_r(&state) * 16;
+			break;
+		}
+	}
+	if(input != SORT_KILLER)
+		return;
+
+	/* Ordenar con el adversario y usar las claves que ha fijado */
+	killer_val = (int *) malloc(size * sizeof(int));
+	if(!killer_val)
+		fatal("%s: out of memory", __func__);
+	killer_gas = size;
+	killer_solid = 0;
+	killer_candidate = 0;
+	for(i = 0; i < size; i++)
+		killer_val[i] = killer_gas;
+	list = linked_list_create();
+	for(i = 0; i < size; i++)
+		linked_list_add(list, &items[i]);
+	quicksort_list(list, killer_compare);
+	linked_list_free(list);
+	for(i = 0; i < size; i++)
+		items[i].key = killer_val[i];
+	free(killer_val);
+}
+
+
+static void sort(void *arg, struct bench_result_t *result){
+	struct sort_case_t *c = (struct sort_case_t *) arg;
+	struct sort_item_t *items, *item, *prev = NULL;
+	struct linked_list_t *list;
+	int i;
+
+	items = (struct sort_item_t *) malloc(c->size * sizeof(struct sort_item_t));
+	if(!items)
+		fatal("%s: out of memory", __func__);
+	sort_fill(items, c->input, c->size);
+	list = linked_list_create();
+	for(i = 0; i < c->size; i++)
+		linked_list_add(list, &items[i]);
+
+	bench_start(result);
+	if(c->algorithm == SORT_MERGE)
+		linked_list_sort(list, sort_compare);
+	else
+		quicksort_list(list, sort_compare);
+	bench_stop(result, c->size);
+
+	/* Comprobar el resultado */
+	if(linked_list_count(list) != c->size || !linked_list_sorted(list, sort_compare))
+		fatal("%s: list not sorted", __func__);
+	LINKED_LIST_FOR_EACH(list){
+		item = (struct sort_item_t *) linked_list_get(list);
+		if(c->algorithm == SORT_MERGE && prev && prev->key == item->key && prev->index > item->index)
+			fatal("%s: merge sort not stable", __func__);
+		prev = item;
+	}
+	linked_list_free(list);
+	free(items);
+}
+
+
+int main(int argc, char **argv){
+	struct sort_case_t c;
+	char params[128];
+	int size = bench_arg(argc, argv, "size", 1000000);
+	int killer = bench_arg(argc, argv, "killer", 20000);
+
+	for(c.input = 0; c.input < SORT_INPUTS; c.input++){
+		c.size = c.input == SORT_KILLER ? killer : size;
+		for(c.algorithm = 0; c.algorithm < SORT_ALGORITHMS; c.algorithm++){
+			snprintf(params, sizeof(params), "\"input\":\"%s\",\"algorithm\":\"%s\",\"size\":%d",
+				input_names[c.input], algorithm_names[c.algorithm], c.size);
+			bench_run("sort", params, sort, &c);
+		}
+	}
+	return bench_status();
+}
@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "network.h"
+#include "random.h"
+#include "debug.h"
+
+/* Motor propio para redes cerradas, con estaciones FCFS y de retardo y varias clases de clientes.
+ *
+ * No usa la cola de eventos ni las estaciones de la librería: los clientes son un vector fijo,
+ * las colas de las estaciones son listas enlazadas por índice dentro de ese vector y el único
+ * tipo de evento es el fin de servicio (o de reflexión), que guarda un montículo binario propio
+ * con un evento como mucho por cliente. Las llegadas son instantáneas y se tratan en el mismo
+ * paso que la salida que las provoca.
+ *
+ * El destino de cada salida se elige con una tabla alias (Walker/Vose) por clase y estación,
+ * con un solo número aleatorio y sin recorrer las rutas. Los servicios y el encaminamiento en
+ * una estación usan su stream (macsim_network_streams), como en los demás motores.
+ *
+ * Los eventos simultáneos se procesan en el orden en que se planificaron. */
+
+/* Estructuras */
+/* Tabla alias de las rutas de una clase en una estación */
+struct closed_alias_t {
+	int count; //Número de destinos (0 si la clase no pasa por la estación)
+	int *to; //Destino de cada casilla
+	int *alias; //Destino alternativo de cada casilla
+	double *prob; //Probabilidad de quedarse con 'to'
+};
+
+struct closed_client_t {
+	int cls;
+	int station;
+	int next; //Siguiente cliente en la cola de la estación (-1 si es el último)
+	int reserved;
+	long long entry; //Llegada a la estación
+	long long start; //Inicio del servicio
+	long long cycle_start; //Última llegada a la estación de referencia (-1 si aún no ha pasado)
+};
+
+struct closed_station_t {
+	int head, tail; //Cola FCFS; el primero es el que está en servicio (-1 si está vacía)
+	int delay;
+	long stream;
+	long long clients, response, service; //Estadísticas en ns
+	const struct macsim_dist_t *dist;
+};
+
+struct closed_event_t {
+	long long time;
+	long long seq; //Orden de planificación, para desempatar
+	int client;
+	int reserved;
+};
+
+struct closed_engine_t {
+	struct macsim_network_t *net;
+	struct closed_client_t *clients;
+	struct closed_station_t *stations;
+	struct closed_alias_t *alias; //class_count * count tablas
+	int *reference; //Estación de referencia de cada clase
+	long long *cycles, *cycle_time; //Por clase
+	struct closed_event_t *heap;
+	int heap_count;
+	long long seq;
+	long long now, end;
+};
+
+
+/* Función privada que construye la tabla alias de \count rutas con el método de Vose */
+static void closed_alias_build(struct closed_alias_t *table, const int *to, const double *prob, int count){
+	int *small, *large;
+	double *scaled;
+	int i, s, l, small_count = 0, large_count = 0;
+
+	table->count = count;
+	table->to = (int *) malloc(count * sizeof(int));
+	table->alias = (int *) malloc(count * sizeof(int));
+	table->prob = (double *) malloc(count * sizeof(double));
+	scaled = (double *) malloc(count * sizeof(double));
+	small = (int *) malloc(count * sizeof(int));
+	large = (int *) malloc(count * sizeof(int));
+	if(!table->to || !table->alias || !table->prob || !scaled || !small || !large)
+		fatal("%s: out of memory", __func__);
+
+	for(i = 0; i < count; i++){
+		table->to[i] = to[i];
+		table->alias[i] = to[i];
+		scaled[i] = prob[i] * count;
+		if(scaled[i] < 1)
+			small[small_count++] = i;
+		else
+			large[large_count++] = i;
+	}
+	while(small_count && large_count){
+		s = small[--small_count];
+		l = large[--large_count];
+		table->prob[s] = scaled[s];
+		table->alias[s] = to[l];
+		scaled[l] -= 1 - scaled[s];
+		if(scaled[l] < 1)
+			small[small_count++] = l;
+		else
+			large[large_count++] = l;
+	}
+	/* Lo que queda vale 1 salvo errores de redondeo */
+	while(large_count)
+		table->prob[large[--large_count]] = 1;
+	while(small_count)
+		table->prob[small[--small_count]] = 1;
+
+	free(scaled);
+	free(small);
+	free(large);
+}
+
+
+/* Función privada que reúne las rutas de la clase \cls en la estación \k
+ * @return Número de rutas, que quedan en \to y \prob */
+static int closed_routes(struct macsim_network_t *net, int cls, int k, int *to, double *prob){
+	struct macsim_network_class_t *c = &net->classes[cls];
+	int r, n = 0;
+
+	if(!cls){
+		for(r = 0; r < net->stations[k].route_count; r++, n++){
+			to[n] = net->stations[k].routes[r].to;
+			prob[n] = net->stations[k].routes[r].prob;
+		}
+		return n;
+	}
+	for(r = 0; r < c->route_count; r++){
+		if(c->routes[r].from == k){
+			to[n] = c->routes[r].to;
+			prob[n++] = c->routes[r].prob;
+		}
+	}
+	return n;
+}
+
+
+/* Función privada que devuelve la población inicial de la clase \cls en la estación \k */
+static int closed_population(struct macsim_network_t *net, int cls, int k){
+	return cls ? net->classes[cls].population[k] : net->stations[k].population;
+}
+
+
+/* Función privada que construye las tablas alias de todas las clases, comprobando que
+ * desde las estaciones por las que pasa cada clase no se puede salir de la red */
+static void closed_tables(struct closed_engine_t *engine){
+	struct macsim_network_t *net = engine->net;
+	int *to, *reached, *stack;
+	double *prob, sum;
+	int cls, k, n, r, top, max_routes = 0;
+
+	for(k = 0; k < net->count; k++){
+		if(net->stations[k].route_count > max_routes)
+			max_routes = net->stations[k].route_count;
+	}
+	for(cls = 1; cls < net->class_count; cls++){
+		if(net->classes[cls].route_count > max_routes)
+			max_routes = net->classes[cls].route_count;
+	}
+	to = (int *) malloc((max_routes + 1) * sizeof(int));
+	prob = (double *) malloc((max_routes + 1) * sizeof(double));
+	reached = (int *) malloc(net->count * sizeof(int));
+	stack = (int *) malloc(net->count * sizeof(int));
+	if(!to || !prob || !reached || !stack)
+		fatal("%s: out of memory", __func__);
+
+	for(cls = 0; cls < net->class_count; cls++){
+		/* Estaciones alcanzables desde la población inicial */
+		memset(reached, 0, net->count * sizeof(int));
+		for(k = 0, top = 0; k < net->count; k++){
+			if(closed_population(net, cls, k)){
+				reached[k] = 1;
+				stack[top++] = k;
+			}
+		}
+		while(top){
+			k = stack[--top];
+			n = closed_routes(net, cls, k, to, prob);
+			for(r = 0, sum = 0; r < n; r++){
+				sum += prob[r];
+				if(prob[r] > 0 && !reached[to[r]]){
+					reached[to[r]] = 1;
+					stack[top++] = to[r];
+				}
+			}
+			if(fabs(sum - 1) > 1e-6)
+				fatal("%s: routing probabilities of \"%s\" in class \"%s\" add up to %f in a closed network",
+					__func__, net->stations[k].name, net->classes[cls].name, sum);
+			closed_alias_build(&engine->alias[cls * net->count + k], to, prob, n);
+		}
+
+		/* Estación de referencia: la indicada o la primera con clientes de la clase */
+		engine->reference[cls] = net->classes[cls].reference;
+		for(k = 0; engine->reference[cls] < 0 && k < net->count; k++){
+			if(closed_population(net, cls, k))
+				engine->reference[cls] = k;
+		}
+	}
+
+	free(to);
+	free(prob);
+	free(reached);
+	free(stack);
+}
+
+
+/* Función privada que planifica el fin de servicio de \client dentro de \ns */
+static void closed_schedule(struct closed_engine_t *engine, int client, long long ns){
+	struct closed_event_t event, *heap = engine->heap;
+	int i, parent;
+
+	event.time = engine->now + ns;
+	event.seq = engine->seq++;
+	event.client = client;
+	event.reserved = 0;
+	for(i = engine->heap_count++; i > 0; i = parent){
+		parent = (i - 1) / 2;
+		if(heap[parent].time < event.time || (heap[parent].time == event.time && heap[parent].seq < event.seq))
+			break;
+		heap[i] = heap[parent];
+	}
+	heap[i] = event;
+}
+
+
+/* Función privada que extrae el evento más próximo, que debe existir */
+static struct closed_event_t closed_extract(struct closed_engine_t *engine){
+	struct closed_event_t *heap = engine->heap, first = heap[0], last;
+	int i, child, count;
+
+	count = --engine->heap_count;
+	last = heap[count];
+	for(i = 0; (child = 2 * i + 1) < count; i = child){
+		if(child + 1 < count && (heap[child + 1].time < heap[child].time ||
+			(heap[child + 1].time == heap[child].time && heap[child + 1].seq < heap[child].seq)))
+			child++;
+		if(last.time < heap[child].time || (last.time == heap[child].time && last.seq < heap[child].seq))
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+	return first;
+}
+
+
+/* Función privada que empieza el servicio de \client en su estación */
+static void closed_serve(struct closed_engine_t *engine, int client){
+	struct closed_station_t *s = &engine->stations[engine->clients[client].station];
+	engine->clients[client].start = engine->now;
+	closed_schedule(engine, client, (long long) (macsim_dist_sample(s->dist, &s->stream) * 1000000));
+}
+
+
+/* Función privada para la llegada de \client a la estación \k */
+static void closed_arrive(struct closed_engine_t *engine, int client, int k){
+	struct closed_client_t *c = &engine->clients[client];
+	struct closed_station_t *s = &engine->stations[k];
+
+	c->station = k;
+	c->entry = engine->now;
+	if(k == engine->reference[c->cls]){
+		if(c->cycle_start >= 0){
+			engine->cycles[c->cls]++;
+			engine->cycle_time[c->cls] += engine->now - c->cycle_start;
+		}
+		c->cycle_start = engine->now;
+	}
+
+	if(s->delay){
+		closed_serve(engine, client);
+		return;
+	}
+	c->next = -1;
+	if(s->head < 0){
+		s->head = s->tail = client;
+		closed_serve(engine, client);
+	}
+	else{
+		engine->clients[s->tail].next = client;
+		s->tail = client;
+	}
+}
+
+
+/* Función privada que elige el destino de \client con la tabla alias de su clase y estación */
+static int closed_next(struct closed_engine_t *engine, struct closed_client_t *c, struct closed_station_t *s){
+	struct closed_alias_t *table = &engine->alias[c->cls * engine->net->count + c->station];
+	double u = macsim_random_r(&s->stream) * table->count;
+	int i = (int) u;
+
+	if(i >= table->count) //Por redondeo
+		i = table->count - 1;
+	return u - i < table->prob[i] ? table->to[i] : table->alias[i];
+}
+
+
+/* Simula una red cerrada durante \horizon_ms con un motor propio, sin pasar por la cola de
+ * eventos de la librería ni por código de usuario. Admite estaciones de retardo
+ * (macsim_network_delay) y varias clases (macsim_network_class_create), cada una con su población
+ * y su encaminamiento; desde las estaciones por las que pasa una clase no se puede abandonar la red.
+ * \results recibe los resultados de cada estación, como macsim_report, y \class_results (si no es
+ * NULL) los tiempos de ciclo de cada clase.
+ * @return Número de eventos procesados */
+long long macsim_network_run_closed(struct macsim_network_t *net, double horizon_ms, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results){
+	struct closed_engine_t engine;
+	struct closed_event_t event;
+	struct closed_client_t *c;
+	struct closed_station_t *s;
+	long *service_streams, *arrival_streams;
+	long long events = 0;
+	int k, cls, j, n, client, population = 0;
+
+	for(k = 0; k < net->count; k++){
+		if(net->stations[k].arrivals.type != MACSIM_DIST_NONE)
+			fatal("%s: station \"%s\" has external arrivals in a closed network", __func__, net->stations[k].name);
+		for(cls = 0; cls < net->class_count; cls++)
+			population += closed_population(net, cls, k);
+	}
+
+	memset(&engine, 0, sizeof(engine));
+	engine.net = net;
+	engine.clients = (struct closed_client_t *) calloc(population ? population : 1, sizeof(struct closed_client_t));
+	engine.heap = (struct closed_event_t *) malloc((population ? population : 1) * sizeof(struct closed_event_t));
+	engine.stations = (struct closed_station_t *) calloc(net->count, sizeof(struct closed_station_t));
+	engine.alias = (struct closed_alias_t *) calloc(net->class_count * net->count, sizeof(struct closed_alias_t));
+	engine.reference = (int *) malloc(net->class_count * sizeof(int));
+	engine.cycles = (long long *) calloc(net->class_count, sizeof(long long));
+	engine.cycle_time = (long long *) calloc(net->class_count, sizeof(long long));
+	service_streams = (long *) malloc(net->count * sizeof(long));
+	arrival_streams = (long *) malloc(net->count * sizeof(long));
+	if(!engine.clients || !engine.heap || !engine.stations || !engine.alias || !engine.reference ||
+		!engine.cycles || !engine.cycle_time || !service_streams || !arrival_streams)
+		fatal("%s: out of memory", __func__);
+
+	closed_tables(&engine);
+	macsim_network_streams(net, service_streams, arrival_streams);
+	for(k = 0; k < net->count; k++){
+		engine.stations[k].head = engine.stations[k].tail = -1;
+		engine.stations[k].delay = net->stations[k].delay;
+		engine.stations[k].stream = service_streams[k];
+		engine.stations[k].dist = &net->stations[k].service;
+	}
+	engine.end = (long long) (horizon_ms * 1000000);
+
+	/* Clientes iniciales, por orden de clase y estación */
+	for(cls = 0, client = 0; cls < net->class_count; cls++){
+		for(k = 0; k < net->count; k++){
+			for(n = closed_population(net, cls, k); n > 0; n--, client++){
+				engine.clients[client].cls = cls;
+				engine.clients[client].cycle_start = -1;
+				closed_arrive(&engine, client, k);
+			}
+		}
+	}
+
+	while(engine.heap_count){
+		event = closed_extract(&engine);
+		if(event.time >= engine.end)
+			break;
+		engine.now = event.time;
+		events++;
+		c = &engine.clients[event.client];
+		s = &engine.stations[c->station];
+
+		/* Salida y estadísticas */
+		s->clients++;
+		s->response += engine.now - c->entry;
+		s->service += engine.now - c->start;
+		if(!s->delay){
+			s->head = c->next;
+			if(s->head >= 0)
+				closed_serve(&engine, s->head);
+		}
+
+		/* Siguiente estación */
+		j = closed_next(&engine, c, s);
+		closed_arrive(&engine, event.client, j);
+	}
+
+	for(k = 0; k < net->count; k++)
+		macsim_network_result(&results[k], net->stations[k].name, engine.stations[k].clients,
+			engine.stations[k].response, engine.stations[k].service, engine.end);
+	for(cls = 0; class_results && cls < net->class_count; cls++){
+		memset(&class_results[cls], 0, sizeof(class_results[cls]));
+		class_results[cls].name = net->classes[cls].name;
+		class_results[cls].cycles = engine.cycles[cls];
+		if(engine.cycles[cls])
+			class_results[cls].cycle_time = engine.cycle_time[cls] / (double) engine.cycles[cls] / 1000000.0;
+		if(engine.end > 0)
+			class_results[cls].throughput = engine.cycles[cls] / (double) engine.end * 1000000;
+	}
+
+	for(k = 0; k < net->class_count * net->count; k++){
+		free(engine.alias[k].to);
+		free(engine.alias[k].alias);
+		free(engine.alias[k].prob);
+	}
+	free(engine.alias);
+	free(engine.clients);
+	free(engine.heap);
+	free(engine.stations);
+	free(engine.reference);
+	free(engine.cycles);
+	free(engine.cycle_time);
+	free(service_streams);
+	free(arrival_streams);
+	return events;
+}
@@ -0,0 +1,554 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "ext-queue.h"
+
+
+/* element header; the record follows it */
+struct ext_queue_elem_t {
+	long long key;
+	long long stamp;  /* insertion order, for equal keys */
+};
+
+/* sorted run, a range of the file read through a window */
+struct ext_queue_run_t {
+	off_t start, end;  /* part of the range not read yet */
+	char *window;
+	size_t next, size;  /* offset of the next element, bytes in the window */
+};
+
+struct ext_queue_t {
+	char *dir;
+	int record_size;
+	int elem_size;  /* header plus record, rounded up to 8 bytes */
+	long long count;
+	long long stamp;
+	int error;
+
+	/* file holding the runs one after another */
+	int fd;
+	off_t file_size;
+	size_t window_size;  /* whole elements */
+
+	/* insertion buffer, an in-memory run that takes part in the merge:
+	 * elements [head, sorted) are sorted and [sorted, count) are the ones
+	 * inserted since the last peek */
+	char *buffer;
+	int buffer_head, buffer_sorted, buffer_count, buffer_size;
+	char *aux;  /* for merging the unsorted part into the sorted one */
+	int aux_size;
+
+	/* runs, and a heap of run indices ordered by their next element */
+	struct ext_queue_run_t *run;
+	int run_count, run_size, max_runs;
+	int *merge;
+};
+
+
+
+
+/* Private Methods */
+
+/* compare two elements by key and insertion order */
+static int ext_queue_compare(const void *a, const void *b)
+{
+	const struct ext_queue_elem_t *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return (x->stamp > y->stamp) - (x->stamp < y->stamp);
+}
+
+
+/* next element of a run of the merge heap */
+static inline struct ext_queue_elem_t *ext_queue_head(struct ext_queue_t *queue, int i)
+{
+	struct ext_queue_run_t *run = &queue->run[queue->merge[i]];
+	return (struct ext_queue_elem_t *) (run->window + run->next);
+}
+
+
+/* element 'i' of the buffer */
+static inline struct ext_queue_elem_t *ext_queue_buffer_elem(struct ext_queue_t *queue, int i)
+{
+	return (struct ext_queue_elem_t *) (queue->buffer + (size_t) i * queue->elem_size);
+}
+
+
+/* sort the live part of the buffer; a small unsorted part is sorted on
+ * its own and merged backwards with the sorted one, so alternating
+ * insertions and peeks don't sort the whole buffer each time */
+static int ext_queue_sort_buffer(struct ext_queue_t *queue)
+{
+	int live = queue->buffer_count - queue->buffer_head;
+	int tail = queue->buffer_count - queue->buffer_sorted;
+	int i, j, k;
+	char *naux;
+
+	if (!tail)
+		return 1;
+	if (tail * 4 >= live) {
+		qsort(ext_queue_buffer_elem(queue, queue->buffer_head), live, queue->elem_size, ext_queue_compare);
+		queue->buffer_sorted = queue->buffer_count;
+		return 1;
+	}
+	if (tail > queue->aux_size) {
+		naux = realloc(queue->aux, (size_t) tail * queue->elem_size);
+		if (!naux) {
+			queue->error = EXT_QUEUE_ENOMEM;
+			return 0;
+		}
+		queue->aux = naux;
+		queue->aux_size = tail;
+	}
+	qsort(ext_queue_buffer_elem(queue, queue->buffer_sorted), tail, queue->elem_size, ext_queue_compare);
+	memcpy(queue->aux, ext_queue_buffer_elem(queue, queue->buffer_sorted), (size_t) tail * queue->elem_size);
+	i = queue->buffer_sorted - 1;
+	j = tail - 1;
+	for (k = queue->buffer_count - 1; j >= 0; k--) {
+		if (i >= queue->buffer_head && ext_queue_compare(ext_queue_buffer_elem(queue, i), queue->aux + (size_t) j * queue->elem_size) > 0)
+			memcpy(ext_queue_buffer_elem(queue, k), ext_queue_buffer_elem(queue, i--), queue->elem_size);
+		else
+			memcpy(ext_queue_buffer_elem(queue, k), queue->aux + (size_t) j-- * queue->elem_size, queue->elem_size);
+	}
+	queue->buffer_sorted = queue->buffer_count;
+	return 1;
+}
+
+
+/* read the next window of a run; the part of the file already read is
+ * given back to the file system where it supports punching holes */
+static int ext_queue_read(struct ext_queue_t *queue, struct ext_queue_run_t *run)
+{
+	size_t size = queue->window_size, done;
+	ssize_t n;
+
+	if (run->end - run->start < (off_t) size)
+		size = run->end - run->start;
+	for (done = 0; done < size; done += n) {
+		n = pread(queue->fd, run->window + done, size - done, run->start + done);
+		if (n <= 0) {
+			queue->error = EXT_QUEUE_EIO;
+			return 0;
+		}
+	}
+	if (fallocate(queue->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, run->start, size) &&
+			errno != EOPNOTSUPP && errno != ENOSYS) {
+		queue->error = EXT_QUEUE_EIO;
+		return 0;
+	}
+	run->start += size;
+	run->next = 0;
+	run->size = size;
+	return 1;
+}
+
+
+/* sift down position 'i' of the merge heap */
+static void ext_queue_sift_down(struct ext_queue_t *queue, int i)
+{
+	int l, r, k, tmp;
+
+	for (;;) {
+		l = 2 * i + 1;
+		r = 2 * i + 2;
+		k = i;
+		if (l < queue->run_count && ext_queue_compare(ext_queue_head(queue, l), ext_queue_head(queue, k)) < 0)
+			k = l;
+		if (r < queue->run_count && ext_queue_compare(ext_queue_head(queue, r), ext_queue_head(queue, k)) < 0)
+			k = r;
+		if (k == i)
+			break;
+		tmp = queue->merge[i];
+		queue->merge[i] = queue->merge[k];
+		queue->merge[k] = tmp;
+		i = k;
+	}
+}
+
+
+/* smallest element, from the buffer or from the runs; NULL on error */
+static struct ext_queue_elem_t *ext_queue_min(struct ext_queue_t *queue, int *from_buffer)
+{
+	struct ext_queue_elem_t *elem = NULL;
+
+	if (!queue->count) {
+		queue->error = EXT_QUEUE_EEMPTY;
+		return NULL;
+	}
+	if (!ext_queue_sort_buffer(queue))
+		return NULL;
+	*from_buffer = queue->buffer_head < queue->buffer_count;
+	if (*from_buffer)
+		elem = ext_queue_buffer_elem(queue, queue->buffer_head);
+	if (queue->run_count && (!elem || ext_queue_compare(ext_queue_head(queue, 0), elem) < 0)) {
+		elem = ext_queue_head(queue, 0);
+		*from_buffer = 0;
+	}
+	return elem;
+}
+
+
+/* write 'size' bytes at 'offset' of the run file */
+static int ext_queue_write(struct ext_queue_t *queue, const char *data, size_t size, off_t offset)
+{
+	size_t done;
+	ssize_t n;
+
+	for (done = 0; done < size; done += n) {
+		n = pwrite(queue->fd, data + done, size - done, offset + done);
+		if (n <= 0) {
+			queue->error = EXT_QUEUE_EIO;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/* rebuild the merge heap over all the runs */
+static void ext_queue_heapify(struct ext_queue_t *queue)
+{
+	int i;
+
+	for (i = 0; i < queue->run_count; i++)
+		queue->merge[i] = i;
+	for (i = queue->run_count / 2 - 1; i >= 0; i--)
+		ext_queue_sift_down(queue, i);
+}
+
+
+/* bytes of a run not extracted yet */
+static inline off_t ext_queue_left(struct ext_queue_run_t *run)
+{
+	return run->end - run->start + (off_t) (run->size - run->next);
+}
+
+
+/* merge half of the runs into a new one at the end of the file, so that
+ * no more than 'max_runs' read windows are ever allocated. The runs merged
+ * are the ones with less left to read, usually the oldest, which have
+ * been drained the most: merging runs of similar size rewrites each
+ * element a logarithmic number of times, where always merging the oldest
+ * would copy the same growing run again and again. After an error the
+ * queue can't be used any more */
+static int ext_queue_compact(struct ext_queue_t *queue)
+{
+	struct ext_queue_run_t *run, tmp;
+	int n = queue->run_count / 2, total = queue->run_count, i, j;
+	off_t start = queue->file_size, end = start;
+	size_t used = 0;
+	char *out;
+
+	if (n < 2)
+		n = total;
+	out = malloc(queue->window_size);
+	if (!out) {
+		queue->error = EXT_QUEUE_ENOMEM;
+		return 0;
+	}
+
+	/* the runs to merge go to the front of the array, and for the merge
+	 * the heap only holds them */
+	for (i = 1; i < total; i++) {
+		tmp = queue->run[i];
+		for (j = i; j > 0 && ext_queue_left(&queue->run[j - 1]) > ext_queue_left(&tmp); j--)
+			queue->run[j] = queue->run[j - 1];
+		queue->run[j] = tmp;
+	}
+	queue->run_count = n;
+	ext_queue_heapify(queue);
+
+	while (queue->run_count) {
+		memcpy(out + used, ext_queue_head(queue, 0), queue->elem_size);
+		used += queue->elem_size;
+		if (used == queue->window_size) {
+			if (!ext_queue_write(queue, out, used, end))
+				goto error;
+			end += used;
+			used = 0;
+		}
+		run = &queue->run[queue->merge[0]];
+		run->next += queue->elem_size;
+		if (run->next == run->size && run->start == run->end)
+			queue->merge[0] = queue->merge[--queue->run_count];
+		else if (run->next == run->size && !ext_queue_read(queue, run))
+			goto error;
+		ext_queue_sift_down(queue, 0);
+	}
+	if (!ext_queue_write(queue, out, used, end))
+		goto error;
+	end += used;
+	free(out);
+	out = NULL;
+
+	/* the merged run replaces the ones it came from */
+	for (i = 0; i < n; i++)
+		free(queue->run[i].window);
+	memmove(queue->run, queue->run + n, (total - n) * sizeof(struct ext_queue_run_t));
+	queue->run_count = total - n;
+	run = &queue->run[queue->run_count];
+	run->start = start;
+	run->end = end;
+	run->window = malloc(end - start < (off_t) queue->window_size ? (size_t) (end - start) : queue->window_size);
+	if (!run->window) {
+		queue->error = EXT_QUEUE_ENOMEM;
+		return 0;
+	}
+	if (!ext_queue_read(queue, run)) {
+		free(run->window);
+		return 0;
+	}
+	queue->file_size = end;
+	queue->run_count++;
+	ext_queue_heapify(queue);
+	return 1;
+
+error:
+	free(out);
+	return 0;
+}
+
+
+/* sort the live part of the buffer and write it as a new run */
+static int ext_queue_flush(struct ext_queue_t *queue)
+{
+	struct ext_queue_run_t *nrun, *run;
+	size_t size = (size_t) (queue->buffer_count - queue->buffer_head) * queue->elem_size;
+	int *nmerge, i;
+	char *path;
+
+	if (queue->buffer_head == queue->buffer_count)
+		return 1;
+	if (!ext_queue_sort_buffer(queue))
+		return 0;
+	if (queue->run_count >= queue->max_runs && !ext_queue_compact(queue))
+		return 0;
+	if (queue->run_count == queue->run_size) {
+		queue->run_size = queue->run_size ? queue->run_size * 2 : 16;
+		nrun = realloc(queue->run, queue->run_size * sizeof(struct ext_queue_run_t));
+		nmerge = nrun ? realloc(queue->merge, queue->run_size * sizeof(int)) : NULL;
+		if (nrun)
+			queue->run = nrun;
+		if (nmerge)
+			queue->merge = nmerge;
+		if (!nrun || !nmerge) {
+			queue->error = EXT_QUEUE_ENOMEM;
+			return 0;
+		}
+	}
+	run = &queue->run[queue->run_count];
+	run->window = malloc(size < queue->window_size ? size : queue->window_size);
+	if (!run->window) {
+		queue->error = EXT_QUEUE_ENOMEM;
+		return 0;
+	}
+
+	/* the file is unlinked as soon as it is created and lives as long as
+	 * the queue, so nothing is left behind if the program dies */
+	if (queue->fd < 0) {
+		path = malloc(strlen(queue->dir) + 32);
+		if (!path) {
+			free(run->window);
+			queue->error = EXT_QUEUE_ENOMEM;
+			return 0;
+		}
+		sprintf(path, "%s/ext-queue-XXXXXX", queue->dir);
+		queue->fd = mkstemp(path);
+		if (queue->fd >= 0)
+			unlink(path);
+		free(path);
+	}
+	run->start = queue->file_size;
+	run->end = queue->file_size + size;
+	if (queue->fd < 0 || !ext_queue_write(queue, (char *) ext_queue_buffer_elem(queue, queue->buffer_head), size, run->start) ||
+			!ext_queue_read(queue, run)) {
+		free(run->window);
+		queue->error = EXT_QUEUE_EIO;
+		return 0;
+	}
+	queue->file_size += size;
+	queue->buffer_head = queue->buffer_sorted = queue->buffer_count = 0;
+
+	/* add it to the merge heap, sifting up */
+	i = queue->run_count++;
+	queue->merge[i] = queue->run_count - 1;
+	while (i > 0 && ext_queue_compare(ext_queue_head(queue, i), ext_queue_head(queue, (i - 1) / 2)) < 0) {
+		queue->merge[i] = queue->merge[(i - 1) / 2];
+		queue->merge[(i - 1) / 2] = queue->run_count - 1;
+		i = (i - 1) / 2;
+	}
+	return 1;
+}
+
+
+
+
+/* Public Methods */
+
+/* creation */
+struct ext_queue_t *ext_queue_create(const char *dir, int record_size, int buffer, int runs)
+{
+	struct ext_queue_t *queue;
+
+	queue = calloc(1, sizeof(struct ext_queue_t));
+	if (!queue)
+		return NULL;
+	queue->dir = strdup(dir);
+	queue->record_size = record_size;
+	queue->elem_size = (sizeof(struct ext_queue_elem_t) + record_size + 7) & ~7;
+	queue->window_size = (EXT_QUEUE_WINDOW / queue->elem_size) * queue->elem_size;
+	queue->fd = -1;
+	queue->buffer_size = buffer < 1 ? 1 : buffer;
+	queue->max_runs = runs < 4 ? 4 : runs;
+	queue->buffer = malloc((size_t) queue->buffer_size * queue->elem_size);
+	if (!queue->dir || !queue->buffer) {
+		ext_queue_free(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+
+/* destruction */
+void ext_queue_free(struct ext_queue_t *queue)
+{
+	int i;
+
+	for (i = 0; i < queue->run_count; i++)
+		free(queue->run[i].window);
+	if (queue->fd >= 0)
+		close(queue->fd);
+	free(queue->run);
+	free(queue->merge);
+	free(queue->buffer);
+	free(queue->aux);
+	free(queue->dir);
+	free(queue);
+}
+
+
+/* error messages */
+int ext_queue_error(struct ext_queue_t *queue)
+{
+	return queue->error;
+}
+
+
+char *ext_queue_error_msg(struct ext_queue_t *queue)
+{
+	switch (queue->error) {
+	case EXT_QUEUE_ENOMEM: return "out of memory";
+	case EXT_QUEUE_EEMPTY: return "external queue is empty";
+	case EXT_QUEUE_EIO: return "can't write or read a run file";
+	}
+	return "";
+}
+
+
+long long ext_queue_count(struct ext_queue_t *queue)
+{
+	return queue->count;
+}
+
+
+/* number of run files */
+int ext_queue_runs(struct ext_queue_t *queue)
+{
+	return queue->run_count;
+}
+
+
+void ext_queue_insert(struct ext_queue_t *queue, long long key, const void *record)
+{
+	struct ext_queue_elem_t *elem;
+
+	/* full: drop the part already extracted, or write the rest as a run */
+	if (queue->buffer_count == queue->buffer_size && queue->buffer_head) {
+		memmove(queue->buffer, ext_queue_buffer_elem(queue, queue->buffer_head),
+			(size_t) (queue->buffer_count - queue->buffer_head) * queue->elem_size);
+		queue->buffer_count -= queue->buffer_head;
+		queue->buffer_sorted -= queue->buffer_head;
+		queue->buffer_head = 0;
+	}
+	if (queue->buffer_count == queue->buffer_size && !ext_queue_flush(queue))
+		return;
+	elem = ext_queue_buffer_elem(queue, queue->buffer_count);
+	elem->key = key;
+	elem->stamp = queue->stamp++;
+	memcpy(elem + 1, record, queue->record_size);
+	queue->buffer_count++;
+	queue->count++;
+	queue->error = 0;
+}
+
+
+long long ext_queue_peek(struct ext_queue_t *queue, void *record)
+{
+	struct ext_queue_elem_t *elem;
+	int from_buffer;
+
+	elem = ext_queue_min(queue, &from_buffer);
+	if (!elem)
+		return 0;
+	if (record)
+		memcpy(record, elem + 1, queue->record_size);
+	queue->error = 0;
+	return elem->key;
+}
+
+
+long long ext_queue_extract(struct ext_queue_t *queue, void *record)
+{
+	struct ext_queue_elem_t *elem;
+	struct ext_queue_run_t *run;
+	long long key;
+	int i, from_buffer;
+
+	elem = ext_queue_min(queue, &from_buffer);
+	if (!elem)
+		return 0;
+	key = elem->key;
+	if (record)
+		memcpy(record, elem + 1, queue->record_size);
+	queue->error = 0;
+	queue->count--;
+
+	/* from the buffer: advance its head, starting again when it's empty */
+	if (from_buffer) {
+		if (++queue->buffer_head == queue->buffer_count)
+			queue->buffer_head = queue->buffer_sorted = queue->buffer_count = 0;
+		return key;
+	}
+
+	/* advance the run, reading its next window when this one is done */
+	run = &queue->run[queue->merge[0]];
+	run->next += queue->elem_size;
+	if (run->next == run->size && run->start == run->end) {
+
+		/* finished: the last run takes its place in the array, and the
+		 * last heap entry its place at the top of the heap */
+		free(run->window);
+		*run = queue->run[--queue->run_count];
+		for (i = 0; i <= queue->run_count; i++)
+			if (queue->merge[i] == queue->run_count)
+				queue->merge[i] = queue->merge[0];
+		queue->merge[0] = queue->merge[queue->run_count];
+
+		/* nothing left in the file: start it again */
+		if (!queue->run_count) {
+			if (ftruncate(queue->fd, 0)) {
+				queue->error = EXT_QUEUE_EIO;
+				return 0;
+			}
+			queue->file_size = 0;
+		}
+	} else if (run->next == run->size && !ext_queue_read(queue, run))
+		return 0;
+	ext_queue_sift_down(queue, 0);
+	return key;
+}
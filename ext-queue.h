@@ -0,0 +1,44 @@
+#ifndef EXT_QUEUE_H
+#define EXT_QUEUE_H
+
+/* error constants */
+#define EXT_QUEUE_ENOMEM	1
+#define EXT_QUEUE_EEMPTY	2
+#define EXT_QUEUE_EIO	3
+
+#define EXT_QUEUE_WINDOW	(64 << 10)  /* bytes of each run read at once */
+
+/* External-memory priority queue of fixed-size records with integer keys.
+ * Insertions go to a buffer in memory; when it fills up it is sorted and
+ * appended as a run to a file, which is unlinked at once. The minimum is
+ * found by merging the heads of the runs with a small heap, reading each
+ * run in blocks, so memory use is the buffer plus one block per run,
+ * whatever the number of elements. Equal keys come out in insertion order.
+ * The buffer itself takes part in the merge as a sorted run in memory, so
+ * reads never write anything and only a full buffer becomes a new run.
+ * Runs are read through pread windows of EXT_QUEUE_WINDOW bytes rather
+ * than mapped; when a new run would go over the limit of open runs, the
+ * half with less left to read is first merged into one, which bounds the
+ * window memory. */
+struct ext_queue_t;
+
+/* creation and destruction; run files are created in 'dir', 'buffer'
+ * is the number of records kept in memory before writing a run and
+ * 'runs' the most runs open at once (at least 4) */
+struct ext_queue_t *ext_queue_create(const char *dir, int record_size, int buffer, int runs);
+void ext_queue_free(struct ext_queue_t *queue);
+
+/* return error occurred in last operation;
+ * 0 means success */
+int ext_queue_error(struct ext_queue_t *queue);
+char *ext_queue_error_msg(struct ext_queue_t *queue);
+
+/* operations; 'record' may be NULL in peek and extract */
+long long ext_queue_count(struct ext_queue_t *queue);
+int ext_queue_runs(struct ext_queue_t *queue);
+void ext_queue_insert(struct ext_queue_t *queue, long long key, const void *record);  /* ENOMEM, EIO */
+long long ext_queue_peek(struct ext_queue_t *queue, void *record);  /* EEMPTY, ENOMEM, EIO */
+long long ext_queue_extract(struct ext_queue_t *queue, void *record);  /* EEMPTY, ENOMEM, EIO */
+
+
+#endif
@@ -444,3 +444,37 @@ char *hash_table_find_next(struct hash_table_t *table, void **data_ptr)
 		*data_ptr = NULL;
 	return NULL;
 }
+
+
+char *hash_table_iter_first(const struct hash_table_t *table, struct hash_table_iter_t *iter, void **data_ptr)
+{
+	/* Position before the first bucket */
+	iter->index = -1;
+	iter->elem = NULL;
+	return hash_table_iter_next(table, iter, data_ptr);
+}
+
+
+char *hash_table_iter_next(const struct hash_table_t *table, struct hash_table_iter_t *iter, void **data_ptr)
+{
+	/* Next element in the same collision list */
+	if (iter->elem)
+		iter->elem = iter->elem->next;
+
+	/* Otherwise, first element of the next non-empty bucket */
+	while (!iter->elem && ++iter->index < table->size)
+		iter->elem = table->elem_vector[iter->index];
+
+	/* No more elements */
+	if (!iter->elem)
+	{
+		if (data_ptr)
+			*data_ptr = NULL;
+		return NULL;
+	}
+
+	/* Return element */
+	if (data_ptr)
+		*data_ptr = iter->elem->data;
+	return iter->elem->key;
+}
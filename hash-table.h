@@ -21,6 +21,16 @@
 #define HASH_H
 
 struct hash_table_t;
+struct hash_table_elem_t;
+
+/* External cursor for hash_table_iter_first/next. It lives in the caller, so
+ * iterations can be nested or run from several threads as long as the table
+ * is not modified meanwhile. */
+struct hash_table_iter_t
+{
+	int index;
+	struct hash_table_elem_t *elem;
+};
 
 /** Iterate through all elements of the hash table.
  *
@@ -34,6 +44,20 @@ struct hash_table_t;
 		(key) = hash_table_find_next((table), (void **) &(data)))
 
 
+/** Iterate through all elements of the hash table with an external cursor,
+ * without modifying the table.
+ *
+ * @param table
+ * @param iter  variable of type 'struct hash_table_iter_t'
+ * @param key
+ * @param data
+ */
+#define HASH_TABLE_ITER_FOR_EACH(table, iter, key, data) \
+	for ((key) = hash_table_iter_first((table), &(iter), (void **) &(data)); \
+		(key); \
+		(key) = hash_table_iter_next((table), &(iter), (void **) &(data)))
+
+
 /* Creation and destruction */
 struct hash_table_t *hash_table_create(int size, int case_sensitive);
 void hash_table_free(struct hash_table_t *table);
@@ -69,5 +93,9 @@ void *hash_table_remove(struct hash_table_t *table, char *key);
 char *hash_table_find_first(struct hash_table_t *table, void **data);
 char *hash_table_find_next(struct hash_table_t *table, void **data);
 
+/* Same, with the position kept in 'iter' instead of the table */
+char *hash_table_iter_first(const struct hash_table_t *table, struct hash_table_iter_t *iter, void **data);
+char *hash_table_iter_next(const struct hash_table_t *table, struct hash_table_iter_t *iter, void **data);
+
 #endif
 
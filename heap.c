@@ -37,6 +37,10 @@ struct heap_t {
 	long long time;
 	enum heap_time_policy_enum time_policy;
 	struct heap_elem_t *elem;
+
+	/* scratch space for heap_extract_min_all */
+	struct heap_elem_t *scratch;
+	int scratch_size;
 };
 
 
@@ -75,6 +79,57 @@ static int heap_grow(struct heap_t *heap)
 }
 
 
+/* compare two elements by insertion time, for sorting extracted elements */
+static int heap_time_fifo(const void *a, const void *b)
+{
+	long long x = ((const struct heap_elem_t *) a)->time;
+	long long y = ((const struct heap_elem_t *) b)->time;
+	return (x > y) - (x < y);
+}
+
+
+static int heap_time_lifo(const void *a, const void *b)
+{
+	return heap_time_fifo(b, a);
+}
+
+
+/* append element 'i' to the scratch space, recording its position in 'value' */
+static int heap_scratch_push(struct heap_t *heap, int *count, int i)
+{
+	struct heap_elem_t *nscratch;
+
+	if (*count == heap->scratch_size) {
+		heap->scratch_size = heap->scratch_size ? heap->scratch_size * 2 : 64;
+		nscratch = realloc(heap->scratch, heap->scratch_size * sizeof(struct heap_elem_t));
+		if (!nscratch) {
+			heap->error = HEAP_ENOMEM;
+			return 0;
+		}
+		heap->scratch = nscratch;
+	}
+	heap->scratch[*count].value = i;
+	heap->scratch[*count].time = heap->elem[i].time;
+	heap->scratch[*count].data = heap->elem[i].data;
+	(*count)++;
+	return 1;
+}
+
+
+/* move an element up to its place */
+static void heap_sift_up(struct heap_t *heap, int i)
+{
+	struct heap_elem_t tmp;
+
+	while (i > 0 && heap_less_than(heap, i, PARENT(i))) {
+		tmp = heap->elem[i];
+		heap->elem[i] = heap->elem[PARENT(i)];
+		heap->elem[PARENT(i)] = tmp;
+		i = PARENT(i);
+	}
+}
+
+
 /* heapify an element */
 static void heapify(struct heap_t *heap, int i)
 {
@@ -122,6 +177,7 @@ struct heap_t *heap_create(int size)
 /* destruction */
 void heap_free(struct heap_t *heap)
 {
+	free(heap->scratch);
 	free(heap->elem);
 	free(heap);
 }
@@ -153,7 +209,6 @@ int heap_count(struct heap_t *heap)
 void heap_insert(struct heap_t *heap, long long value, void *data)
 {
 	int i;
-	struct heap_elem_t tmp;
 	
 	/* grow heap */
 	if (heap->count == heap->size && !heap_grow(heap)) {
@@ -166,17 +221,62 @@ void heap_insert(struct heap_t *heap, long long value, void *data)
 	heap->elem[i].value = value;
 	heap->elem[i].data = data;
 	heap->elem[i].time = heap->time++;
-	while (i > 0 && heap_less_than(heap, i, PARENT(i))) {
-		tmp = heap->elem[i];
-		heap->elem[i] = heap->elem[PARENT(i)];
-		heap->elem[PARENT(i)] = tmp;
-		i = PARENT(i);
-	}
+	heap_sift_up(heap, i);
 	heap->count++;
 	heap->error = 0;
 }
 
 
+/* make room for 'size' elements, so that no insertion reallocates until then */
+int heap_reserve(struct heap_t *heap, int size)
+{
+	struct heap_elem_t *nelem;
+
+	heap->error = 0;
+	if (size <= heap->size)
+		return 1;
+	nelem = realloc(heap->elem, size * sizeof(struct heap_elem_t));
+	if (!nelem) {
+		heap->error = HEAP_ENOMEM;
+		return 0;
+	}
+	heap->elem = nelem;
+	heap->size = size;
+	return 1;
+}
+
+
+void heap_insert_bulk(struct heap_t *heap, const long long *values, void **data, int count)
+{
+	int i, first = heap->count;
+
+	/* reserve once, still doubling so that repeated batches stay amortized */
+	if (heap->count + count > heap->size &&
+		!heap_reserve(heap, heap->count + count > heap->size * 2 ? heap->count + count : heap->size * 2))
+		return;
+
+	/* append elements */
+	for (i = 0; i < count; i++) {
+		heap->elem[first + i].value = values[i];
+		heap->elem[first + i].data = data[i];
+		heap->elem[first + i].time = heap->time++;
+	}
+	heap->count += count;
+
+	/* A batch at least as large as the heap it joins is cheaper to merge by
+	 * rebuilding the whole heap (Floyd); a smaller one is sifted up element
+	 * by element, which for random keys costs O(1) each on average. */
+	if (count >= first) {
+		for (i = heap->count / 2 - 1; i >= 0; i--)
+			heapify(heap, i);
+	} else {
+		for (i = first; i < heap->count; i++)
+			heap_sift_up(heap, i);
+	}
+	heap->error = 0;
+}
+
+
 long long heap_peek(struct heap_t *heap, void **data)
 {
 	long long value;
@@ -215,6 +315,94 @@ long long heap_extract(struct heap_t *heap, void **data)
 }
 
 
+int heap_extract_min_all(struct heap_t *heap, long long *value, void **data, int size)
+{
+	struct heap_elem_t tmp;
+	long long min;
+	int head, count, i, j, k;
+
+	/* heap empty */
+	if (!heap->count) {
+		heap->error = HEAP_EEMPTY;
+		return 0;
+	}
+	min = heap->elem[0].value;
+	if (value)
+		*value = min;
+
+	/* usual case: a single element with the minimum value */
+	if ((LEFT(0) >= heap->count || heap->elem[LEFT(0)].value != min) &&
+		(RIGHT(0) >= heap->count || heap->elem[RIGHT(0)].value != min)) {
+		heap_extract(heap, data);
+		return 1;
+	}
+
+	/* Elements equal to the minimum form a subtree that contains the root,
+	 * so a breadth-first walk from the root finds all of them without looking
+	 * at the rest. Positions are stored in the 'value' field of the scratch
+	 * elements and come out in increasing order. */
+	count = 0;
+	if (!heap_scratch_push(heap, &count, 0))
+		return 0;
+	for (head = 0; head < count; head++) {
+		for (i = LEFT(heap->scratch[head].value); i <= RIGHT(heap->scratch[head].value); i++) {
+			if (i < heap->count && heap->elem[i].value == min && !heap_scratch_push(heap, &count, i))
+				return 0;
+		}
+	}
+
+	/* More simultaneous elements than the caller can take: extract them one by
+	 * one in the usual order and leave the rest in the heap. */
+	if (count > size) {
+		for (k = 0; k < size; k++)
+			heap_extract(heap, &data[k]);
+		return size;
+	}
+
+	/* Remove them. Few elements: fill each hole with the last element and sift it
+	 * down, from the deepest hole up; all their ancestors are holes too, so sifting
+	 * up is never needed. Many elements: compact the array and rebuild the heap. */
+	if (count <= heap->count / 8) {
+		for (k = count - 1; k >= 0; k--) {
+			i = heap->scratch[k].value;
+			heap->count--;
+			if (i != heap->count) {
+				heap->elem[i] = heap->elem[heap->count];
+				heapify(heap, i);
+			}
+		}
+	} else {
+		for (i = j = k = 0; i < heap->count; i++) {
+			if (k < count && heap->scratch[k].value == i)
+				k++;
+			else
+				heap->elem[j++] = heap->elem[i];
+		}
+		heap->count = j;
+		for (i = heap->count / 2 - 1; i >= 0; i--)
+			heapify(heap, i);
+	}
+
+	/* return them in extraction order; short runs are sorted by insertion */
+	if (count > 32) {
+		qsort(heap->scratch, count, sizeof(struct heap_elem_t),
+			heap->time_policy == heap_time_policy_fifo ? heap_time_fifo : heap_time_lifo);
+	} else {
+		for (i = 1; i < count; i++) {
+			tmp = heap->scratch[i];
+			for (j = i; j > 0 && (heap->time_policy == heap_time_policy_fifo ?
+				heap->scratch[j - 1].time > tmp.time : heap->scratch[j - 1].time < tmp.time); j--)
+				heap->scratch[j] = heap->scratch[j - 1];
+			heap->scratch[j] = tmp;
+		}
+	}
+	for (k = 0; k < count; k++)
+		data[k] = heap->scratch[k].data;
+	heap->error = 0;
+	return count;
+}
+
+
 void heap_time_policy(struct heap_t *heap, enum heap_time_policy_enum policy)
 {
 	heap->time_policy = policy;
@@ -258,3 +446,25 @@ long long heap_next(struct heap_t *heap, void **data)
 		*data = heap->elem[heap->current].data;
 	return heap->elem[heap->current].value;
 }
+
+
+void heap_iter_init(const struct heap_t *heap, struct heap_iter_t *iter)
+{
+	iter->index = 0;
+}
+
+
+int heap_iter_next(const struct heap_t *heap, struct heap_iter_t *iter, long long *value, void **data)
+{
+	/* No more elements */
+	if (iter->index >= heap->count)
+		return 0;
+
+	/* Return element and advance */
+	if (value)
+		*value = heap->elem[iter->index].value;
+	if (data)
+		*data = heap->elem[iter->index].data;
+	iter->index++;
+	return 1;
+}
@@ -28,6 +28,12 @@
 
 struct heap_t;
 
+/* external cursor for heap enumeration; it lives in the caller,
+ * so several enumerations can run at once without modifying the heap */
+struct heap_iter_t {
+	int index;
+};
+
 /* heap extraction policy for elements with same value:
  * fifo: oldest inserted value is extracted first
  * lifo: youngest value first */
@@ -48,13 +54,33 @@ char *heap_error_msg(struct heap_t *heap);
 /* heap operations */
 int heap_count(struct heap_t *heap);
 void heap_insert(struct heap_t *heap, long long value, void *data);
+int heap_reserve(struct heap_t *heap, int size);  /* ENOMEM */
+
+/* insert 'count' elements as if inserted one by one in array order (ties
+ * keep that order); large batches rebuild the heap bottom-up in O(n) */
+void heap_insert_bulk(struct heap_t *heap, const long long *values, void **data, int count);  /* ENOMEM */
 long long heap_extract(struct heap_t *heap, void **data);
 long long heap_peek(struct heap_t *heap, void **data);  /* EEMPTY */
+
+/* extract every element whose value equals the minimum into 'data', in the
+ * order heap_extract would return them, and the minimum into 'value';
+ * if there are more than 'size' of them, only the first 'size' are extracted.
+ * Returns the number of elements extracted. */
+int heap_extract_min_all(struct heap_t *heap, long long *value, void **data, int size);  /* EEMPTY */
 void heap_time_policy(struct heap_t *heap, enum heap_time_policy_enum policy);
 
 /* heap enumeration */
 long long heap_first(struct heap_t *heap, void **data);  /* EELEM */
 long long heap_next(struct heap_t *heap, void **data);  /* EELEM */
 
+/* heap enumeration with an external cursor (elements in storage order);
+ * heap_iter_next returns 0 when there are no more elements */
+void heap_iter_init(const struct heap_t *heap, struct heap_iter_t *iter);
+int heap_iter_next(const struct heap_t *heap, struct heap_iter_t *iter, long long *value, void **data);
+
+#define HEAP_ITER_FOR_EACH(heap, iter, value, data) \
+	for (heap_iter_init((heap), &(iter)); \
+		heap_iter_next((heap), &(iter), &(value), (void **) &(data)); )
+
 
 #endif
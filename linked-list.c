@@ -42,7 +42,16 @@ struct linked_list_t *linked_list_create()
 /* Destruction */
 void linked_list_free(struct linked_list_t *list)
 {
+	struct linked_list_elem_t *elem;
+
+	/* Free elements, including the ones kept in the pool */
 	linked_list_clear(list);
+	while (list->pool)
+	{
+		elem = list->pool;
+		list->pool = elem->next;
+		free(elem);
+	}
 	free(list);
 }
 
@@ -231,10 +240,20 @@ void linked_list_insert(struct linked_list_t *list, void *data)
 {
 	struct linked_list_elem_t *elem;
 	
-	/* Create a new element */
-	elem = calloc(1, sizeof(struct linked_list_elem_t));
-	if (!elem)
-		fatal("%s: out of memory", __FUNCTION__);
+	/* Take an element from the pool, or create a new one */
+	if (list->pool)
+	{
+		elem = list->pool;
+		list->pool = elem->next;
+		elem->prev = NULL;
+		elem->next = NULL;
+	}
+	else
+	{
+		elem = calloc(1, sizeof(struct linked_list_elem_t));
+		if (!elem)
+			fatal("%s: out of memory", __FUNCTION__);
+	}
 	elem->data = data;
 	
 	/* Insert it */
@@ -323,7 +342,10 @@ void linked_list_remove(struct linked_list_t *list)
 	list->error_code = LINKED_LIST_ERR_OK;
 	list->count--;
 	list->current = elem->next;
-	free(elem);
+
+	/* Return element to the pool */
+	elem->next = list->pool;
+	list->pool = elem;
 }
 
 
@@ -331,12 +353,13 @@ void linked_list_clear(struct linked_list_t *list)
 {
 	struct linked_list_elem_t *elem, *next;
 	
-	/* Free all elements */
+	/* Return all elements to the pool */
 	elem = list->head;
 	while (elem)
 	{
 		next = elem->next;
-		free(elem);
+		elem->next = list->pool;
+		list->pool = elem;
 		elem = next;
 	}
 	
@@ -350,66 +373,81 @@ void linked_list_clear(struct linked_list_t *list)
 }
 
 
-static void sort(struct linked_list_elem_t **array, int lo, int hi, int (*comp)(const void *, const void *))
+/* Merge two sorted chains linked by 'next' and ended by NULL. On equal elements
+ * the one from 'left' goes first, which makes the sort stable. */
+static struct linked_list_elem_t *linked_list_merge(struct linked_list_elem_t *left,
+	struct linked_list_elem_t *right, int (*comp)(const void *, const void *))
 {
-	struct linked_list_elem_t *ptr, *tmp;
-	int i = lo, j = hi;
-	
-	ptr = array[(lo + hi) / 2];
-	do {
-		while (comp(array[i]->data, ptr->data) < 0)
-			i++;
-		while (comp(array[j]->data, ptr->data) > 0)
-			j--;
-		if (i <= j) {
-			tmp = array[i];
-			array[i] = array[j];
-			array[j] = tmp;
-			i++, j--;
-		}
-	} while (i <= j);
-	if (lo < j)
-		sort(array, lo, j, comp);
-	if (i < hi)
-		sort(array, i, hi, comp);
+	struct linked_list_elem_t head;
+	struct linked_list_elem_t *tail = &head;
+	struct linked_list_elem_t *elem;
+	int from_right;
+
+	/* Written without branches on the comparison result, which is
+	 * unpredictable on unsorted input */
+	while (left && right)
+	{
+		from_right = comp(left->data, right->data) > 0;
+		elem = from_right ? right : left;
+		left = from_right ? left : left->next;
+		right = from_right ? right->next : right;
+		tail->next = elem;
+		tail = elem;
+	}
+	tail->next = left ? left : right;
+	return head.next;
 }
 
 
+/* Bottom-up merge sort on the links. Elements are taken from the list one at a time
+ * and 'pending[i]' holds a sorted run of 2^i elements, merged like the carry of a
+ * binary counter, so runs are merged while they are still in the cache. Only the
+ * 'next' links are used while sorting; 'prev' links are rebuilt at the end.
+ * No memory is allocated. */
 void linked_list_sort(struct linked_list_t *list, int (*comp)(const void *, const void *))
 {
-	struct linked_list_elem_t **array;
+	struct linked_list_elem_t *pending[sizeof(int) * 8];
+	struct linked_list_elem_t *elem, *next, *run, *prev;
+	int levels = 0;
 	int i;
 	
 	/* No need to sort an empty list */
 	list->error_code = LINKED_LIST_ERR_OK;
 	if (!list->count)
 		return;
-	
-	/* Create an array for elements */
-	array = calloc(list->count, sizeof(struct linked_list_elem_t *));
-	if (!array)
-		fatal("%s: out of memory", __FUNCTION__);
 
-	/* Convert linked list into array */
-	list->current = list->head;
-	for (i = 0; i < list->count; i++)
+	/* Add elements to the pending runs. Older runs are always merged on the
+	 * left, so equal elements keep their order. */
+	for (elem = list->head; elem; elem = next)
 	{
-		array[i] = list->current;
-		list->current = list->current->next;
+		next = elem->next;
+		elem->next = NULL;
+		run = elem;
+		for (i = 0; i < levels && pending[i]; i++)
+		{
+			run = linked_list_merge(pending[i], run, comp);
+			pending[i] = NULL;
+		}
+		if (i == levels)
+			levels++;
+		pending[i] = run;
 	}
-	
-	/* Sort array */
-	sort(array, 0, list->count - 1, comp);
-	
-	/* Rebuild linked list */
-	list->head = array[0];
-	list->tail = array[list->count - 1];
-	for (i = 0; i < list->count; i++)
+
+	/* Merge the remaining runs, newest first */
+	run = NULL;
+	for (i = 0; i < levels; i++)
+		if (pending[i])
+			run = linked_list_merge(pending[i], run, comp);
+
+	/* Rebuild 'prev' links */
+	list->head = run;
+	prev = NULL;
+	for (elem = run; elem; elem = elem->next)
 	{
-		array[i]->prev = i > 0 ? array[i - 1] : NULL;
-		array[i]->next = i < list->count - 1 ? array[i + 1] : NULL;
+		elem->prev = prev;
+		prev = elem;
 	}
-	free(array);
+	list->tail = prev;
 	
 	/* Set the first element as current element */
 	list->current_index = 0;
@@ -440,3 +478,130 @@ int linked_list_sorted(struct linked_list_t *list,
 	}
 	return 1;
 }
+
+
+void linked_list_iter_init(const struct linked_list_t *list, struct linked_list_iter_t *iter)
+{
+	iter->elem = list->head;
+}
+
+
+int linked_list_iter_next(struct linked_list_iter_t *iter, void **data)
+{
+	/* Past the end */
+	if (!iter->elem)
+		return 0;
+
+	/* Return element and advance */
+	if (data)
+		*data = iter->elem->data;
+	iter->elem = iter->elem->next;
+	return 1;
+}
+
+
+
+void linked_list_reserve(struct linked_list_t *list, int count)
+{
+	struct linked_list_elem_t *elem;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		elem = calloc(1, sizeof(struct linked_list_elem_t));
+		if (!elem)
+			fatal("%s: out of memory", __FUNCTION__);
+		elem->next = list->pool;
+		list->pool = elem;
+	}
+	list->error_code = LINKED_LIST_ERR_OK;
+}
+
+
+
+
+/*
+ * Intrusive List
+ */
+
+void ilist_init(struct ilist_t *list)
+{
+	list->root.prev = &list->root;
+	list->root.next = &list->root;
+	list->count = 0;
+}
+
+
+int ilist_count(const struct ilist_t *list)
+{
+	return list->count;
+}
+
+
+void ilist_insert_before(struct ilist_t *list, struct ilist_link_t *pos, struct ilist_link_t *link)
+{
+	link->prev = pos->prev;
+	link->next = pos;
+	pos->prev->next = link;
+	pos->prev = link;
+	list->count++;
+}
+
+
+void ilist_push_back(struct ilist_t *list, struct ilist_link_t *link)
+{
+	ilist_insert_before(list, &list->root, link);
+}
+
+
+void ilist_push_front(struct ilist_t *list, struct ilist_link_t *link)
+{
+	ilist_insert_before(list, list->root.next, link);
+}
+
+
+void ilist_remove(struct ilist_t *list, struct ilist_link_t *link)
+{
+	assert(list->count > 0);
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+	link->prev = NULL;
+	link->next = NULL;
+	list->count--;
+}
+
+
+struct ilist_link_t *ilist_pop_front(struct ilist_t *list)
+{
+	struct ilist_link_t *link;
+
+	if (!list->count)
+		return NULL;
+	link = list->root.next;
+	ilist_remove(list, link);
+	return link;
+}
+
+
+struct ilist_link_t *ilist_first(const struct ilist_t *list)
+{
+	return list->count ? list->root.next : NULL;
+}
+
+
+struct ilist_link_t *ilist_last(const struct ilist_t *list)
+{
+	return list->count ? list->root.prev : NULL;
+}
+
+
+struct ilist_link_t *ilist_next(const struct ilist_t *list, const struct ilist_link_t *link)
+{
+	return link->next == &list->root ? NULL : link->next;
+}
+
+
+struct ilist_link_t *ilist_prev(const struct ilist_t *list, const struct ilist_link_t *link)
+{
+	return link->prev == &list->root ? NULL : link->prev;
+}
@@ -20,6 +20,7 @@
 #ifndef LINKED_LIST_H
 #define LINKED_LIST_H
 
+#include <stddef.h>
 
 /* Error constants */
 enum linked_list_error_t
@@ -50,6 +51,16 @@ struct linked_list_t
 	/* Private */
 	struct linked_list_elem_t *head, *tail, *current;
 	int current_index;
+	struct linked_list_elem_t *pool;  /* removed elements, chained by 'next' */
+};
+
+
+/* External cursor. It lives in the caller and does not touch the list's
+ * 'current' element, so iterations can be nested or run from several threads
+ * as long as the list is not modified meanwhile. */
+struct linked_list_iter_t
+{
+	struct linked_list_elem_t *elem;
 };
 
 
@@ -63,6 +74,20 @@ struct linked_list_t
 		linked_list_next(list))
 
 
+/** Iterate through all elements of a linked list with an external cursor,
+ * without modifying the list.
+ *
+ * @param list
+ * @param iter
+ * 	Variable of type 'struct linked_list_iter_t'.
+ * @param data
+ * 	Variable receiving the data of each element.
+ */
+#define LINKED_LIST_ITER_FOR_EACH(list, iter, data) \
+	for (linked_list_iter_init((list), &(iter)); \
+		linked_list_iter_next(&(iter), (void **) &(data)); )
+
+
 /** Create a linked list.
  *
  * @return
@@ -342,7 +367,25 @@ void linked_list_remove(struct linked_list_t *list);
 void linked_list_clear(struct linked_list_t *list);
 
 
-/** Sort the list.
+/** Preallocate elements in the pool of the list. Removed elements are also kept
+ * in the pool and reused by later insertions, so a list whose size does not
+ * grow beyond 'count' elements does not allocate memory any more. The pool is
+ * released in 'linked_list_free'.
+ *
+ * @param list
+ * 	List object.
+ * @param count
+ * 	Number of elements to add to the pool.
+ *
+ * @return
+ * 	No value is returned. The error code is set to LINKED_LIST_ERR_OK.
+ */
+void linked_list_reserve(struct linked_list_t *list, int count);
+
+
+/** Sort the list. The sort is stable (elements comparing equal keep their
+ * relative order), takes O(n log n) time in the worst case and does not allocate
+ * memory. The current element is set to position 0.
  *
  * @param list
  * 	List object.
@@ -370,4 +413,169 @@ void linked_list_sort(struct linked_list_t *list,
 int linked_list_sorted(struct linked_list_t *list,
 	int (*comp)(const void *, const void *));
 
+
+/** Place an external cursor at the head of the list.
+ *
+ * @param list
+ * 	List object. It is not modified.
+ * @param iter
+ * 	Cursor to initialize.
+ */
+void linked_list_iter_init(const struct linked_list_t *list, struct linked_list_iter_t *iter);
+
+
+/** Return the element under an external cursor and advance the cursor.
+ *
+ * @param iter
+ * 	Cursor initialized with 'linked_list_iter_init'.
+ * @param data
+ * 	If not NULL, receives the data of the element.
+ *
+ * @return
+ * 	The function returns 0 if the cursor was past the end of the list, and
+ * 	non-zero otherwise. The error code of the list is not modified.
+ */
+int linked_list_iter_next(struct linked_list_iter_t *iter, void **data);
+
+
+
+
+/*
+ * Intrusive List
+ *
+ * The links are embedded in the user's structures, so insertions and removals
+ * do not allocate memory, and any element can be removed in O(1) given its link,
+ * without a current element. An element can be in as many lists at a time as
+ * links it has. The list is circular around a sentinel 'root' link.
+ */
+
+/* Link to embed in the elements */
+struct ilist_link_t
+{
+	struct ilist_link_t *prev;
+	struct ilist_link_t *next;
+};
+
+
+/* Intrusive list */
+struct ilist_t
+{
+	/* Private */
+	struct ilist_link_t root;
+	int count;
+};
+
+
+/** Get the structure containing a link.
+ *
+ * @param link
+ * 	Pointer to the link.
+ * @param type
+ * 	Type of the containing structure.
+ * @param member
+ * 	Name of the link field in 'type'.
+ */
+#define ILIST_ENTRY(link, type, member) \
+	((type *) ((char *) (link) - offsetof(type, member)))
+
+
+/** Iterate through all links of an intrusive list. The current link must not be
+ * removed inside the loop; use 'ilist_pop_front' to drain a list.
+ *
+ * @param list
+ * @param link
+ * 	Variable of type 'struct ilist_link_t *'.
+ */
+#define ILIST_FOR_EACH(list, link) \
+	for ((link) = ilist_first(list); \
+		(link); \
+		(link) = ilist_next((list), (link)))
+
+
+/** Initialize an empty intrusive list. No memory is allocated, so there is no
+ * destruction function; the elements are owned by the caller.
+ *
+ * @param list
+ * 	List object.
+ */
+void ilist_init(struct ilist_t *list);
+
+
+/** Return the number of elements in an intrusive list.
+ *
+ * @param list
+ * 	List object.
+ */
+int ilist_count(const struct ilist_t *list);
+
+
+/** Insert a link before another one already in the list.
+ *
+ * @param list
+ * 	List object.
+ * @param pos
+ * 	Link in the list, or the root of the list to insert at the end.
+ * @param link
+ * 	Link to insert. It must not be in any list.
+ */
+void ilist_insert_before(struct ilist_t *list, struct ilist_link_t *pos, struct ilist_link_t *link);
+
+
+/** Insert a link at the end or at the head of the list.
+ *
+ * @param list
+ * 	List object.
+ * @param link
+ * 	Link to insert. It must not be in any list.
+ */
+void ilist_push_back(struct ilist_t *list, struct ilist_link_t *link);
+void ilist_push_front(struct ilist_t *list, struct ilist_link_t *link);
+
+
+/** Remove a link from the list.
+ *
+ * @param list
+ * 	List object.
+ * @param link
+ * 	Link in the list.
+ */
+void ilist_remove(struct ilist_t *list, struct ilist_link_t *link);
+
+
+/** Remove the first link of the list.
+ *
+ * @param list
+ * 	List object.
+ *
+ * @return
+ * 	The removed link, or NULL if the list is empty.
+ */
+struct ilist_link_t *ilist_pop_front(struct ilist_t *list);
+
+
+/** Return the first or last link of the list.
+ *
+ * @param list
+ * 	List object.
+ *
+ * @return
+ * 	The link, or NULL if the list is empty.
+ */
+struct ilist_link_t *ilist_first(const struct ilist_t *list);
+struct ilist_link_t *ilist_last(const struct ilist_t *list);
+
+
+/** Return the link following or preceding another one.
+ *
+ * @param list
+ * 	List object.
+ * @param link
+ * 	Link in the list.
+ *
+ * @return
+ * 	The link, or NULL if 'link' was the last (first) one.
+ */
+struct ilist_link_t *ilist_next(const struct ilist_t *list, const struct ilist_link_t *link);
+struct ilist_link_t *ilist_prev(const struct ilist_t *list, const struct ilist_link_t *link);
+
 #endif
@@ -1,26 +1,122 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "macsim.h"
 #include "heap.h"
-#include "hash-table.h"
+#include "radix-heap.h"
+#include "timing-wheel.h"
+#include "ext-queue.h"
+#include "string-map.h"
 #include "debug.h"
 #include "random.h"
+#include "trace.h"
+#include "workload.h"
+#include "network.h"
+#include "batch-means.h"
+#include "monitor.h"
+#if defined(MACSIM_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h>
+#endif
 
 #define MACSIM_UNKNOWN_STATION 0
 #define MACSIM_SUCCESS 1
 #define MACSIM_WAITING_STATION 2
 #define MACSIM_USING_STATION 3
 
+#define MACSIM_EVENT_REPLAY 1 //El evento es una llegada de la carga que se está reproduciendo
+#define MACSIM_EVENT_WHEEL 2 //El evento está en la rueda de tiempos
+#define MACSIM_EVENT_CANCELLED 4 //El evento se ha cancelado pero sigue en la cola (fuera de la rueda)
+#define MACSIM_EVENT_SPILLED 8 //El evento está en disco (solo los de macsim_timeout conservan la estructura)
+#define MACSIM_EVENT_HANDLE 16 //El usuario tiene el evento (macsim_timeout), que no se libera al pasarlo a disco
+
+#define MACSIM_EVENT_MEMORY (sizeof(struct macsim_event_t) + 40) //Bytes aproximados de un evento en memoria, con la cola
+
+/* Criterios de MACSIM_QUEUE_AUTO, sacados de bench/hold */
+#define MACSIM_ADAPT_WINDOW 65536 //Extracciones y planificaciones entre dos revisiones de la elección (como mínimo; ver macsim_queue_adapt_mark)
+#define MACSIM_ADAPT_SMALL 64 //Con menos eventos pendientes el montículo binario gana al radix heap
+#define MACSIM_ADAPT_WHEEL_MIN 1000 //Eventos pendientes entre los que compensa la rueda de tiempos
+#define MACSIM_ADAPT_WHEEL_MAX 200000
+#define MACSIM_ADAPT_WHEEL_LEVELS 3 //Niveles máximos de la rueda (16,7 ms); con más, los eventos bajan demasiadas veces
+#define MACSIM_ADAPT_QUANTILE 0.95 //Parte de las distancias de planificación que tiene que cubrir la rueda
+#define MACSIM_SORT_RADIX 1024 //Entradas a partir de las que macsim_queue_sort usa radix sort
+
+/* Estadísticas en vivo (macsim_monitor) */
+#define MACSIM_MONITOR_STRIDE 4096 //Máximo de eventos entre dos lecturas del reloj
+#define MACSIM_MONITOR_CHECKS 16 //Lecturas del reloj por periodo de publicación
+
+/* Instrumentación de MACSIM_PROFILE */
+#define MACSIM_PROFILE_SAMPLE 16 //Se mide con el reloj una de cada tantas llamadas (potencia de 2)
+#define MACSIM_PROFILE_KINDS 4096 //Tipos de evento con contador propio; los demás se cuentan juntos
+#define MACSIM_PROFILE_DEPTH 1024 //Muestras de la longitud de la cola que se guardan
+#define MACSIM_PROFILE_PERIOD 64 //Eventos entre dos muestras al empezar; se dobla cada vez que se llenan
+
+#define MACSIM_CHECKPOINT_MAGIC "MACSIMCK"
+#define MACSIM_CHECKPOINT_VERSION 1
+
 /* Estructuras */
 struct macsim_event_t{
+	struct timing_wheel_node_t node; //Nodo de la rueda de tiempos (primer campo)
+	long long seq; //Orden de inserción, para desempatar entre la rueda y la cola
 	long long client;
 	int kind;
+	int flags;
+};
+
+
+/* Evento pendiente con su instante, para ordenar la cola de una vez (macsim_queue_drain) */
+struct macsim_queue_entry_t {
+	long long time;
+	struct macsim_event_t *event;
+};
+
+
+#ifdef MACSIM_PROFILE
+/* Operaciones medidas por MACSIM_PROFILE */
+enum macsim_probe_enum {
+	MACSIM_PROBE_EXTRACT = 0, //macsim_extract, macsim_extract_all y el bucle de macsim_run
+	MACSIM_PROBE_REQUEST, //macsim_station_request y macsim_station_request2
+	MACSIM_PROBE_LEAVE, //macsim_station_leave y macsim_station_leave2
+	MACSIM_PROBE_RANDOM, //macsim_exponential y macsim_uniform
+	MACSIM_PROBES
+};
+
+static const char *probe_names[MACSIM_PROBES] = {"extract", "station_request", "station_leave", "random"};
+
+/* Contadores de una operación o de un tipo de evento. Se cuentan todas las llamadas y se miden
+ * una de cada MACSIM_PROFILE_SAMPLE, para que leer el reloj no pese en lo medido. */
+struct macsim_probe_t {
+	long long calls;
+	long long samples;
+	unsigned long long cycles; //De las llamadas medidas
+};
+
+/* Muestra de la longitud de la cola */
+struct macsim_depth_sample_t {
+	long long time; //ns
+	long long events; //Eventos extraídos hasta entonces
+	long long pending;
+};
+#endif
+
+
+/* Evento pasado a disco (macsim_queue_spill) */
+struct macsim_spill_record_t {
+	long long client;
+	struct macsim_event_t *handle; //El evento de macsim_timeout, o NULL si se ha liberado
+	int kind;
+	int flags;
 };
 
 
 struct macsim_station_client_t {
+	struct ilist_link_t link; //Enlace en la cola de la estación o en la reserva de clientes libres
 	long long id;             
 	long long station_entry_time; //Instante de entrada a la estación
 	long long server_entry_time; //Instante de entrada al servidor
@@ -28,51 +124,1204 @@ struct macsim_station_client_t {
 }; 
 
 
+/* Formato de las instantáneas (macsim_checkpoint).
+ * Todo son registros de tamaño fijo alineados a 8 bytes, de modo que el fichero
+ * se puede proyectar en memoria y leer en su sitio:
+ * cabecera, eventos en orden de extracción, estaciones, clientes de todas las estaciones
+ * (en orden de estación y de cola), estados de los streams aleatorios y nombres. */
+struct macsim_checkpoint_header_t {
+	char magic[8]; //MACSIM_CHECKPOINT_MAGIC
+	int version; //MACSIM_CHECKPOINT_VERSION
+	int current_event;
+	long long current_time;
+	long long last_reset_time;
+	long long event_count;
+	long long station_count;
+	long long client_count;
+	long long events_offset;
+	long long stations_offset;
+	long long clients_offset;
+	long long streams_offset;
+	long long names_offset;
+	long long names_size;
+	long long replay_next;
+	long long replay_base;
+	int replay_kind;
+	int next_station_id;
+};
+
+struct macsim_checkpoint_event_t {
+	long long time;
+	long long client;
+	int kind;
+	int flags;
+};
+
+struct macsim_checkpoint_station_t {
+	long long total_service_time;
+	long long total_response_time;
+	long long total_clients;
+	long long name_offset; //Posición del nombre dentro de la zona de nombres
+	int id;
+	int reschedule;
+	int client_count;
+	int reserved;
+};
+
+struct macsim_checkpoint_client_t {
+	long long id;
+	long long station_entry_time;
+	long long server_entry_time;
+	int event_kind;
+	int reserved;
+};
+
+
 
 /* Variables */
 static long long current_time; //Instante actual en la simulación en nanosegundos (ns)
 static long long last_reset_time; //Instante en que se produjo el último reset en nanosegundos (ns)
 static int trace = 1; //Indica si la traza está activada o no
-static struct heap_t *event_queue; //Cola de eventos
-static struct hash_table_t *stations; //Estaciones
+static int queue_backend; //Implementación de la cola de eventos (enum macsim_queue_enum)
+static struct heap_t *event_queue; //Cola de eventos con MACSIM_QUEUE_HEAP
+static struct radix_heap_t *event_radix; //Cola de eventos con MACSIM_QUEUE_RADIX
+static int wheel_levels; //Niveles de la rueda de tiempos, 0 si no se usa (macsim_queue_wheel)
+static struct timing_wheel_t *event_wheel; //Rueda de tiempos delante de la cola, NULL si no se usa
+static long long event_seq; //Número de orden de la siguiente inserción
+static int cancelled_count; //Eventos cancelados que siguen en la cola
+static int event_reserve; //Capacidad pedida con macsim_reserve
+static struct ext_queue_t *event_spill; //Eventos lejanos en disco, NULL si no se usa (macsim_queue_spill)
+static char *spill_dir; //Directorio de los ficheros, NULL si no se usa
+static double spill_mb; //Memoria para la cola
+static long long spill_time = LLONG_MAX; //Los eventos de este instante en adelante van a disco
+static int spill_limit; //Eventos en memoria a partir de los que se pasa parte a disco
+static int spill_check; //spill_limit, o más si lo que sobra son eventos simultáneos que no se pueden separar
+static long long spill_cancelled; //Eventos cancelados que siguen en disco
+static int queue_auto; //La implementación y la rueda las elige macsim_queue_adapt (MACSIM_QUEUE_AUTO)
+static long long queue_events; //Eventos extraídos (macsim_queue_stats)
+static long long queue_scheduled; //Eventos planificados por el usuario
+static long long queue_pending_sum; //Suma de los eventos pendientes tras cada extracción
+static long long queue_pending_max;
+static long long queue_distance[MACSIM_QUEUE_DISTANCES]; //Eventos planificados por distancia al instante actual
+static int queue_migrations; //Cambios hechos por macsim_queue_adapt
+static long long adapt_next; //queue_events + queue_scheduled en que se revisa la elección
+static long long adapt_events, adapt_pending_sum, adapt_distance[MACSIM_QUEUE_DISTANCES]; //Contadores en la revisión anterior
+static int adapt_choice = -1; //Configuración elegida en la revisión anterior
+static struct string_map_t *stations; //Estaciones
 static int current_event; //Último evento sacado de la cola
+static int next_station_id; //Id que recibirá la próxima estación creada
+static struct macsim_trace_t *binary_trace; //Traza binaria, NULL si la traza es textual
+static struct macsim_workload_t *replay; //Carga que se está reproduciendo, NULL si no hay
+static long long replay_next; //Siguiente registro de la carga por planificar
+static long long replay_base; //Instante de la simulación que corresponde al instante 0 de la carga
+static int replay_kind; //Tipo de los eventos de llegada de la carga
+static struct ilist_t client_pool; //Clientes liberados, que se reutilizan en vez de pedir memoria
+static struct macsim_run_t *running; //Bucle de macsim_run en marcha, NULL si no hay
+static long long run_horizon; //horizon_ms del bucle en marcha en ns
+static double run_start; //Instante real en que empezó el bucle en marcha
+static struct macsim_event_t **event_batch; //Eventos de macsim_extract_all
+static int event_batch_size;
+static struct macsim_monitor_segment_t *monitor; //Segmento de las estadísticas en vivo, NULL si no se publican
+static char *monitor_name;
+static double monitor_period; //Segundos entre publicaciones
+static long long monitor_stride, monitor_countdown; //Eventos entre lecturas del reloj y hasta la siguiente
+static double monitor_start, monitor_last, monitor_checked; //Instante real de macsim_monitor, de la última publicación y de la última lectura del reloj
+static long long monitor_last_events; //queue_events en la última publicación
+#ifdef MACSIM_PROFILE
+static struct macsim_probe_t profile_probes[MACSIM_PROBES]; //Operaciones medidas
+static struct macsim_probe_t profile_kinds[MACSIM_PROFILE_KINDS + 1]; //Eventos de cada tipo y lo que tarda su manejador; el último, los demás tipos
+static struct macsim_probe_t *profile_handler; //Tipo del evento cuyo manejador se está midiendo, NULL si no se mide
+static unsigned long long profile_handler_start;
+static struct macsim_depth_sample_t profile_depth[MACSIM_PROFILE_DEPTH]; //Longitud de la cola a lo largo de la simulación
+static int profile_depth_count;
+static long long profile_depth_period, profile_depth_next; //Eventos entre muestras y queue_events de la siguiente
+static unsigned long long profile_clock_start; //Reloj e instante real en macsim_init o macsim_reset, para pasar ciclos a tiempo
+static double profile_wall_start;
+#endif
 
 
 
 /* Prototipos */
 static void macsim_station_destroy(struct macsim_station_t *station);
+static struct macsim_event_t * macsim_event_insert(int kind, long long client_id, long long time, int flags);
+static inline void macsim_event_next(int *kind, long long *client_id);
+static void macsim_replay_schedule();
+static void macsim_event_queue_clear();
+static void macsim_station_clear(struct macsim_station_t *station);
+static struct macsim_station_client_t * macsim_client_alloc();
+static void macsim_client_release(struct macsim_station_client_t *client);
+static struct macsim_station_client_t * macsim_station_head(struct macsim_station_t *station);
+static void macsim_trace_event_(int op, struct macsim_station_t *station, long long client_id, long long response_time, long long service_time);
 void macsim_trace_msg_(int level, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
 
 
+/* Macros */
+/* Los sucesos de la librería son mensajes de traza de nivel MACSIM_TRACE_LIBRARY y, como en
+ * macsim_print_, salen si la traza está activada y su nivel es mayor o igual que el de la traza */
+#define MACSIM_TRACE_LIBRARY 1
+#ifdef MACSIM_VERBOSE
+#  define macsim_trace_event(op, station, client_id, response_time, service_time) do{ \
+	if(trace && MACSIM_TRACE_LIBRARY >= trace) \
+		macsim_trace_event_(op, station, client_id, response_time, service_time); \
+	}while(0)
+#else
+#  define macsim_trace_event(...)
+#endif
+
+/* Instrumentación de MACSIM_PROFILE. MACSIM_PROBE_BEGIN va tras las declaraciones de la función
+ * medida y MACSIM_PROBE_END o MACSIM_PROBE_RETURN en cada salida; el valor que devuelve
+ * MACSIM_PROBE_RETURN se evalúa después de parar la medida, así que debe estar ya calculado. */
+#ifdef MACSIM_PROFILE
+#  define MACSIM_PROBE_BEGIN(probe) unsigned long long probe_start = macsim_probe_begin(probe)
+#  define MACSIM_PROBE_END(probe) macsim_probe_end(probe, probe_start)
+#  define MACSIM_PROBE_RETURN(probe, value) (macsim_probe_end(probe, probe_start), (value))
+#  define MACSIM_PROFILE_EVENT(kind) macsim_profile_event(kind)
+#  define MACSIM_PROFILE_HANDLER_END() macsim_profile_handler_end()
+#else
+#  define MACSIM_PROBE_BEGIN(probe)
+#  define MACSIM_PROBE_END(probe)
+#  define MACSIM_PROBE_RETURN(probe, value) (value)
+#  define MACSIM_PROFILE_EVENT(kind)
+#  define MACSIM_PROFILE_HANDLER_END()
+#endif
+
+
 /* Funciones */
+/* Cola de eventos.
+ * Las funciones macsim_backend_* ocultan qué implementación se usa (macsim_queue_backend): el
+ * montículo binario de heap.h o el radix heap de radix-heap.h, que aprovecha que ningún evento
+ * se planifica antes de current_time. Las dos desempatan los eventos simultáneos en orden FIFO.
+ * Las funciones macsim_queue_* ponen delante, si se pide con macsim_queue_wheel, una rueda de
+ * tiempos para los eventos próximos, y se saltan los eventos cancelados.
+ * Con macsim_queue_spill los eventos a partir de spill_time están en disco (ext-queue.h) y los
+ * anteriores en memoria; cuando en memoria hay demasiados se pasan a disco los más lejanos, y
+ * cuando no queda ninguno se cargan los siguientes. Nunca hay eventos de un mismo instante en
+ * los dos sitios, así que el orden de extracción, empates incluidos, no cambia.
+ * Las extracciones y lo que planifica el usuario alimentan la instrumentación de
+ * macsim_queue_stats, con la que MACSIM_QUEUE_AUTO cambia de configuración (macsim_queue_adapt). */
+
+/* Función privada que crea vacía la implementación elegida */
+static void macsim_backend_create(){
+	if(queue_backend == MACSIM_QUEUE_RADIX)
+		event_radix = radix_heap_create();
+	else
+		event_queue = heap_create(event_reserve > 512 ? event_reserve : 512); //Tamaño inicial
+	if(!event_queue && !event_radix)
+		fatal("%s: out of memory", __func__);
+}
+
+
+/* Función privada que libera la implementación elegida sin mirar lo que tenga */
+static void macsim_backend_free(){
+	if(event_radix)
+		radix_heap_free(event_radix);
+	if(event_queue)
+		heap_free(event_queue);
+	event_radix = NULL;
+	event_queue = NULL;
+}
+
+
+/* Función privada que crea la cola de eventos vacía */
+static void macsim_queue_create(){
+	macsim_backend_create();
+	if(wheel_levels && !(event_wheel = timing_wheel_create(wheel_levels)))
+		fatal("%s: out of memory", __func__);
+	cancelled_count = 0;
+}
+
+
+/* Función privada que libera la cola de eventos, que debe estar vacía */
+static void macsim_queue_free(){
+	macsim_backend_free();
+	if(event_wheel)
+		timing_wheel_free(event_wheel);
+	event_wheel = NULL;
+}
+
+
+/* Función privada que devuelve el número de eventos de la implementación elegida */
+static inline int macsim_backend_count(){
+	return event_radix ? radix_heap_count(event_radix) : heap_count(event_queue);
+}
+
+
+/* Función privada que inserta un evento en la implementación elegida */
+static inline void macsim_backend_insert(long long time, struct macsim_event_t *event){
+	if(event_radix){
+		radix_heap_insert(event_radix, time, event);
+		if(radix_heap_error(event_radix))
+			fatal("%s: %s", __func__, radix_heap_error_msg(event_radix));
+		return;
+	}
+	heap_insert(event_queue, time, event);
+	if(heap_error(event_queue))
+		fatal("%s: %s", __func__, heap_error_msg(event_queue));
+}
+
+
+/* Función privada que extrae el evento más próximo de la implementación elegida
+ * @return Su instante */
+static inline long long macsim_backend_extract(struct macsim_event_t **event){
+	long long time;
+
+	if(event_radix){
+		time = radix_heap_extract(event_radix, (void **) event);
+		if(radix_heap_error(event_radix))
+			fatal("%s: %s", __func__, radix_heap_error_msg(event_radix));
+		return time;
+	}
+	time = heap_extract(event_queue, (void **) event);
+	if(heap_error(event_queue))
+		fatal("%s: %s", __func__, heap_error_msg(event_queue));
+	return time;
+}
+
+
+/* Función privada que, con la implementación elegida vacía, hace que admita eventos desde \time.
+ * El radix heap vacío empezaría por el primer evento que se inserte, y si no es el más próximo
+ * los que llegaran después no cabrían. */
+static inline void macsim_backend_floor(long long time){
+	if(event_radix)
+		radix_heap_floor(event_radix, time);
+}
+
+
+/* Función privada que devuelve el evento más próximo de la implementación elegida y su instante,
+ * sin extraerlo */
+static inline long long macsim_backend_peek(struct macsim_event_t **event){
+	return event_radix ? radix_heap_peek(event_radix, (void **) event) : heap_peek(event_queue, (void **) event);
+}
+
+
+/* Función privada que devuelve el número de eventos pendientes en memoria */
+static inline int macsim_queue_loaded(){
+	return macsim_backend_count() - cancelled_count + (event_wheel ? timing_wheel_count(event_wheel) : 0);
+}
+
+
+/* Función privada que devuelve el número de eventos pendientes */
+static inline long long macsim_queue_count(){
+	return macsim_queue_loaded() + (event_spill ? ext_queue_count(event_spill) - spill_cancelled : 0);
+}
+
+
+static void macsim_queue_spill_event(long long time, struct macsim_event_t *event);
+static void macsim_queue_spill_far();
+static void macsim_queue_refill();
+
+
+/* Función privada que, si no queda ningún evento en memoria, carga los siguientes de disco */
+static inline void macsim_queue_load(){
+	if(event_spill && !macsim_queue_loaded() && ext_queue_count(event_spill))
+		macsim_queue_refill();
+}
+
+
+/* Función privada que inserta un evento en la cola: en la rueda si está y el instante cabe en
+ * ella, si no en la implementación elegida */
+static inline void macsim_queue_insert(long long time, struct macsim_event_t *event){
+	if(time >= spill_time){ //Sin disco spill_time es LLONG_MAX
+		macsim_queue_spill_event(time, event);
+		return;
+	}
+	event->seq = event_seq++;
+	event->flags &= ~MACSIM_EVENT_WHEEL;
+	if(event_wheel && timing_wheel_insert(event_wheel, time, &event->node))
+		event->flags |= MACSIM_EVENT_WHEEL;
+	else
+		macsim_backend_insert(time, event);
+	if(event_spill && macsim_queue_loaded() > spill_check)
+		macsim_queue_spill_far();
+}
+
+
+/* Función privada que inserta \count eventos como si se insertaran uno a uno en orden, pero en
+ * el montículo binario de una vez (heap_insert_bulk). Los que no caben en la rueda se compactan
+ * al principio de \times y \events, que se modifican. */
+static void macsim_queue_insert_bulk(long long *times, struct macsim_event_t **events, int count){
+	int i, far;
+
+	for(i = far = 0; i < count; i++){
+		if(times[i] >= spill_time){
+			macsim_queue_spill_event(times[i], events[i]);
+			continue;
+		}
+		events[i]->seq = event_seq++;
+		events[i]->flags &= ~MACSIM_EVENT_WHEEL;
+		if(event_wheel && timing_wheel_insert(event_wheel, times[i], &events[i]->node)){
+			events[i]->flags |= MACSIM_EVENT_WHEEL;
+			continue;
+		}
+		if(event_radix) //Insertar en el radix heap ya cuesta O(1)
+			macsim_backend_insert(times[i], events[i]);
+		else{
+			times[far] = times[i];
+			events[far++] = events[i];
+		}
+	}
+	if(far){
+		heap_insert_bulk(event_queue, times, (void **) events, far);
+		if(heap_error(event_queue))
+			fatal("%s: %s", __func__, heap_error_msg(event_queue));
+	}
+	if(event_spill && macsim_queue_loaded() > spill_check)
+		macsim_queue_spill_far();
+}
+
+
+/* Función privada que devuelve el evento más próximo sin extraerlo y deja su instante en \time.
+ * Los cancelados que haya al principio de la cola se liberan aquí, pero solo si son anteriores a
+ * todo lo demás y a \limit: con el radix heap sacarlos hace avanzar la cola, y después no se
+ * podría planificar nada antes de ellos. Si queda un cancelado por delante devuelve NULL y su
+ * instante, que es una cota inferior del siguiente evento; sin eventos devuelve NULL y 0. */
+static struct macsim_event_t * macsim_queue_head(long long *time, long long limit){
+	struct macsim_event_t *event = NULL;
+	struct timing_wheel_node_t *node = event_wheel ? timing_wheel_peek(event_wheel) : NULL;
+	long long event_time = 0;
+
+	while(macsim_backend_count()){
+		event_time = macsim_backend_peek(&event);
+		if(!(event->flags & MACSIM_EVENT_CANCELLED))
+			break;
+		if(event_time > limit || (node && node->time < event_time))
+			break;
+		macsim_backend_extract(&event);
+		free(event);
+		event = NULL;
+		cancelled_count--;
+	}
+	if(node && (!event || node->time < event_time || (node->time == event_time && ((struct macsim_event_t *) node)->seq < event->seq))){
+		*time = node->time;
+		return (struct macsim_event_t *) node;
+	}
+	*time = event_time;
+	return event && !(event->flags & MACSIM_EVENT_CANCELLED) ? event : NULL;
+}
+
+
+/* Función privada que extrae el evento más próximo
+ * @return Su instante */
+static inline long long macsim_queue_extract(struct macsim_event_t **event){
+	long long time;
+
+	macsim_queue_load();
+	if(!event_wheel && !cancelled_count) //Solo la implementación elegida
+		return macsim_backend_extract(event);
+
+	*event = macsim_queue_head(&time, LLONG_MAX);
+	if(!*event)
+		fatal("%s: the event queue is empty", __func__);
+	if((*event)->flags & MACSIM_EVENT_WHEEL)
+		timing_wheel_extract(event_wheel);
+	else
+		macsim_backend_extract(event);
+	return time;
+}
+
+
+/* Función privada que devuelve el instante del evento más próximo, sin extraerlo. Si es
+ * posterior a \limit puede devolver una cota inferior mayor que \limit (ver macsim_queue_head). */
+static inline long long macsim_queue_peek(long long limit){
+	long long time;
+
+	macsim_queue_load();
+	if(!event_wheel && !cancelled_count)
+		return macsim_backend_peek(NULL);
+	macsim_queue_head(&time, limit);
+	return time;
+}
+
+
+/* Función privada que extrae todos los eventos del instante más próximo, como mucho \size
+ * @return El número de eventos extraídos */
+static int macsim_queue_extract_all(long long *time, struct macsim_event_t **events, int size){
+	long long next;
+	int count;
+
+	macsim_queue_load();
+	if(event_wheel || cancelled_count){
+		*time = macsim_queue_extract(&events[0]);
+		for(count = 1; count < size && macsim_queue_head(&next, *time) && next == *time; count++)
+			macsim_queue_extract(&events[count]);
+		return count;
+	}
+
+	if(event_radix){
+		count = radix_heap_extract_min_all(event_radix, time, (void **) events, size);
+		if(radix_heap_error(event_radix))
+			fatal("%s: %s", __func__, radix_heap_error_msg(event_radix));
+		return count;
+	}
+	count = heap_extract_min_all(event_queue, time, (void **) events, size);
+	if(heap_error(event_queue))
+		fatal("%s: %s", __func__, heap_error_msg(event_queue));
+	return count;
+}
+
+
+/* Función privada que ordena las entradas de la cola por instante y orden de inserción, que es
+ * el orden en que se extraen */
+static int macsim_queue_entry_compare(const void *a, const void *b){
+	const struct macsim_queue_entry_t *x = (const struct macsim_queue_entry_t *) a;
+	const struct macsim_queue_entry_t *y = (const struct macsim_queue_entry_t *) b;
+
+	if(x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+	return (x->event->seq > y->event->seq) - (x->event->seq < y->event->seq);
+}
+
+
+/* Función privada que ordena \count entradas de la cola como macsim_queue_entry_compare. Con
+ * muchas se hace un radix sort de los bytes en que difieren los instantes, que es estable y no
+ * depende del orden en que vengan; después solo quedan por ordenar los empates. */
+static void macsim_queue_sort(struct macsim_queue_entry_t *entries, int count){
+	struct macsim_queue_entry_t *from = entries, *to, *buffer;
+	unsigned long long range;
+	long long min, max;
+	int i, j, shift, offsets[256];
+
+	if(count < MACSIM_SORT_RADIX){
+		qsort(entries, count, sizeof(struct macsim_queue_entry_t), macsim_queue_entry_compare);
+		return;
+	}
+	buffer = to = (struct macsim_queue_entry_t *) malloc(count * sizeof(struct macsim_queue_entry_t));
+	if(!buffer)
+		fatal("%s: out of memory", __func__);
+	for(i = 1, min = max = entries[0].time; i < count; i++){
+		if(entries[i].time < min)
+			min = entries[i].time;
+		if(entries[i].time > max)
+			max = entries[i].time;
+	}
+	range = (unsigned long long) (max - min);
+	for(shift = 0; shift < 64 && range >> shift; shift += 8){
+		memset(offsets, 0, sizeof(offsets));
+		for(i = 0; i < count; i++)
+			offsets[((unsigned long long) (from[i].time - min) >> shift) & 255]++;
+		for(i = 0, j = 0; i < 256; i++){
+			j += offsets[i];
+			offsets[i] = j - offsets[i];
+		}
+		for(i = 0; i < count; i++)
+			to[offsets[((unsigned long long) (from[i].time - min) >> shift) & 255]++] = from[i];
+		to = from;
+		from = to == entries ? buffer : entries;
+	}
+	if(from != entries)
+		memcpy(entries, from, count * sizeof(struct macsim_queue_entry_t));
+	free(buffer);
+
+	for(i = 0; i < count; i = j){
+		for(j = i + 1; j < count && entries[j].time == entries[i].time; j++);
+		if(j - i > 1)
+			qsort(entries + i, j - i, sizeof(struct macsim_queue_entry_t), macsim_queue_entry_compare);
+	}
+}
+
+
+/* Función privada que saca en orden todos los eventos en memoria y libera los cancelados. Los de
+ * disco no se tocan. En vez de extraerlos uno a uno, que con muchos eventos falla casi siempre
+ * en caché, se recorre la implementación tal como está guardada, se ordena lo recorrido y se
+ * cambia por una vacía; la rueda sí se vacía extrayendo, que cuesta O(1).
+ * @return Cuántos hay; \times y \events los reserva la función */
+static int macsim_queue_drain(long long **times, struct macsim_event_t ***events){
+	struct macsim_queue_entry_t *entries;
+	struct macsim_event_t *event;
+	struct radix_heap_iter_t radix_iter;
+	struct heap_iter_t iter;
+	long long time;
+	int i, count = 0, size = macsim_backend_count() + (event_wheel ? timing_wheel_count(event_wheel) : 0);
+
+	entries = (struct macsim_queue_entry_t *) malloc((size + 1) * sizeof(struct macsim_queue_entry_t));
+	if(!entries)
+		fatal("%s: out of memory", __func__);
+	if(event_radix)
+		radix_heap_iter_init(event_radix, &radix_iter);
+	else
+		heap_iter_init(event_queue, &iter);
+	while(event_radix ? radix_heap_iter_next(event_radix, &radix_iter, &time, (void **) &event) : heap_iter_next(event_queue, &iter, &time, (void **) &event)){
+		if(event->flags & MACSIM_EVENT_CANCELLED)
+			free(event);
+		else{
+			entries[count].time = time;
+			entries[count++].event = event;
+		}
+	}
+	while(event_wheel && (event = (struct macsim_event_t *) timing_wheel_extract(event_wheel))){
+		entries[count].time = event->node.time;
+		entries[count++].event = event;
+	}
+	macsim_queue_sort(entries, count);
+
+	*events = (struct macsim_event_t **) malloc((count + 1) * sizeof(struct macsim_event_t *));
+	*times = (long long *) malloc((count + 1) * sizeof(long long));
+	if(!*events || !*times)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < count; i++){
+		(*times)[i] = entries[i].time;
+		(*events)[i] = entries[i].event;
+	}
+	free(entries);
+
+	macsim_backend_free();
+	macsim_backend_create();
+	cancelled_count = 0;
+	macsim_backend_floor(current_time);
+	return count;
+}
+
+
+/* Función privada que pasa un evento a disco. Solo se conserva la estructura de los eventos de
+ * macsim_timeout, para que el usuario pueda seguir cancelándolos. */
+static void macsim_queue_spill_event(long long time, struct macsim_event_t *event){
+	struct macsim_spill_record_t record;
+
+	record.client = event->client;
+	record.kind = event->kind;
+	record.flags = event->flags & MACSIM_EVENT_REPLAY;
+	record.handle = NULL;
+	if(event->flags & MACSIM_EVENT_HANDLE){
+		event->flags = (event->flags & ~MACSIM_EVENT_WHEEL) | MACSIM_EVENT_SPILLED;
+		record.handle = event;
+	}
+	ext_queue_insert(event_spill, time, &record);
+	if(ext_queue_error(event_spill))
+		fatal("%s: %s", __func__, ext_queue_error_msg(event_spill));
+	if(!record.handle)
+		free(event);
+}
+
+
+/* Función privada que, con demasiados eventos en memoria, deja la mitad del límite y pasa los
+ * demás a disco, que desde ese momento guarda todo lo que empieza en el primero de ellos. El
+ * corte no separa eventos simultáneos; si no se puede cortar se espera a tener más. */
+static void macsim_queue_spill_far(){
+	struct macsim_event_t **events;
+	long long *times;
+	int i, keep, count = macsim_queue_drain(&times, &events);
+
+	for(keep = spill_limit / 2 > 0 ? spill_limit / 2 : 1; keep < count && times[keep] == times[keep - 1]; keep++);
+	if(keep < count){
+		for(i = keep; i < count; i++)
+			macsim_queue_spill_event(times[i], events[i]);
+		spill_time = times[keep];
+	}
+	spill_check = keep > spill_limit ? keep + spill_limit / 2 : spill_limit;
+	macsim_queue_insert_bulk(times, events, keep < count ? keep : count);
+	free(events);
+	free(times);
+}
+
+
+/* Función privada que carga de disco la mitad del límite de eventos, o más para no separar los
+ * simultáneos, y descarta los cancelados */
+static void macsim_queue_refill(){
+	struct macsim_spill_record_t record;
+	struct macsim_event_t **events, *event;
+	long long *times, time = 0;
+	int count = 0, size = (ext_queue_count(event_spill) < spill_limit / 2 ? ext_queue_count(event_spill) : spill_limit / 2) + 16;
+
+	events = (struct macsim_event_t **) malloc(size * sizeof(struct macsim_event_t *));
+	times = (long long *) malloc(size * sizeof(long long));
+	if(!events || !times)
+		fatal("%s: out of memory", __func__);
+	while(ext_queue_count(event_spill) && (count < spill_limit / 2 || ext_queue_peek(event_spill, NULL) == time)){
+		time = ext_queue_extract(event_spill, &record);
+		if(ext_queue_error(event_spill))
+			fatal("%s: %s", __func__, ext_queue_error_msg(event_spill));
+		if((event = record.handle)){
+			event->flags &= ~MACSIM_EVENT_SPILLED;
+			if(event->flags & MACSIM_EVENT_CANCELLED){
+				free(event);
+				spill_cancelled--;
+				continue;
+			}
+		}
+		else if((event = (struct macsim_event_t *) calloc(1, sizeof(struct macsim_event_t)))){
+			event->client = record.client;
+			event->kind = record.kind;
+			event->flags = record.flags;
+		}
+		else
+			fatal("%s: out of memory", __func__);
+		if(count == size){
+			size *= 2;
+			events = (struct macsim_event_t **) realloc(events, size * sizeof(struct macsim_event_t *));
+			times = (long long *) realloc(times, size * sizeof(long long));
+			if(!events || !times)
+				fatal("%s: out of memory", __func__);
+		}
+		events[count] = event;
+		times[count++] = time;
+	}
+	spill_time = ext_queue_count(event_spill) ? ext_queue_peek(event_spill, NULL) : LLONG_MAX;
+	spill_check = count > spill_limit ? count + spill_limit / 2 : spill_limit;
+	macsim_queue_insert_bulk(times, events, count);
+	free(events);
+	free(times);
+}
+
+
+/* Función privada que rehace la cola con la implementación \backend y \levels niveles de rueda,
+ * pasando los eventos pendientes en su orden de extracción */
+static void macsim_queue_configure(int backend, int levels){
+	struct macsim_event_t **events;
+	long long *times;
+	int count;
+
+	if(backend == queue_backend && levels == wheel_levels)
+		return;
+	if(!event_queue && !event_radix){ //Sin inicializar
+		queue_backend = backend;
+		wheel_levels = levels;
+		return;
+	}
+
+	count = macsim_queue_drain(&times, &events);
+	macsim_queue_free();
+	queue_backend = backend;
+	wheel_levels = levels;
+	macsim_queue_create();
+	macsim_queue_insert_bulk(times, events, count);
+	free(events);
+	free(times);
+}
+
+
+/* Función privada que devuelve los niveles de rueda que cubren \horizon ns */
+static int macsim_wheel_levels(long long horizon){
+	int levels = 0;
+
+	while(horizon > 0 && levels < TIMING_WHEEL_MAX_LEVELS && (levels == 0 || horizon >> (levels * TIMING_WHEEL_BITS))) //2^(8 * niveles) ns
+		levels++;
+	return levels;
+}
+
+
+/* Función privada que empieza una ventana de observación de MACSIM_QUEUE_AUTO. Dura
+ * MACSIM_ADAPT_WINDOW operaciones (extracciones y planificaciones), o tantas como eventos hay
+ * pendientes si son más, para que lo que cuesta cambiar de configuración, que es rehacer la
+ * cola, quede repartido entre ellas. */
+static void macsim_queue_adapt_mark(){
+	int loaded = macsim_queue_loaded();
+
+	adapt_events = queue_events;
+	adapt_pending_sum = queue_pending_sum;
+	memcpy(adapt_distance, queue_distance, sizeof(queue_distance));
+	adapt_next = queue_events + queue_scheduled + (loaded > MACSIM_ADAPT_WINDOW ? loaded : MACSIM_ADAPT_WINDOW);
+}
+
+
+/* Función privada que, al final de una ventana, elige la configuración de la cola que mejor va
+ * con lo observado en ella: el montículo binario con pocos eventos pendientes y el radix heap
+ * con más, y delante una rueda de tiempos si los pendientes están en el rango en que compensa y
+ * la mayoría de las distancias de planificación caben en pocos niveles. Después de la primera
+ * ventana solo se cambia si dos seguidas coinciden, para no ir y volver por una ráfaga.
+ * macsim_queue_configure pasa los eventos en su orden de extracción, así que el cambio no se
+ * nota en la simulación. */
+static void macsim_queue_adapt(){
+	long long events = queue_events - adapt_events, pending, total = 0, covered = 0;
+	int i, backend, levels = 0, choice;
+
+	pending = events ? (queue_pending_sum - adapt_pending_sum) / events : macsim_queue_count(); //Sin extracciones, los de ahora
+	for(i = 0; i < MACSIM_QUEUE_DISTANCES; i++)
+		total += queue_distance[i] - adapt_distance[i];
+	for(i = 0; i < MACSIM_QUEUE_DISTANCES && covered < total * MACSIM_ADAPT_QUANTILE; i++)
+		covered += queue_distance[i] - adapt_distance[i];
+
+	backend = pending < MACSIM_ADAPT_SMALL ? MACSIM_QUEUE_HEAP : MACSIM_QUEUE_RADIX;
+	if(total && pending >= MACSIM_ADAPT_WHEEL_MIN && pending <= MACSIM_ADAPT_WHEEL_MAX){
+		levels = macsim_wheel_levels(i > 1 ? 1LL << (i - 1) : 1); //Las distancias cubiertas son menores que 2^(i-1)
+		if(levels > MACSIM_ADAPT_WHEEL_LEVELS)
+			levels = 0;
+	}
+	choice = backend + 2 * levels;
+	if((choice == adapt_choice || adapt_choice < 0) && (backend != queue_backend || levels != wheel_levels)){
+		macsim_queue_configure(backend, levels);
+		queue_migrations++;
+	}
+	adapt_choice = choice;
+	macsim_queue_adapt_mark();
+}
+
+
+/* Función privada que anota una extracción de \count eventos en la instrumentación de la cola */
+static inline void macsim_queue_observe(int count){
+	long long pending = macsim_queue_count();
+
+	queue_events += count;
+	queue_pending_sum += pending * count;
+	if(pending > queue_pending_max)
+		queue_pending_max = pending;
+	if(queue_auto && queue_events + queue_scheduled >= adapt_next)
+		macsim_queue_adapt();
+}
+
+
+/* Función privada que anota en la instrumentación de la cola un evento planificado por el
+ * usuario para el instante \time */
+static inline void macsim_queue_distance(long long time){
+	long long distance = time - current_time;
+
+	queue_scheduled++;
+	queue_distance[distance > 0 ? 64 - __builtin_clzll(distance) : 0]++;
+}
+
+
+/* Elige la implementación de la cola de eventos (enum macsim_queue_enum). Se puede llamar antes
+ * de macsim_init o durante la simulación, en cuyo caso los eventos pendientes pasan a la nueva
+ * cola en su orden de extracción. Con MACSIM_QUEUE_AUTO la librería elige la implementación y
+ * la rueda de tiempos, empezando por la configuración actual, y las va cambiando según el número
+ * de eventos pendientes y las distancias de planificación que observa (macsim_queue_stats). */
+void macsim_queue_backend(int backend){
+	if(backend != MACSIM_QUEUE_HEAP && backend != MACSIM_QUEUE_RADIX && backend != MACSIM_QUEUE_AUTO)
+		fatal("%s: unknown event queue %d", __func__, backend);
+	queue_auto = backend == MACSIM_QUEUE_AUTO;
+	adapt_choice = -1;
+	if(!queue_auto)
+		macsim_queue_configure(backend, wheel_levels);
+	else if(event_queue || event_radix)
+		macsim_queue_adapt_mark();
+}
+
+
+/* Pone delante de la cola de eventos una rueda de tiempos jerárquica (timing-wheel.h) para los
+ * eventos planificados a menos de \horizon_ms del instante actual, o la quita con 0. En la rueda
+ * insertar y cancelar cuestan O(1); los eventos más lejanos van a la cola de siempre. El orden
+ * de extracción no cambia, FIFO en los empates incluido. Como macsim_queue_backend, se puede
+ * llamar en cualquier momento; con MACSIM_QUEUE_AUTO la rueda puede cambiar después. */
+void macsim_queue_wheel(double horizon_ms){
+	if(horizon_ms < 0)
+		fatal("%s: the horizon can't be negative", __func__);
+	macsim_queue_configure(queue_backend, macsim_wheel_levels((long long) (horizon_ms * 1000000)));
+}
+
+
+/* Función privada que empieza a usar el disco con la configuración de macsim_queue_spill */
+static void macsim_queue_spill_open(){
+	double bytes = spill_mb * 1048576;
+	int buffer = bytes / 8 / (sizeof(struct macsim_spill_record_t) + 16), runs = bytes / 8 / EXT_QUEUE_WINDOW;
+
+	spill_limit = bytes * 3 / 4 / MACSIM_EVENT_MEMORY;
+	if(spill_limit < 64)
+		spill_limit = 64;
+	event_spill = ext_queue_create(spill_dir, sizeof(struct macsim_spill_record_t), buffer < 1024 ? 1024 : buffer, runs < 4 ? 4 : runs);
+	if(!event_spill)
+		fatal("%s: out of memory", __func__);
+	spill_check = spill_limit;
+	spill_cancelled = 0;
+	spill_time = LLONG_MAX;
+	if(macsim_queue_loaded() > spill_check)
+		macsim_queue_spill_far();
+}
+
+
+/* Función privada que deja de usar el disco, cargando en memoria todo lo que haya en él */
+static void macsim_queue_spill_close(){
+	spill_limit = INT_MAX / 4;
+	while(ext_queue_count(event_spill))
+		macsim_queue_refill();
+	ext_queue_free(event_spill);
+	event_spill = NULL;
+	spill_time = LLONG_MAX;
+}
+
+
+/* Limita a unos \memory_mb MB la memoria de la cola de eventos. Cuando se llena, los eventos más
+ * lejanos pasan a ficheros ordenados en \dir (NULL: $TMPDIR o /tmp, ver ext-queue.h), que se
+ * borran solos, y vuelven a memoria cuando les llega el turno; el orden de extracción no cambia.
+ * Tres cuartos de la memoria son para eventos y el resto, a partes iguales, para el búfer de
+ * los ficheros y las ventanas con que se leen (ver ext-queue.h). Los
+ * eventos de macsim_timeout siguen en memoria aunque estén en disco, para poder cancelarlos.
+ * Con 0 se deja de usar el disco. Como macsim_queue_backend, se puede llamar en cualquier momento. */
+void macsim_queue_spill(double memory_mb, const char *dir){
+	if(memory_mb < 0)
+		fatal("%s: the memory can't be negative", __func__);
+	if(event_spill)
+		macsim_queue_spill_close();
+	free(spill_dir);
+	spill_dir = NULL;
+	spill_mb = memory_mb;
+	if(!memory_mb)
+		return;
+	if(!dir && !(dir = getenv("TMPDIR")))
+		dir = "/tmp";
+	if(!(spill_dir = strdup(dir)))
+		fatal("%s: out of memory", __func__);
+	if(event_queue || event_radix)
+		macsim_queue_spill_open();
+}
+
+
+/* Función privada que pone a cero la instrumentación de la cola */
+static void macsim_queue_stats_clear(){
+	queue_events = 0;
+	queue_scheduled = 0;
+	queue_pending_sum = 0;
+	queue_pending_max = 0;
+	memset(queue_distance, 0, sizeof(queue_distance));
+	queue_migrations = 0;
+	adapt_choice = -1;
+	if(queue_auto)
+		macsim_queue_adapt_mark();
+}
+
+
+/* Deja en \stats la instrumentación de la cola de eventos desde macsim_init o macsim_reset y su
+ * configuración actual */
+void macsim_queue_stats(struct macsim_queue_stats_t *stats){
+	stats->events = queue_events;
+	stats->pending = event_queue || event_radix ? macsim_queue_count() : 0;
+	stats->max_pending = queue_pending_max;
+	stats->mean_pending = queue_events ? (double) queue_pending_sum / queue_events : 0;
+	memcpy(stats->distance, queue_distance, sizeof(queue_distance));
+	stats->backend = queue_backend;
+	stats->wheel_ms = wheel_levels ? (1LL << (wheel_levels * TIMING_WHEEL_BITS)) / 1000000.0 : 0;
+	stats->migrations = queue_migrations;
+}
+
+
+#ifdef MACSIM_PROFILE
+/* Función privada que lee el reloj de la instrumentación: el contador de ciclos del procesador
+ * si se puede leer, y si no los nanosegundos del reloj monótono */
+static inline unsigned long long macsim_profile_clock(){
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+/* Función privada que empieza una llamada a la operación \probe
+ * @return El reloj si se mide esta llamada, si no 0 */
+static inline unsigned long long macsim_probe_begin(int probe){
+	return ++profile_probes[probe].calls & (MACSIM_PROFILE_SAMPLE - 1) ? 0 : macsim_profile_clock();
+}
+
+
+/* Función privada que termina una llamada a la operación \probe empezada en \start */
+static inline void macsim_probe_end(int probe, unsigned long long start){
+	if(start){
+		profile_probes[probe].cycles += macsim_profile_clock() - start;
+		profile_probes[probe].samples++;
+	}
+}
+
+
+/* Función privada que apunta la longitud de la cola. Cuando se llena el vector se queda una
+ * muestra de cada dos y se muestrea la mitad de veces, así que siempre cubre toda la simulación. */
+static void macsim_profile_depth(){
+	int i;
+
+	profile_depth[profile_depth_count].time = current_time;
+	profile_depth[profile_depth_count].events = queue_events;
+	profile_depth[profile_depth_count++].pending = macsim_queue_count();
+	if(profile_depth_count == MACSIM_PROFILE_DEPTH){
+		for(i = 0; i < MACSIM_PROFILE_DEPTH / 2; i++)
+			profile_depth[i] = profile_depth[2 * i + 1];
+		profile_depth_count = MACSIM_PROFILE_DEPTH / 2;
+		profile_depth_period *= 2;
+	}
+	profile_depth_next = queue_events + profile_depth_period;
+}
+
+
+/* Función privada que anota un evento extraído de tipo \kind. Con uno de cada
+ * MACSIM_PROFILE_SAMPLE de cada tipo se mide lo que pasa hasta la siguiente extracción, que es
+ * lo que tarda su manejador con todo lo que llama. */
+static inline void macsim_profile_event(int kind){
+	struct macsim_probe_t *probe = &profile_kinds[kind >= 0 && kind < MACSIM_PROFILE_KINDS ? kind : MACSIM_PROFILE_KINDS];
+
+	if(!(++probe->calls & (MACSIM_PROFILE_SAMPLE - 1))){
+		profile_handler = probe;
+		profile_handler_start = macsim_profile_clock();
+	}
+	if(queue_events >= profile_depth_next)
+		macsim_profile_depth();
+}
+
+
+/* Función privada que, al volver a extraer, termina la medida del manejador anterior */
+static inline void macsim_profile_handler_end(){
+	if(profile_handler){
+		profile_handler->cycles += macsim_profile_clock() - profile_handler_start;
+		profile_handler->samples++;
+		profile_handler = NULL;
+	}
+}
+
+
+/* Función privada que devuelve el instante real en ns */
+static double macsim_profile_wall(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* Función privada que añade una fila a la salida de macsim_profile si cabe */
+static void macsim_profile_row(struct macsim_profile_entry_t *entries, int size, int *k, const char *metric, const char *name, double time, long long count, double value){
+	if(*k < size){
+		entries[*k].metric = metric;
+		snprintf(entries[*k].name, sizeof(entries[*k].name), "%s", name);
+		entries[*k].time = time;
+		entries[*k].count = count;
+		entries[*k].value = value;
+	}
+	(*k)++;
+}
+#endif
+
+
+/* Función privada que pone a cero la instrumentación de MACSIM_PROFILE */
+static void macsim_profile_clear(){
+#ifdef MACSIM_PROFILE
+	memset(profile_probes, 0, sizeof(profile_probes));
+	memset(profile_kinds, 0, sizeof(profile_kinds));
+	profile_handler = NULL;
+	profile_depth_count = 0;
+	profile_depth_period = profile_depth_next = MACSIM_PROFILE_PERIOD;
+	profile_clock_start = macsim_profile_clock();
+	profile_wall_start = macsim_profile_wall();
+#endif
+}
+
+
+/* Rellena \entries con la instrumentación de MACSIM_PROFILE desde macsim_init o macsim_reset: los
+ * ciclos por µs del reloj, cada operación medida, cada tipo de evento que ha aparecido (con
+ * nombre "other" los que no tienen contador propio) y la longitud de la cola a lo largo de la
+ * simulación. Como macsim_results, rellena como mucho \size filas, así que con \size 0 solo se
+ * cuentan. Las filas se escriben con macsim_report_profile (report.h).
+ * @return El número de filas, 0 si la librería se ha compilado sin MACSIM_PROFILE */
+int macsim_profile(struct macsim_profile_entry_t *entries, int size){
+	int k = 0;
+#ifdef MACSIM_PROFILE
+	double wall = macsim_profile_wall() - profile_wall_start;
+	char name[32];
+	int i;
+
+#if defined(__x86_64__) || defined(__i386__)
+	macsim_profile_row(entries, size, &k, "clock", "rdtsc", 0, 0, wall > 0 ? (macsim_profile_clock() - profile_clock_start) / wall * 1000 : 0);
+#else
+	macsim_profile_row(entries, size, &k, "clock", "ns", 0, 0, 1000);
+#endif
+	for(i = 0; i < MACSIM_PROBES; i++)
+		macsim_profile_row(entries, size, &k, "probe", probe_names[i], 0, profile_probes[i].calls,
+			profile_probes[i].samples ? (double) profile_probes[i].cycles / profile_probes[i].samples : 0);
+	for(i = 0; i <= MACSIM_PROFILE_KINDS; i++){
+		if(!profile_kinds[i].calls)
+			continue;
+		if(i < MACSIM_PROFILE_KINDS)
+			snprintf(name, sizeof(name), "%d", i);
+		else
+			snprintf(name, sizeof(name), "other");
+		macsim_profile_row(entries, size, &k, "kind", name, 0, profile_kinds[i].calls,
+			profile_kinds[i].samples ? (double) profile_kinds[i].cycles / profile_kinds[i].samples : 0);
+	}
+	for(i = 0; i < profile_depth_count; i++)
+		macsim_profile_row(entries, size, &k, "depth", "", profile_depth[i].time / 1000000.0, profile_depth[i].events, profile_depth[i].pending);
+#endif
+	return k;
+}
+
+
+/* Función privada que devuelve el instante real en segundos */
+static double macsim_monitor_now(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Función privada que copia el estado de la simulación en el segmento de macsim_monitor. Las
+ * estaciones y la cola solo se miran con la librería inicializada. */
+static void macsim_monitor_publish(int state){
+	struct macsim_monitor_station_t *s;
+	struct macsim_station_t *station;
+	struct string_map_iter_t iter;
+	struct macsim_result_t result;
+	double now = macsim_monitor_now(), mean = 0, half_width = 0;
+	long long events = queue_events - (queue_events >= monitor_last_events ? monitor_last_events : 0);
+	char *key;
+	int k = 0, batches = 0;
+
+	macsim_monitor_write_begin(monitor);
+	monitor->state = state;
+	monitor->updates++;
+	monitor->wall_seconds = now - monitor_start;
+	monitor->time_ms = current_time / 1000000.0;
+	monitor->events = queue_events;
+	if(now > monitor_last)
+		monitor->events_per_second = events / (now - monitor_last);
+	monitor->pending = stations ? macsim_queue_count() : 0;
+	monitor->precision = running ? running->precision : 0;
+	if(running && running->precision > 0)
+		resultado(&mean, &half_width, &batches);
+	monitor->batches = batches;
+	monitor->mean = batches >= 10 ? mean : 0;
+	monitor->half_width = batches >= 10 ? half_width : 0;
+	if(stations){
+		STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+			if(k < MACSIM_MONITOR_STATIONS){
+				s = &monitor->stations[k];
+				macsim_network_result(&result, station->name, station->total_clients, station->total_response_time,
+					station->total_service_time, current_time - last_reset_time);
+				snprintf(s->name, sizeof(s->name), "%s", station->name);
+				s->total_clients = result.total_clients;
+				s->queue_length = ilist_count(&station->clients);
+				s->service_time = result.service_time;
+				s->response_time = result.response_time;
+				s->queue_time = result.queue_time;
+				s->throughput = result.throughput;
+				s->utilization = result.utilization;
+			}
+			k++;
+		}
+	}
+	monitor->station_count = k;
+	macsim_monitor_write_end(monitor);
+	monitor_last = now;
+	monitor_last_events = queue_events;
+}
+
+
+/* Función privada que, cada monitor_stride eventos, publica si ha pasado el periodo. El número
+ * de eventos entre lecturas del reloj se dobla o se divide a la mitad para leerlo unas
+ * MACSIM_MONITOR_CHECKS veces por periodo, sin pasar de MACSIM_MONITOR_STRIDE eventos. */
+static void macsim_monitor_check(){
+	double now = macsim_monitor_now();
+
+	if(now - monitor_checked < monitor_period / MACSIM_MONITOR_CHECKS){
+		if(monitor_stride < MACSIM_MONITOR_STRIDE)
+			monitor_stride *= 2;
+	}else if(monitor_stride > 1)
+		monitor_stride /= 2;
+	monitor_checked = now;
+	monitor_countdown = monitor_stride;
+	if(now - monitor_last >= monitor_period)
+		macsim_monitor_publish(MACSIM_MONITOR_RUNNING);
+}
+
+
+/* Función privada que cuenta \count eventos extraídos para macsim_monitor */
+static inline void macsim_monitor_events(int count){
+	if(monitor && (monitor_countdown -= count) <= 0)
+		macsim_monitor_check();
+}
+
+
+/* Publica el estado de la simulación en el segmento de memoria compartida \name (ver monitor.h)
+ * cada \period_s segundos (1 si es 0): instante de la simulación, eventos por segundo, eventos
+ * pendientes, progreso de batch means del bucle de macsim_run y estadísticas de cada estación.
+ * Se publica desde el bucle de eventos, entre dos eventos, así que la simulación no se para
+ * nunca a esperar a quien lo lee (tools/macsim-top). Con \name NULL se deja de publicar; en
+ * macsim_exit se publica el estado final y se cierra. El segmento sobrevive a macsim_init.
+ * Es un error usar un nombre que está publicando otra simulación en marcha. */
+void macsim_monitor(const char *name, double period_s){
+	if(monitor){
+		macsim_monitor_publish(MACSIM_MONITOR_FINISHED);
+		macsim_monitor_destroy(monitor, monitor_name);
+		free(monitor_name);
+		monitor = NULL;
+	}
+	if(!name)
+		return;
+	monitor = macsim_monitor_create(name);
+	monitor_name = strdup(name);
+	if(!monitor || !monitor_name)
+		fatal("%s: can't create shared memory segment \"%s\"", __func__, name);
+	monitor_period = period_s > 0 ? period_s : 1;
+	monitor_start = monitor_last = monitor_checked = macsim_monitor_now();
+	monitor_last_events = queue_events;
+	monitor_stride = monitor_countdown = 1;
+	macsim_monitor_publish(MACSIM_MONITOR_RUNNING);
+}
+
+
 /* Inicialización de la librería */
 void macsim_init(){
-	event_queue = heap_create(512); //Tamaño inicial
-	if(!event_queue)
-		fatal("%s: out of memory", __func__);
-	stations = hash_table_create(512, 1); //El 1 indica que las claves distinguen mayúsculas y minúsculas. 512 es el tamaño inicial.
+	macsim_queue_create();
+	if(spill_dir)
+		macsim_queue_spill_open();
+	macsim_queue_stats_clear();
+	macsim_profile_clear();
+	stations = string_map_create(512, 1); //El 1 indica que las claves distinguen mayúsculas y minúsculas. 512 es el tamaño inicial.
 	if(!stations)
 		fatal("%s: out of memory", __func__);
+	ilist_init(&client_pool);
+	macsim_streams_save();
 }
 
 
 /* Liberación de la memoria usada por la libreria */
 void macsim_exit(){
 	struct macsim_station_t *station;
-	struct macsim_event_t *event;
+	struct ilist_link_t *link;
 	char *key;
+
+	/* Publicar el estado final y dejar de publicar */
+	macsim_monitor(NULL, 0);
 	
 	/* Destruir cola de enventos */
-	for(heap_first(event_queue, (void**)&event); heap_next(event_queue, (void**)&event);){
-		free(event);
-	}
-	heap_free(event_queue);
+	macsim_event_queue_clear();
+	macsim_queue_free();
+	if(event_spill)
+		ext_queue_free(event_spill);
+	event_spill = NULL;
 	
 	/* Destruir estaciones y clientes */
-	HASH_TABLE_FOR_EACH(stations, key, station){
+	STRING_MAP_FOR_EACH(stations, key, station){
 		macsim_station_destroy(station);
 	}
-	hash_table_free(stations);
+	string_map_free(stations);
+	stations = NULL;
+
+	/* Liberar los clientes reservados */
+	while((link = ilist_pop_front(&client_pool)))
+		free(ILIST_ENTRY(link, struct macsim_station_client_t, link));
+
+	/* Cerrar la traza binaria */
+	macsim_trace_binary_close();
+
+	/* La carga es del usuario, solo se deja de reproducir */
+	replay = NULL;
+
+	free(event_batch);
+	event_batch = NULL;
+	event_batch_size = 0;
+}
+
+
+/* Vuelve la simulación al estado de macsim_init sin liberar memoria, para repetirla con
+ * otros parámetros: reloj a 0, cola de eventos vacía, estaciones vacías y con estadísticas a
+ * cero y streams aleatorios en su estado de partida (el de macsim_init o la última
+ * semilla fijada con macsim_seed). Las estaciones, la cola y los clientes reservados se conservan. */
+void macsim_reset(){
+	struct macsim_station_t *station;
+	struct string_map_iter_t iter;
+	char *key;
+
+	macsim_event_queue_clear();
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		macsim_station_clear(station);
+		station->total_clients = 0;
+		station->total_response_time = 0;
+		station->total_service_time = 0;
+	}
+	current_time = 0;
+	last_reset_time = 0;
+	current_event = 0;
+	replay = NULL;
+	macsim_queue_stats_clear();
+	macsim_profile_clear();
+	macsim_streams_restore();
 }
 
 
@@ -95,48 +1344,362 @@ long long macsim_get_last_reset_time(){
 }
 
 
-/* Insertar un evento planificado para dentro de \ms milisegundos.
- * El evendo insertado será de tipo \kind con id de cliente \client_id.
- * El uso de un double y pasar el tiempo en milisegundos busca evitarle al usuario tener que trabajar en nanosegundos, que es como internamente trabaja la librería. */
-void macsim_schedule(int kind, long long client_id, double ms){
+/* Función privada que inserta en la cola un evento para el instante absoluto \time
+ * @return El evento */
+static struct macsim_event_t * macsim_event_insert(int kind, long long client_id, long long time, int flags){
 	struct macsim_event_t *event = (struct macsim_event_t *) calloc(1, sizeof(struct macsim_event_t));
 	if(!event)
 		fatal("%s: out of memory", __func__);
 	event->client = client_id;
 	event->kind = kind;
-	heap_insert(event_queue, current_time + (long long) (ms * 1000000), event);
-	if(heap_error(event_queue))
-		fatal("%s: %s", __func__, heap_error_msg(event_queue));
+	event->flags = flags;
+	macsim_queue_distance(time);
+	macsim_queue_insert(time, event);
+	return event;
+}
+
+
+/* Insertar un evento planificado para dentro de \ms milisegundos.
+ * El evendo insertado será de tipo \kind con id de cliente \client_id.
+ * El uso de un double y pasar el tiempo en milisegundos busca evitarle al usuario tener que trabajar en nanosegundos, que es como internamente trabaja la librería. */
+void macsim_schedule(int kind, long long client_id, double ms){
+	macsim_event_insert(kind, client_id, current_time + (long long) (ms * 1000000), 0);
 }
 
 
 /* Insertar un evento planificado para dentro de \ns nanosegundos
  * El evendo insertado será de tipo \kind con id de cliente \client_id */
 void macsim_schedule_ns(int kind, long long client_id, long long ns){
-	struct macsim_event_t *event = (struct macsim_event_t *) calloc(1, sizeof(struct macsim_event_t));
-	if(!event)
+	macsim_event_insert(kind, client_id, current_time + ns, 0);
+}
+
+
+/* Función privada que crea \count eventos de tipo \kind para los clientes \client_ids, a los
+ * instantes absolutos \times, y los inserta de una vez; \times se modifica */
+static void macsim_event_insert_bulk(int kind, const long long *client_ids, long long *times, int count){
+	int i, first, chunk = event_spill ? spill_limit / 2 + 1 : count; //Con disco, sin pasarse de memoria
+	struct macsim_event_t **events = (struct macsim_event_t **) malloc((chunk + 1) * sizeof(struct macsim_event_t *));
+
+	if(!events)
 		fatal("%s: out of memory", __func__);
-	event->client = client_id;
-	event->kind = kind;
-	heap_insert(event_queue, current_time + ns, event);
-	if(heap_error(event_queue))
+	for(first = 0; first < count; first += chunk){
+		if(chunk > count - first)
+			chunk = count - first;
+		for(i = 0; i < chunk; i++){
+			events[i] = (struct macsim_event_t *) calloc(1, sizeof(struct macsim_event_t));
+			if(!events[i])
+				fatal("%s: out of memory", __func__);
+			events[i]->client = client_ids[first + i];
+			events[i]->kind = kind;
+			macsim_queue_distance(times[first + i]);
+		}
+		macsim_queue_insert_bulk(times + first, events, chunk);
+	}
+	free(events);
+}
+
+
+/* Inserta de una vez \count eventos de tipo \kind, el i-ésimo para el cliente \client_ids[i]
+ * dentro de \ms[i] milisegundos. Equivale a llamar a macsim_schedule con cada uno en orden,
+ * empates incluidos, pero con el montículo binario cuesta O(n) en vez de O(n log n): es la forma
+ * de planificar de antemano muchas llegadas. */
+void macsim_schedule_bulk(int kind, const long long *client_ids, const double *ms, int count){
+	long long *times = (long long *) malloc((count + 1) * sizeof(long long));
+	int i;
+
+	if(!times)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < count; i++)
+		times[i] = current_time + (long long) (ms[i] * 1000000);
+	macsim_event_insert_bulk(kind, client_ids, times, count);
+	free(times);
+}
+
+
+/* Como macsim_schedule_bulk, con los retardos \ns en nanosegundos */
+void macsim_schedule_bulk_ns(int kind, const long long *client_ids, const long long *ns, int count){
+	long long *times = (long long *) malloc((count + 1) * sizeof(long long));
+	int i;
+
+	if(!times)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < count; i++)
+		times[i] = current_time + ns[i];
+	macsim_event_insert_bulk(kind, client_ids, times, count);
+	free(times);
+}
+
+
+/* Reserva espacio en la cola de eventos para \events eventos pendientes, para que no tenga que
+ * crecer mientras se llena. Se puede llamar antes de macsim_init. Con el radix heap no hace nada. */
+void macsim_reserve(int events){
+	event_reserve = events;
+	if(event_queue && !heap_reserve(event_queue, events))
 		fatal("%s: %s", __func__, heap_error_msg(event_queue));
 }
 
 
-/* Extraer de la cola de eventos */
-void macsim_extract(int *kind, long long *client_id){
+/* Como macsim_schedule, pero devuelve el evento para poder cancelarlo con macsim_cancel
+ * (temporizadores). El evento vale hasta que se extrae o se cancela. */
+struct macsim_event_t * macsim_timeout(int kind, long long client_id, double ms){
+	return macsim_event_insert(kind, client_id, current_time + (long long) (ms * 1000000), MACSIM_EVENT_HANDLE);
+}
+
+
+/* Cancela un evento de macsim_timeout que todavía no se ha extraído. En la rueda de tiempos se
+ * quita en O(1); en la cola o en disco se marca y se libera cuando llega al principio. */
+void macsim_cancel(struct macsim_event_t *event){
+	if(event->flags & (MACSIM_EVENT_REPLAY | MACSIM_EVENT_CANCELLED))
+		fatal("%s: the event can't be cancelled", __func__);
+	if(event->flags & MACSIM_EVENT_WHEEL){
+		timing_wheel_remove(event_wheel, &event->node);
+		free(event);
+		return;
+	}
+	event->flags |= MACSIM_EVENT_CANCELLED;
+	if(event->flags & MACSIM_EVENT_SPILLED)
+		spill_cancelled++;
+	else
+		cancelled_count++;
+}
+
+
+/* Función privada que extrae el siguiente evento de la cola; la comparten macsim_extract y
+ * el bucle de macsim_run, donde el compilador la puede integrar */
+static inline void macsim_event_next(int *kind, long long *client_id){
 	struct macsim_event_t *event;
-	
-	current_time = heap_extract(event_queue, (void**)&event); //Actualizar el instante actual
-	if(heap_error(event_queue))
-		fatal("%s: %s", __func__, heap_error_msg(event_queue));
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_EXTRACT);
+
+	MACSIM_PROFILE_HANDLER_END();
+	current_time = macsim_queue_extract(&event); //Actualizar el instante actual
 
 	current_event = event->kind; //Actualizar el evento actual
 	*kind = event->kind;
 	*client_id = event->client;
 
+	/* Mantener la ventana de llegadas pendientes de la carga */
+	if(event->flags & MACSIM_EVENT_REPLAY)
+		macsim_replay_schedule();
+
 	free(event);
+	macsim_queue_observe(1);
+	macsim_monitor_events(1);
+	MACSIM_PROBE_END(MACSIM_PROBE_EXTRACT);
+	MACSIM_PROFILE_EVENT(*kind);
+}
+
+
+/* Extraer de la cola de eventos */
+void macsim_extract(int *kind, long long *client_id){
+	macsim_event_next(kind, client_id);
+}
+
+
+/* Extrae de una vez todos los eventos del instante más próximo, como mucho \size, en el orden
+ * en que los devolvería macsim_extract, y deja sus tipos en \kinds y sus clientes en \client_ids.
+ * La cola los quita en bloque, que es más barato que extraerlos uno a uno cuando hay muchos
+ * simultáneos (reactivaciones con retardo 0 de macsim_station_leave, llegadas sincronizadas).
+ * Antes de procesar cada uno con macsim_station_request hay que indicar su tipo con
+ * macsim_set_current_event, que es el que recibirá el cliente si tiene que esperar.
+ * @return El número de eventos extraídos */
+int macsim_extract_all(int *kinds, long long *client_ids, int size){
+	struct macsim_event_t *event;
+	int k, count;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_EXTRACT);
+
+	if(size < 1)
+		fatal("%s: the buffer must hold at least one event", __func__);
+	MACSIM_PROFILE_HANDLER_END();
+	if(size > event_batch_size){
+		event_batch_size = size;
+		event_batch = (struct macsim_event_t **) realloc(event_batch, size * sizeof(struct macsim_event_t *));
+		if(!event_batch)
+			fatal("%s: out of memory", __func__);
+	}
+	count = macsim_queue_extract_all(&current_time, event_batch, size);
+
+	for(k = 0; k < count; k++){
+		event = event_batch[k];
+		kinds[k] = event->kind;
+		client_ids[k] = event->client;
+		if(event->flags & MACSIM_EVENT_REPLAY)
+			macsim_replay_schedule();
+		free(event);
+	}
+	current_event = kinds[0];
+	macsim_queue_observe(count);
+	macsim_monitor_events(count);
+	MACSIM_PROBE_END(MACSIM_PROBE_EXTRACT);
+	for(k = 0; k < count; k++)
+		MACSIM_PROFILE_EVENT(kinds[k]);
+	return count;
+}
+
+
+/* Cambia el tipo del evento en curso; ver macsim_extract_all */
+void macsim_set_current_event(int kind){
+	current_event = kind;
+}
+
+
+/* Función privada que cierra el bucle en marcha: tiempos, resultados de batch means y, si no
+ * se ha pedido silencio, los eventos por segundo por la salida de error */
+static void macsim_run_end(struct macsim_run_t *run){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	run->seconds = ts.tv_sec + ts.tv_nsec / 1e9 - run_start;
+	run->events_per_second = run->seconds > 0 ? run->events / run->seconds : 0;
+	if(run->precision > 0)
+		resultado(&run->mean, &run->half_width, &run->batches);
+	if(!run->quiet)
+		fprintf(stderr, "macsim_run: %lld eventos en %.3f s (%.0f eventos/s)\n", run->events, run->seconds, run->events_per_second);
+	running = NULL;
+}
+
+
+/* Prepara \run para un bucle de eventos con macsim_run_next (ver MACSIM_RUN_FOR_EACH).
+ * Si hay precisión, configura batch means con los parámetros de \run. */
+void macsim_run_begin(struct macsim_run_t *run){
+	struct timespec ts;
+
+	if(running)
+		fatal("%s: there is already a running loop", __func__);
+	running = run;
+	run->reason = MACSIM_STOP_NONE;
+	run->events = 0;
+	run->seconds = run->events_per_second = 0;
+	run->mean = run->half_width = 0;
+	run->batches = 0;
+	run_horizon = run->horizon_ms > 0 ? (long long) (run->horizon_ms * 1000000) : 0;
+	if(run->precision > 0)
+		batch_mean(run->transient, run->batch > 0 ? run->batch : 1000, run->precision, run->confidence > 0 ? run->confidence : 0.95);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	run_start = ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Extrae el siguiente evento del bucle \run si no se cumple ningún criterio de parada.
+ * Al parar por horizonte el reloj avanza hasta él, para que las estadísticas cubran todo el periodo;
+ * si el reloj ya lo había pasado (un horizonte anterior al instante actual) no se mueve.
+ * @return 1 si hay evento o 0 si el bucle ha terminado (el motivo queda en run->reason) */
+int macsim_run_next(struct macsim_run_t *run, int *kind, long long *client_id){
+	if(!run->reason){
+		if(!macsim_queue_count())
+			run->reason = MACSIM_STOP_EMPTY;
+		else if(run->max_events && run->events >= run->max_events)
+			run->reason = MACSIM_STOP_EVENTS;
+		else if(run_horizon && macsim_queue_peek(run_horizon) > run_horizon){
+			run->reason = MACSIM_STOP_HORIZON;
+			if(run_horizon > current_time)
+				current_time = run_horizon;
+		}
+	}
+	if(run->reason){
+		macsim_run_end(run);
+		return 0;
+	}
+	macsim_event_next(kind, client_id);
+	run->events++;
+	return 1;
+}
+
+
+/* Simula hasta que se cumpla algún criterio de parada de \run llamando, para cada evento, al
+ * manejador de su tipo en la tabla \handlers de \count entradas, con \data como argumento.
+ * Un tipo de evento sin manejador es un error. */
+void macsim_run(struct macsim_run_t *run, macsim_handler_t *handlers, int count, void *data){
+	long long client_id;
+	int kind;
+
+	macsim_run_begin(run);
+	while(macsim_run_next(run, &kind, &client_id)){
+		if((unsigned) kind >= (unsigned) count || !handlers[kind])
+			fatal("%s: no handler for event %d", __func__, kind);
+		handlers[kind](client_id, data);
+	}
+}
+
+
+/* Añade una observación (p.ej. un tiempo de respuesta) al batch means del bucle en marcha, que
+ * para cuando se alcanza su precisión. Sin bucle o sin precisión no hace nada. */
+void macsim_observe(double value){
+	if(running && running->precision > 0 && observacion(value) && !running->reason)
+		running->reason = MACSIM_STOP_PRECISION;
+}
+
+
+/* Pide al bucle en marcha que termine antes del siguiente evento */
+void macsim_stop(){
+	if(running && !running->reason)
+		running->reason = MACSIM_STOP_USER;
+}
+
+
+/* Función privada que vacía la cola de eventos */
+static void macsim_event_queue_clear(){
+	struct macsim_spill_record_t record;
+	struct macsim_event_t *event;
+	struct timing_wheel_node_t *node;
+
+	while(event_wheel && (node = timing_wheel_extract(event_wheel)))
+		free(node);
+	while(macsim_backend_count()){
+		macsim_backend_extract(&event);
+		free(event);
+	}
+	cancelled_count = 0;
+	macsim_backend_floor(0);
+	while(event_spill && ext_queue_count(event_spill)){
+		ext_queue_extract(event_spill, &record);
+		free(record.handle);
+	}
+	spill_cancelled = 0;
+	spill_time = LLONG_MAX;
+	spill_check = spill_limit;
+}
+
+
+/* Reproduce las llegadas de una carga grabada a partir del instante actual.
+ * Cada registro genera un evento de tipo \kind cuyo id de cliente es el índice del registro,
+ * con el que se puede consultar su demanda de servicio (macsim_workload_service).
+ * Solo se mantienen en la cola \window llegadas pendientes: cada vez que se extrae una
+ * se planifica la siguiente, así que la carga nunca se carga entera en memoria.
+ * Solo puede reproducirse una carga a la vez. */
+void macsim_replay(struct macsim_workload_t *workload, int kind, int window){
+	if(window < 1)
+		fatal("%s: window must be at least 1", __func__);
+
+	replay = workload;
+	replay_kind = kind;
+	replay_next = 0;
+	if(!macsim_workload_count(workload))
+		return;
+	replay_base = current_time - macsim_workload_arrival_ns(workload, 0);
+	while(window-- && replay_next < macsim_workload_count(workload))
+		macsim_replay_schedule();
+}
+
+
+/* Vuelve a asociar una carga tras macsim_restore, sin planificar nada:
+ * las llegadas pendientes y la posición en la carga vienen de la instantánea.
+ * Debe ser la misma carga que se estaba reproduciendo al hacer macsim_checkpoint. */
+void macsim_replay_resume(struct macsim_workload_t *workload){
+	replay = workload;
+}
+
+
+/* Función privada que planifica la siguiente llegada de la carga, si queda alguna */
+static void macsim_replay_schedule(){
+	long long time;
+
+	if(!replay || replay_next >= macsim_workload_count(replay))
+		return;
+	time = replay_base + macsim_workload_arrival_ns(replay, replay_next);
+	if(time < current_time)
+		fatal("%s: workload arrivals must be non-decreasing", __func__);
+	macsim_event_insert(replay_kind, replay_next, time, MACSIM_EVENT_REPLAY);
+	replay_next++;
 }
 
 
@@ -155,11 +1718,14 @@ struct macsim_station_t * macsim_station_create(char *name){
 		fatal("%s: out of memory", __func__);
 	
 	/* Crear cola de la estación */
-	station->clients = linked_list_create();
+	ilist_init(&station->clients);
 
 	/* Solo insertamos si la estación no existe ya */
-	if(!hash_table_get(stations, name)){
-		hash_table_insert(stations, name, station);
+	if(!string_map_get(stations, name)){
+		string_map_insert(stations, name, station);
+		station->id = next_station_id++;
+		if(binary_trace)
+			macsim_trace_push_station(binary_trace, station->id, station->name);
 		return station;
 	}
 	
@@ -172,7 +1738,7 @@ struct macsim_station_t * macsim_station_create(char *name){
  * La librería se encarga de la gestión de la memória.
  * @return MACSIM_UNKNOWN_STATION si la estación no existe y MACSIM_SUCCESS en caso contrario. */
 int macsim_station_delete(char *name){
-	struct macsim_station_t *station = (struct macsim_station_t *) hash_table_remove(stations, name);
+	struct macsim_station_t *station = (struct macsim_station_t *) string_map_remove(stations, name);
 	
 	if(!station) // La estación no existe
 		return MACSIM_UNKNOWN_STATION;
@@ -184,20 +1750,55 @@ int macsim_station_delete(char *name){
 
 /* Función privada para liberar la memória usada por una estación */
 static void macsim_station_destroy(struct macsim_station_t *station){
-	struct macsim_station_client_t *client;
-	LINKED_LIST_FOR_EACH(station->clients){
-		client = (struct macsim_station_client_t *) linked_list_get(station->clients);
-		free(client);
-	}
+	macsim_station_clear(station);
 	free(station->name);
 	free(station);
 }
 
 
+/* Función privada que vacía la cola de una estación */
+static void macsim_station_clear(struct macsim_station_t *station){
+	struct ilist_link_t *link;
+	while((link = ilist_pop_front(&station->clients)))
+		macsim_client_release(ILIST_ENTRY(link, struct macsim_station_client_t, link));
+	station->reschedule = 0;
+}
+
+
+/* Función privada que obtiene un cliente vacío, reutilizando uno liberado si lo hay */
+static struct macsim_station_client_t * macsim_client_alloc(){
+	struct macsim_station_client_t *client;
+	struct ilist_link_t *link;
+
+	link = ilist_pop_front(&client_pool);
+	if(link){
+		client = ILIST_ENTRY(link, struct macsim_station_client_t, link);
+		memset(client, 0, sizeof(struct macsim_station_client_t));
+		return client;
+	}
+	client = (struct macsim_station_client_t *) calloc(1, sizeof(struct macsim_station_client_t));
+	if(!client)
+		fatal("%s: out of memory", __func__);
+	return client;
+}
+
+
+/* Función privada que devuelve un cliente que ya no está en ninguna cola a la reserva */
+static void macsim_client_release(struct macsim_station_client_t *client){
+	ilist_push_front(&client_pool, &client->link);
+}
+
+
+/* Función privada que devuelve el primer cliente de la cola, que no debe estar vacía */
+static struct macsim_station_client_t * macsim_station_head(struct macsim_station_t *station){
+	return ILIST_ENTRY(ilist_first(&station->clients), struct macsim_station_client_t, link);
+}
+
+
 /* Devuelve, si existe, la estación con el nombre indicado
  * @return La estación o NULL si no existe */
 struct macsim_station_t * macsim_station_get(char *name){
-	return (struct macsim_station_t *) hash_table_get(stations, name);
+	return (struct macsim_station_t *) string_map_get(stations, name);
 }
 
 
@@ -211,14 +1812,14 @@ char * macsim_station_name(struct macsim_station_t *station){
 /* Devuelve el número de clientes en la cola de la estación
  * @return Número de clientes en cola */
 int macsim_station_queue_length(struct macsim_station_t *station){
-	return linked_list_count(station->clients);
+	return ilist_count(&station->clients);
 }
 
 
 /* Devuelve el número total de estaciones
  * @return El número de estaciones */
 int macsim_num_stations(){
-	return hash_table_count(stations);
+	return string_map_count(stations);
 }
 
 
@@ -226,6 +1827,7 @@ int macsim_num_stations(){
  * @return MACSIM_USING_STATION si la estación está vacía y el trabajo ha empezado a ejecutarse y MACSIM_WAITING_STATION si la estación está ocupada y el trabajo ha sido encolado */
 int macsim_station_request(struct macsim_station_t *station, long long client_id){
 	struct macsim_station_client_t *client;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_REQUEST);
 
 	/* Estación desconocida */
 	if(!station)
@@ -233,40 +1835,35 @@ int macsim_station_request(struct macsim_station_t *station, long long client_id
 
 	/* El cliente estaba esperando en la cola y es ya su turno */
 	if(station->reschedule){
-		linked_list_head(station->clients);
-		client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+		client = macsim_station_head(station);
 		if(client->id == client_id){ /* El reschedule es para nosotros? */
 			client->server_entry_time = current_time; //Estadísticas
 			station->reschedule = 0;
-			macsim_trace_msg(1, "El cliente %lld entra en la estación \"%s\", en la que estaba encolado", client->id, station->name);
-			return MACSIM_USING_STATION;
+			macsim_trace_event(MACSIM_TRACE_ENTER_QUEUED, station, client->id, 0, 0);
+			return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_USING_STATION);
 		}
 	}
 
 	/* Crear cliente */
-	client = (struct macsim_station_client_t *) calloc(1, sizeof(struct macsim_station_client_t));
-	if(!client)
-		fatal("%s: out of memory", __func__);	
+	client = macsim_client_alloc();
 	client->id = client_id;
 	client->event_kind = current_event;
 
 	/* Encolar cliente al final de la cola */
-	linked_list_add(station->clients, client);
-	if(station->clients->error_code) //Ha habido un error
-		fatal("%s: can't add client", __func__);
+	ilist_push_back(&station->clients, &client->link);
 
 	client->station_entry_time = current_time; //Estadísticas
 	
 	/* La estación tiene clientes en la cola */
-	if(linked_list_count(station->clients) > 1){
-		macsim_trace_msg(1, "El cliente %lld se encola en la estación \"%s\"", client->id, station->name);
-		return MACSIM_WAITING_STATION;
+	if(ilist_count(&station->clients) > 1){
+		macsim_trace_event(MACSIM_TRACE_QUEUE, station, client->id, 0, 0);
+		return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_WAITING_STATION);
 	}
 	
 	/* La estación está vacía así que el cliente entra en el servidor */
 	client->server_entry_time = current_time; //Estadísticas
-	macsim_trace_msg(1, "El cliente %lld entra en la estación \"%s\"", client->id, station->name);
-	return MACSIM_USING_STATION;
+	macsim_trace_event(MACSIM_TRACE_ENTER, station, client->id, 0, 0);
+	return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_USING_STATION);
 }
 
 
@@ -276,6 +1873,8 @@ int macsim_station_request(struct macsim_station_t *station, long long client_id
 int macsim_station_request2(char *name, long long client_id){
 	struct macsim_station_t *station = macsim_station_get(name);
 	struct macsim_station_client_t *client;
+	struct ilist_link_t *link;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_REQUEST);
 
 	/* Estación desconocida */
 	if(!station)
@@ -283,66 +1882,61 @@ int macsim_station_request2(char *name, long long client_id){
 
 	/* El cliente estaba esperando en la cola y es ya su turno */
 	if(station->reschedule){
-		linked_list_head(station->clients);
-		client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+		client = macsim_station_head(station);
 		if(client->id == client_id){ /* El reschedule es para nosotros? */
 			client->server_entry_time = current_time; //Estadísticas
 			station->reschedule = 0;
-			macsim_trace_msg(1, "El cliente %lld entra en la estación \"%s\", en la que estaba encolado", client->id, station->name);
-			return MACSIM_USING_STATION;
+			macsim_trace_event(MACSIM_TRACE_ENTER_QUEUED, station, client->id, 0, 0);
+			return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_USING_STATION);
 		}
 	}
 
 	/* El cliente ya está en la estación */
-	LINKED_LIST_FOR_EACH(station->clients){
-		client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+	ILIST_FOR_EACH(&station->clients, link){
+		client = ILIST_ENTRY(link, struct macsim_station_client_t, link);
 		if(client->id == client_id)
 			fatal("%s: client already in queue", __func__);	
 	}
 
 
 	/* Crear cliente */
-	client = (struct macsim_station_client_t *) calloc(1, sizeof(struct macsim_station_client_t));
-	if(!client)
-		fatal("%s: out of memory", __func__);	
+	client = macsim_client_alloc();
 	client->id = client_id;
 	client->event_kind = current_event;
 
 	/* Encolar cliente al final de la cola */
-	linked_list_add(station->clients, client);
-	if(station->clients->error_code) //Ha habido un error
-		fatal("%s: can't add client", __func__);
+	ilist_push_back(&station->clients, &client->link);
 
 	client->station_entry_time = current_time; //Estadísticas
 	
 	/* La estación tiene clientes en la cola */
-	if(linked_list_count(station->clients) > 1){
-		macsim_trace_msg(1, "El cliente %lld se encola en la estación \"%s\"", client->id, station->name);
-		return MACSIM_WAITING_STATION;
+	if(ilist_count(&station->clients) > 1){
+		macsim_trace_event(MACSIM_TRACE_QUEUE, station, client->id, 0, 0);
+		return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_WAITING_STATION);
 	}
 	
 	/* La estación está vacía así que el cliente entra en el servidor */
 	client->server_entry_time = current_time; //Estadísticas
-	macsim_trace_msg(1, "El cliente %lld entra en la estación \"%s\"", client->id, station->name);
-	return MACSIM_USING_STATION;
+	macsim_trace_event(MACSIM_TRACE_ENTER, station, client->id, 0, 0);
+	return MACSIM_PROBE_RETURN(MACSIM_PROBE_REQUEST, MACSIM_USING_STATION);
 }
 
 
 /* El cliente abandona la estación. */
-void macsim_station_leave(struct macsim_station_t *station, int client_id){
+void macsim_station_leave(struct macsim_station_t *station, long long client_id){
 	struct macsim_station_client_t *client, *next_client;
 	int queued_clients;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_LEAVE);
 
 	if(!station)
 		fatal("%s: unknown station", __func__);	
 
-	queued_clients = linked_list_count(station->clients);	
+	queued_clients = ilist_count(&station->clients);	
 	if(!queued_clients)
 		fatal("%s: empty station queue", __func__);
 	
-	linked_list_head(station->clients);
-	client = (struct macsim_station_client_t *) linked_list_get(station->clients);
-	linked_list_remove(station->clients);
+	client = macsim_station_head(station);
+	ilist_remove(&station->clients, &client->link);
 	
 	/* Comprobar que todo va bien */
 	if(client->id != client_id)
@@ -351,8 +1945,7 @@ void macsim_station_leave(struct macsim_station_t *station, int client_id){
 	/* Atender al siguiente cliente, si lo hay */
 	queued_clients--;
 	if(queued_clients){
-		linked_list_head(station->clients);
-		next_client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+		next_client = macsim_station_head(station);
 		macsim_schedule_ns(client->event_kind, next_client->id, 0);
 		station->reschedule = 1;
 	}
@@ -362,29 +1955,30 @@ void macsim_station_leave(struct macsim_station_t *station, int client_id){
 	station->total_response_time += current_time - client->station_entry_time;
 	station->total_service_time += current_time - client->server_entry_time;
 
-	macsim_trace_msg(1, "El cliente %lld sale de la estación \"%s\" tresp = %f tserv = %f", client->id, station->name, (current_time - client->station_entry_time) / 1000000.0, (current_time - client->server_entry_time) / 1000000.0);
+	macsim_trace_event(MACSIM_TRACE_LEAVE, station, client->id, current_time - client->station_entry_time, current_time - client->server_entry_time);
 
-	free(client);
+	macsim_client_release(client);
+	MACSIM_PROBE_END(MACSIM_PROBE_LEAVE);
 }
 
 
 /* El cliente abandona la estación.
  * Más lenta que macsim_station_leave. */
-void macsim_station_leave2(char* name, int client_id){
+void macsim_station_leave2(char* name, long long client_id){
 	struct macsim_station_t *station = macsim_station_get(name);
 	struct macsim_station_client_t *client, *next_client;
 	int queued_clients;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_LEAVE);
 
 	if(!station)
 		fatal("%s: unknown station", __func__);	
 
-	queued_clients = linked_list_count(station->clients);	
+	queued_clients = ilist_count(&station->clients);	
 	if(!queued_clients)
 		fatal("%s: empty station queue", __func__);
 	
-	linked_list_head(station->clients);
-	client = (struct macsim_station_client_t *) linked_list_get(station->clients);
-	linked_list_remove(station->clients);
+	client = macsim_station_head(station);
+	ilist_remove(&station->clients, &client->link);
 	
 	/* Comprobar que todo va bien */
 	if(client->id != client_id)
@@ -393,8 +1987,7 @@ void macsim_station_leave2(char* name, int client_id){
 	/* Atender al siguiente cliente, si lo hay */
 	queued_clients--;
 	if(queued_clients){
-		linked_list_head(station->clients);
-		next_client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+		next_client = macsim_station_head(station);
 		macsim_schedule_ns(client->event_kind, next_client->id, 0);
 		station->reschedule = 1;
 	}
@@ -404,16 +1997,22 @@ void macsim_station_leave2(char* name, int client_id){
 	station->total_response_time += current_time - client->station_entry_time;
 	station->total_service_time += current_time - client->server_entry_time;
 
-	macsim_trace_msg(1, "El cliente %lld sale de la estación \"%s\" tresp = %f tserv = %f", client->id, station->name, (current_time - client->station_entry_time) / 1000000.0, (current_time - client->server_entry_time) / 1000000.0);
+	macsim_trace_event(MACSIM_TRACE_LEAVE, station, client->id, current_time - client->station_entry_time, current_time - client->server_entry_time);
 
-	free(client);
+	macsim_client_release(client);
+	MACSIM_PROBE_END(MACSIM_PROBE_LEAVE);
 }
 
 
 /* Genera un número siguiendo una dist. exponencial con la media pasada como parámetro
  * @return Número generado siguiendo una dist. exponencial */
 double macsim_exponential(double mean){
-	return(-mean * log(macsim_random(0)));
+	double value;
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_RANDOM);
+
+	value = -mean * log(macsim_random(0));
+	MACSIM_PROBE_END(MACSIM_PROBE_RANDOM);
+	return value;
 }
 
 
@@ -421,12 +2020,15 @@ double macsim_exponential(double mean){
  * @return Número aleatorio entre a y b */
 double macsim_uniform(double a, double b){ 
 	double c; 
+	MACSIM_PROBE_BEGIN(MACSIM_PROBE_RANDOM);
 	if (a>b){
 		c = a;
 		a = b;
 		b = c;
 	}
-	return( a + (b-a) * macsim_random(0));
+	c = a + (b-a) * macsim_random(0);
+	MACSIM_PROBE_END(MACSIM_PROBE_RANDOM);
+	return c;
 }
 
 
@@ -434,9 +2036,10 @@ double macsim_uniform(double a, double b){
  * Útil para eliminar el transitorio. */
 void macsim_reset_statistics(){
 	char *key;
+	struct string_map_iter_t iter;
 	struct macsim_station_t *station;
 	
-	HASH_TABLE_FOR_EACH(stations, key, station){
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
 		station->total_clients = 0;
 		station->total_response_time = 0;
 		station->total_service_time = 0;
@@ -446,26 +2049,47 @@ void macsim_reset_statistics(){
 }
 
 
-/* Imprime estadísticas por la salida estandar */
-void macsim_report(){
+/* Rellena \results con los resultados de cada estación desde el último
+ * macsim_reset_statistics, en el orden en que las recorre macsim_report; los nombres son los de
+ * las estaciones. Rellena como mucho \size estaciones, así que con \size 0 solo se cuentan.
+ * @return El número de estaciones (macsim_num_stations) */
+int macsim_results(struct macsim_result_t *results, int size){
 	char *key;
-	double serv, resp, queue, thro, util=0;
+	struct string_map_iter_t iter;
 	struct macsim_station_t *station;
+	int k = 0;
+
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		if(k < size)
+			macsim_network_result(&results[k], station->name, station->total_clients, station->total_response_time,
+				station->total_service_time, current_time - last_reset_time);
+		k++;
+	}
+	return k;
+}
+
+
+/* Imprime estadísticas por la salida estandar */
+void macsim_report(){
+	struct macsim_result_t *results;
+	int k, count = macsim_num_stations();
+
+	results = (struct macsim_result_t *) malloc((count ? count : 1) * sizeof(struct macsim_result_t));
+	if(!results)
+		fatal("%s: out of memory", __func__);
+	macsim_results(results, count);
 
 	printf("\n");
 	printf("RESULTADOS DE LA SIMULACIÓN\n");
-	HASH_TABLE_FOR_EACH(stations, key, station){
-		serv = station->total_service_time / station->total_clients;
-		resp = station->total_response_time / station->total_clients;
-		queue = resp - serv;
-		thro = station->total_clients / (double) (current_time - last_reset_time) * 1000000;
-		util = thro / (1000000.0/serv);
+	for(k = 0; k < count; k++){
 		printf("\n");
-		printf("ESTACION: %s\n", station->name);
+		printf("ESTACION: %s\n", results[k].name);
 		printf("Tiempo de servicio    Tiempo de respuesta   Tiempo en cola        Total clientes        Productividad         Utilización\n");
-		printf("%-20.4f  %-20.4f  %-20.4f  %-20lld  %-20.4f  %-20.4f\n", serv/1000000.0, resp/1000000.0, queue/1000000.0, station->total_clients, thro, util);
+		printf("%-20.4f  %-20.4f  %-20.4f  %-20lld  %-20.4f  %-20.4f\n", results[k].service_time, results[k].response_time,
+			results[k].queue_time, results[k].total_clients, results[k].throughput, results[k].utilization);
 		printf("\n");
 	}
+	free(results);
 }
 
 
@@ -499,18 +2123,358 @@ void macsim_print_(int level, const char *fmt, ...){
 }
 
 
+/* Registra un suceso de la librería en la traza.
+ * Con la traza binaria activa solo se copia un registro de tamaño fijo en el buffer circular;
+ * en otro caso se imprime el mensaje de siempre por la salida de error. */
+static void macsim_trace_event_(int op, struct macsim_station_t *station, long long client_id, long long response_time, long long service_time){
+	struct macsim_trace_record_t record;
+	char msg[1024];
+
+	record.time = current_time;
+	record.client = client_id;
+	record.response_time = response_time;
+	record.service_time = service_time;
+	record.kind = current_event;
+	record.station = station->id;
+	record.op = op;
+	record.reserved = 0;
+
+	if(binary_trace){
+		macsim_trace_push(binary_trace, &record);
+		return;
+	}
+
+	macsim_trace_format(msg, sizeof(msg), &record, station->name);
+	fprintf(stderr, "%f %s\n", macsim_time(), msg);
+	fflush(NULL);
+}
+
+
 /* Activa o desactiva la traza */
 void macsim_trace(int value){
 	trace = value;
 }
 
 
+/* Envía los sucesos de la librería a un fichero de traza binaria en lugar de a la salida de error.
+ * La escritura la hace un hilo aparte; el fichero se lee con la herramienta macsim-trace. */
+void macsim_trace_binary(const char *path){
+	char *key;
+	struct string_map_iter_t iter;
+	struct macsim_station_t *station;
+
+	macsim_trace_binary_close();
+	binary_trace = macsim_trace_open(path);
+	if(!binary_trace)
+		fatal("%s: can't open trace file \"%s\"", __func__, path);
+
+	/* Estaciones creadas antes de activar la traza */
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		macsim_trace_push_station(binary_trace, station->id, station->name);
+	}
+}
+
+
+/* Vacía y cierra la traza binaria, si la hay. La traza vuelve a ser textual. */
+void macsim_trace_binary_close(){
+	if(!binary_trace)
+		return;
+	macsim_trace_close(binary_trace);
+	binary_trace = NULL;
+}
+
+
 void macsim_station_print(char* name){
 	struct macsim_station_t *station = macsim_station_get(name);
 	struct macsim_station_client_t *client;
-	LINKED_LIST_FOR_EACH(station->clients){
-		client = (struct macsim_station_client_t *) linked_list_get(station->clients);
+	struct ilist_link_t *link;
+	ILIST_FOR_EACH(&station->clients, link){
+		client = ILIST_ENTRY(link, struct macsim_station_client_t, link);
 		printf("%lld ", client->id);
 	}
 	printf("\n");
 }
+
+
+/* Función privada que escribe un bloque en la instantánea */
+static void macsim_checkpoint_write(FILE *f, const void *data, size_t size){
+	if(size && fwrite(data, size, 1, f) != 1)
+		fatal("macsim_checkpoint: can't write checkpoint file");
+}
+
+
+/* Guarda el estado completo de la simulación en \path: reloj, cola de eventos,
+ * estaciones con sus colas y estadísticas, y el estado de los streams aleatorios.
+ * Se escribe primero un fichero temporal que se renombra al final, así que una caída
+ * durante la escritura no estropea la instantánea anterior. */
+void macsim_checkpoint(const char *path){
+	struct macsim_checkpoint_header_t header;
+	struct macsim_checkpoint_event_t *events;
+	struct macsim_checkpoint_station_t record;
+	struct macsim_checkpoint_client_t client_record;
+	struct macsim_station_client_t *client;
+	struct macsim_station_t *station;
+	struct macsim_event_t **event_data;
+	long long name_offset, stream, *times;
+	char *key, *tmp_path;
+	struct string_map_iter_t iter;
+	struct ilist_link_t *link;
+	static const char pad[8];
+	FILE *f;
+	int i;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MACSIM_CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = MACSIM_CHECKPOINT_VERSION;
+	header.current_event = current_event;
+	header.current_time = current_time;
+	header.last_reset_time = last_reset_time;
+	header.next_station_id = next_station_id;
+	header.replay_next = replay_next;
+	header.replay_base = replay_base;
+	header.replay_kind = replay_kind;
+
+	/* Los eventos se sacan en orden y se vuelven a insertar en el mismo orden,
+	 * lo que conserva el desempate FIFO */
+	header.event_count = macsim_queue_count();
+	events = (struct macsim_checkpoint_event_t *) calloc(header.event_count + 1, sizeof(struct macsim_checkpoint_event_t));
+	event_data = (struct macsim_event_t **) calloc(header.event_count + 1, sizeof(struct macsim_event_t *));
+	times = (long long *) malloc((header.event_count + 1) * sizeof(long long));
+	if(!events || !event_data || !times)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < header.event_count; i++){
+		events[i].time = macsim_queue_extract(&event_data[i]);
+		events[i].client = event_data[i]->client;
+		events[i].kind = event_data[i]->kind;
+		events[i].flags = event_data[i]->flags;
+	}
+	for(i = 0; i < header.event_count; i++)
+		times[i] = events[i].time;
+	macsim_queue_insert_bulk(times, event_data, header.event_count);
+	free(event_data);
+	free(times);
+
+	/* Tamaños de cada zona */
+	header.station_count = string_map_count(stations);
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		header.client_count += ilist_count(&station->clients);
+		header.names_size += strlen(station->name) + 1;
+	}
+	header.events_offset = sizeof(header);
+	header.stations_offset = header.events_offset + header.event_count * sizeof(struct macsim_checkpoint_event_t);
+	header.clients_offset = header.stations_offset + header.station_count * sizeof(struct macsim_checkpoint_station_t);
+	header.streams_offset = header.clients_offset + header.client_count * sizeof(struct macsim_checkpoint_client_t);
+	header.names_offset = header.streams_offset + MACSIM_STREAMS * sizeof(long long);
+
+	tmp_path = (char *) malloc(strlen(path) + 5);
+	if(!tmp_path)
+		fatal("%s: out of memory", __func__);
+	sprintf(tmp_path, "%s.tmp", path);
+	f = fopen(tmp_path, "wb");
+	if(!f)
+		fatal("%s: can't create \"%s\"", __func__, tmp_path);
+
+	macsim_checkpoint_write(f, &header, sizeof(header));
+	macsim_checkpoint_write(f, events, header.event_count * sizeof(struct macsim_checkpoint_event_t));
+	free(events);
+
+	/* Estaciones */
+	name_offset = 0;
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		memset(&record, 0, sizeof(record));
+		record.total_service_time = station->total_service_time;
+		record.total_response_time = station->total_response_time;
+		record.total_clients = station->total_clients;
+		record.name_offset = name_offset;
+		record.id = station->id;
+		record.reschedule = station->reschedule;
+		record.client_count = ilist_count(&station->clients);
+		macsim_checkpoint_write(f, &record, sizeof(record));
+		name_offset += strlen(station->name) + 1;
+	}
+
+	/* Clientes, en el mismo orden de estaciones */
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		ILIST_FOR_EACH(&station->clients, link){
+			client = ILIST_ENTRY(link, struct macsim_station_client_t, link);
+			memset(&client_record, 0, sizeof(client_record));
+			client_record.id = client->id;
+			client_record.station_entry_time = client->station_entry_time;
+			client_record.server_entry_time = client->server_entry_time;
+			client_record.event_kind = client->event_kind;
+			macsim_checkpoint_write(f, &client_record, sizeof(client_record));
+		}
+	}
+
+	/* Streams aleatorios */
+	for(i = 0; i < MACSIM_STREAMS; i++){
+		stream = macsim_stream_value(i);
+		macsim_checkpoint_write(f, &stream, sizeof(stream));
+	}
+
+	/* Nombres */
+	STRING_MAP_ITER_FOR_EACH(stations, iter, key, station){
+		macsim_checkpoint_write(f, station->name, strlen(station->name) + 1);
+	}
+	macsim_checkpoint_write(f, pad, (8 - header.names_size % 8) % 8);
+
+	if(fclose(f))
+		fatal("%s: can't write \"%s\"", __func__, tmp_path);
+	if(rename(tmp_path, path))
+		fatal("%s: can't rename \"%s\" to \"%s\"", __func__, tmp_path, path);
+	free(tmp_path);
+}
+
+
+/* Función privada que comprueba que una zona de \count registros de \record_size bytes en la
+ * posición \offset de una instantánea de \size bytes está entera dentro del fichero, tras la
+ * cabecera. Como en macsim_workload_open, se acota la posición antes de restar y se divide en
+ * lugar de multiplicar, para que un fichero corrupto no desborde ninguna cuenta.
+ * @return 1 si la zona cabe, 0 si no */
+static int macsim_checkpoint_section(long long offset, long long count, size_t record_size, size_t size){
+	return offset >= (long long) sizeof(struct macsim_checkpoint_header_t) && (unsigned long long) offset <= size &&
+		offset % 8 == 0 && count >= 0 && (size - offset) / record_size >= (unsigned long long) count;
+}
+
+
+/* Recupera el estado guardado con macsim_checkpoint. La librería debe estar inicializada.
+ * El estado actual se descarta: las estaciones con el mismo nombre que alguna de la instantánea
+ * se reutilizan (los punteros que tenga el usuario siguen siendo válidos), las demás se eliminan.
+ * La instantánea se proyecta en memoria y no se modifica, así que puede restaurarse
+ * tantas veces como se quiera para lanzar variantes a partir del mismo estado.
+ * Si se estaba reproduciendo una carga hay que asociarla después con macsim_replay_resume. */
+void macsim_restore(const char *path){
+	const struct macsim_checkpoint_header_t *header;
+	const struct macsim_checkpoint_event_t *events;
+	const struct macsim_checkpoint_station_t *records;
+	const struct macsim_checkpoint_client_t *client_records;
+	const long long *streams;
+	const char *names;
+	struct string_map_t *kept;
+	struct macsim_station_t *station;
+	struct macsim_station_client_t *client;
+	struct macsim_event_t *event, **event_data;
+	char *key, **doomed;
+	long long *times;
+	struct stat st;
+	size_t size;
+	void *map;
+	long long i, j, c, ndoomed;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+		fatal("%s: can't open \"%s\"", __func__, path);
+	if(fstat(fd, &st))
+		fatal("%s: can't stat \"%s\"", __func__, path);
+	size = st.st_size;
+	if(size < sizeof(struct macsim_checkpoint_header_t))
+		fatal("%s: \"%s\" is not a checkpoint", __func__, path);
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		fatal("%s: can't map \"%s\"", __func__, path);
+
+	header = (const struct macsim_checkpoint_header_t *) map;
+	if(memcmp(header->magic, MACSIM_CHECKPOINT_MAGIC, sizeof(header->magic)) || header->version != MACSIM_CHECKPOINT_VERSION)
+		fatal("%s: \"%s\" is not a checkpoint", __func__, path);
+
+	/* Comprobar todas las zonas antes de tocar las estaciones o la cola de eventos, de modo que
+	 * un fichero truncado o corrupto acaba en fatal sin haber cambiado nada */
+	if(!macsim_checkpoint_section(header->events_offset, header->event_count, sizeof(struct macsim_checkpoint_event_t), size) ||
+			!macsim_checkpoint_section(header->stations_offset, header->station_count, sizeof(struct macsim_checkpoint_station_t), size) ||
+			!macsim_checkpoint_section(header->clients_offset, header->client_count, sizeof(struct macsim_checkpoint_client_t), size) ||
+			!macsim_checkpoint_section(header->streams_offset, MACSIM_STREAMS, sizeof(long long), size) ||
+			!macsim_checkpoint_section(header->names_offset, header->names_size, 1, size))
+		fatal("%s: \"%s\" is truncated", __func__, path);
+	events = (const struct macsim_checkpoint_event_t *) ((const char *) map + header->events_offset);
+	records = (const struct macsim_checkpoint_station_t *) ((const char *) map + header->stations_offset);
+	client_records = (const struct macsim_checkpoint_client_t *) ((const char *) map + header->clients_offset);
+	streams = (const long long *) ((const char *) map + header->streams_offset);
+	names = (const char *) map + header->names_offset;
+
+	/* Cada nombre empieza dentro de la zona de nombres, que acaba en un 0, y los clientes de
+	 * las estaciones suman los de la cabecera */
+	if(header->station_count && (!header->names_size || names[header->names_size - 1]))
+		fatal("%s: \"%s\" is corrupt", __func__, path);
+	for(i = 0, c = 0; i < header->station_count; i++){
+		if(records[i].name_offset < 0 || records[i].name_offset >= header->names_size || records[i].client_count < 0)
+			fatal("%s: \"%s\" is corrupt", __func__, path);
+		c += records[i].client_count;
+	}
+	if(c != header->client_count)
+		fatal("%s: \"%s\" is corrupt", __func__, path);
+
+	/* Eliminar las estaciones que no están en la instantánea */
+	kept = string_map_create(header->station_count, 1);
+	for(i = 0; i < header->station_count; i++)
+		string_map_insert(kept, (char *) names + records[i].name_offset, (void *) records);
+	doomed = (char **) calloc(string_map_count(stations) + 1, sizeof(char *));
+	if(!doomed)
+		fatal("%s: out of memory", __func__);
+	ndoomed = 0;
+	STRING_MAP_FOR_EACH(stations, key, station){
+		if(!string_map_get(kept, key))
+			doomed[ndoomed++] = station->name;
+	}
+	for(i = 0; i < ndoomed; i++)
+		macsim_station_delete(doomed[i]);
+	free(doomed);
+	string_map_free(kept);
+
+	/* Estaciones y sus colas */
+	for(i = 0, c = 0; i < header->station_count; i++){
+		station = macsim_station_get((char *) names + records[i].name_offset);
+		if(!station)
+			station = macsim_station_create((char *) names + records[i].name_offset);
+		macsim_station_clear(station);
+		station->id = records[i].id;
+		if(binary_trace)
+			macsim_trace_push_station(binary_trace, station->id, station->name);
+		station->reschedule = records[i].reschedule;
+		station->total_service_time = records[i].total_service_time;
+		station->total_response_time = records[i].total_response_time;
+		station->total_clients = records[i].total_clients;
+		for(j = 0; j < records[i].client_count; j++, c++){
+			client = macsim_client_alloc();
+			client->id = client_records[c].id;
+			client->station_entry_time = client_records[c].station_entry_time;
+			client->server_entry_time = client_records[c].server_entry_time;
+			client->event_kind = client_records[c].event_kind;
+			ilist_push_back(&station->clients, &client->link);
+		}
+	}
+
+	/* Cola de eventos, en el orden de extracción original y de una vez */
+	macsim_event_queue_clear();
+	event_data = (struct macsim_event_t **) malloc((header->event_count + 1) * sizeof(struct macsim_event_t *));
+	times = (long long *) malloc((header->event_count + 1) * sizeof(long long));
+	if(!event_data || !times)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < header->event_count; i++){
+		event = (struct macsim_event_t *) calloc(1, sizeof(struct macsim_event_t));
+		if(!event)
+			fatal("%s: out of memory", __func__);
+		event->client = events[i].client;
+		event->kind = events[i].kind;
+		event->flags = events[i].flags & MACSIM_EVENT_REPLAY; //Los temporizadores no sobreviven a la instantánea
+		event_data[i] = event;
+		times[i] = events[i].time;
+	}
+	macsim_queue_insert_bulk(times, event_data, header->event_count);
+	free(event_data);
+	free(times);
+
+	/* Reloj, streams y reproducción de carga */
+	current_time = header->current_time;
+	last_reset_time = header->last_reset_time;
+	current_event = header->current_event;
+	next_station_id = header->next_station_id;
+	for(i = 0; i < MACSIM_STREAMS; i++)
+		macsim_seed(streams[i], i);
+	replay_next = header->replay_next;
+	replay_base = header->replay_base;
+	replay_kind = header->replay_kind;
+
+	munmap(map, size);
+}
@@ -13,6 +13,10 @@
 #  define macsim_print(...); 
 #endif
 
+/* Con MACSIM_PROFILE definida al compilar la librería (make PROFILE=1) se cuentan los eventos de
+ * cada tipo, se miden en ciclos las operaciones del bucle de eventos y se sigue la longitud de
+ * la cola (macsim_profile). Sin ella la instrumentación no genera código. */
+
 #define MACSIM_UNKNOWN_STATION 0
 #define MACSIM_SUCCESS 1
 #define MACSIM_WAITING_STATION 2
@@ -21,22 +25,128 @@
 /* Estructuras */
 struct macsim_station_t{
 	char *name; //Nombre de la estación
+	int id; //Identificador numérico, usado en la traza binaria
 	int reschedule : 1; //Marca de replanificación
-	struct linked_list_t *clients; //Lista de clientes en la estación
+	struct ilist_t clients; //Cola de clientes en la estación (intrusiva, ver macsim_station_client_t)
 	long long total_service_time; //Suma de los tiempos de servicio
 	long long total_response_time; //Suma de los tiempos de respuesta
 	long long total_clients; //Núm. clientes que han pasado por la estación
 };
 
+/* Resultados de una estación, en las unidades de macsim_report */
+struct macsim_result_t{
+	const char *name; //Nombre de la estación
+	double service_time; //Tiempo medio de servicio en ms
+	double response_time; //Tiempo medio de respuesta en ms
+	double queue_time; //Tiempo medio en cola en ms
+	long long total_clients; //Clientes que han pasado por la estación (0 en los modelos analíticos)
+	double mean_clients; //Número medio de clientes en la estación
+	double throughput; //Productividad en clientes/ms
+	double utilization; //Utilización
+};
+
+/* Implementaciones de la cola de eventos (macsim_queue_backend) */
+enum macsim_queue_enum {
+	MACSIM_QUEUE_HEAP = 0, //Montículo binario (heap.h)
+	MACSIM_QUEUE_RADIX, //Radix heap (radix-heap.h): el tiempo de la simulación nunca retrocede
+	MACSIM_QUEUE_AUTO //La librería elige implementación y rueda, y las cambia según la carga
+};
+
+#define MACSIM_QUEUE_DISTANCES 64
+
+/* Instrumentación de la cola de eventos (macsim_queue_stats), desde macsim_init o macsim_reset */
+struct macsim_queue_stats_t {
+	long long events; //Eventos extraídos
+	long long pending; //Eventos pendientes ahora
+	long long max_pending; //Máximo de eventos pendientes tras una extracción
+	double mean_pending; //Media de eventos pendientes tras cada extracción
+	long long distance[MACSIM_QUEUE_DISTANCES]; //Eventos planificados a [2^(i-1), 2^i) ns del instante actual; distance[0], a 0 ns
+	int backend; //Implementación en uso (enum macsim_queue_enum, nunca MACSIM_QUEUE_AUTO)
+	double wheel_ms; //Horizonte de la rueda en uso, 0 sin rueda
+	int migrations; //Cambios de implementación o rueda hechos por MACSIM_QUEUE_AUTO
+};
+
+/* Fila de la instrumentación de MACSIM_PROFILE (macsim_profile) */
+struct macsim_profile_entry_t {
+	const char *metric; //"clock", "probe", "kind" o "depth"
+	char name[32]; //Reloj, operación medida o tipo de evento
+	double time; //depth: instante de la simulación en ms
+	long long count; //probe: llamadas; kind: eventos; depth: eventos extraídos hasta time
+	double value; //clock: ciclos por µs; probe y kind: ciclos medios; depth: eventos pendientes
+};
+
+/* Motivos por los que termina macsim_run */
+enum macsim_stop_enum {
+	MACSIM_STOP_NONE = 0, //Sigue en marcha
+	MACSIM_STOP_EMPTY, //No quedan eventos
+	MACSIM_STOP_HORIZON, //El siguiente evento es posterior a horizon_ms
+	MACSIM_STOP_EVENTS, //Se han procesado max_events eventos
+	MACSIM_STOP_PRECISION, //Las observaciones de macsim_observe alcanzan la precisión
+	MACSIM_STOP_USER //Un manejador ha llamado a macsim_stop
+};
+
+/* Manejador de un tipo de evento para macsim_run */
+typedef void (*macsim_handler_t)(long long client_id, void *data);
+
+/* Bucle de eventos de macsim_run y MACSIM_RUN_FOR_EACH.
+ * Los criterios de parada valen 0 si no se usan y termina el primero que se cumpla. */
+struct macsim_run_t {
+	double horizon_ms; //Instante de la simulación en que se para
+	long long max_events; //Eventos que se procesan
+	double precision; //Semiintervalo relativo buscado en las observaciones de macsim_observe (batch means)
+	double confidence; //Nivel de confianza del intervalo (0.95 si es 0)
+	long transient; //Observaciones del transitorio, que se descartan
+	long batch; //Observaciones por lote (1000 si es 0)
+	int quiet; //No imprimir los eventos por segundo al terminar
+
+	/* Resultados */
+	int reason; //enum macsim_stop_enum
+	long long events; //Eventos procesados
+	double seconds; //Tiempo real
+	double events_per_second;
+	double mean, half_width; //Media y semiintervalo de las observaciones
+	int batches; //Lotes completados
+};
+
+struct macsim_workload_t;
+struct macsim_event_t;
+
+/* Macros */
+/* Bucle de eventos sin manejadores: el cuerpo se ejecuta para cada evento, normalmente con un
+ * switch sobre \kind, hasta que se cumpla algún criterio de parada de \run */
+#define MACSIM_RUN_FOR_EACH(run, kind, client_id) \
+	for(macsim_run_begin(run); macsim_run_next((run), &(kind), &(client_id)); )
+
 /* Prototipos */
 void macsim_init();
 void macsim_exit();
+void macsim_reset();
+void macsim_queue_backend(int backend);
+void macsim_queue_wheel(double horizon_ms);
+void macsim_queue_spill(double memory_mb, const char *dir);
+void macsim_queue_stats(struct macsim_queue_stats_t *stats);
+int macsim_profile(struct macsim_profile_entry_t *entries, int size);
+void macsim_monitor(const char *name, double period_s);
 long long macsim_time_ns();
 double macsim_time();
 long long macsim_get_last_reset_time();
 void macsim_schedule(int kind, long long client_id, double ms);
 void macsim_schedule_ns(int kind, long long client_id, long long ns);
+void macsim_schedule_bulk(int kind, const long long *client_ids, const double *ms, int count);
+void macsim_schedule_bulk_ns(int kind, const long long *client_ids, const long long *ns, int count);
+void macsim_reserve(int events);
+struct macsim_event_t * macsim_timeout(int kind, long long client_id, double ms);
+void macsim_cancel(struct macsim_event_t *event);
 void macsim_extract(int *kind, long long *client_id);
+int macsim_extract_all(int *kinds, long long *client_ids, int size);
+void macsim_set_current_event(int kind);
+void macsim_run(struct macsim_run_t *run, macsim_handler_t *handlers, int count, void *data);
+void macsim_run_begin(struct macsim_run_t *run);
+int macsim_run_next(struct macsim_run_t *run, int *kind, long long *client_id);
+void macsim_observe(double value);
+void macsim_stop();
+void macsim_replay(struct macsim_workload_t *workload, int kind, int window);
+void macsim_replay_resume(struct macsim_workload_t *workload);
 struct macsim_station_t * macsim_station_create(char *name);
 int macsim_station_delete(char *name);
 struct macsim_station_t * macsim_station_get(char *name);
@@ -45,15 +155,20 @@ int macsim_stations_count();
 int macsim_station_queue_length(struct macsim_station_t *station);
 int macsim_station_request(struct macsim_station_t *station, long long client_id);
 int macsim_station_request2(char *name, long long client_id);
-void macsim_station_leave(struct macsim_station_t *station, int client_id);
-void macsim_station_leave2(char* name, int client_id);
+void macsim_station_leave(struct macsim_station_t *station, long long client_id);
+void macsim_station_leave2(char* name, long long client_id);
 double macsim_exponential(double mean);
 double macsim_uniform(double a, double b); 
 void macsim_reset_statistics();
+int macsim_results(struct macsim_result_t *results, int size);
 void macsim_report();
 void macsim_trace(int value);
+void macsim_trace_binary(const char *path);
+void macsim_trace_binary_close();
 void macsim_station_print(char* name);
 void macsim_print_(int level, const char *fmt, ...);
+void macsim_checkpoint(const char *path);
+void macsim_restore(const char *path);
 void macsim_trace_msg_(int level, const char *fmt, ...);
    
 #endif /* MACSIM_H */
@@ -0,0 +1,652 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "model.h"
+#include "macsim.h"
+#include "debug.h"
+
+/* Formato de los ficheros de modelo (INI). Los comentarios empiezan por '#' o ';'.
+ *
+ *   [model]
+ *   engine = sequential | parallel | optimistic | closed
+ *   threads = 4
+ *   horizon = 100000                     ; ms simulados
+ *   seed = 1
+ *   trace = 0                            ; nivel de traza del motor secuencial
+ *   queue = heap | radix | auto          ; cola de eventos del motor secuencial (auto: la elige la librería)
+ *   wheel = 10                           ; ms que cubre la rueda de tiempos delante de la cola (0: sin rueda)
+ *   memory = 1024                        ; MB para la cola; los eventos lejanos pasan a disco (0: sin límite)
+ *   spill = /var/tmp                     ; directorio de los ficheros de la cola ($TMPDIR o /tmp)
+ *
+ *   [station cpu]
+ *   discipline = fcfs | delay            ; delay: servidores infinitos (tiempo de reflexión)
+ *   servers = 1                          ; 1 en las FCFS, inf en las de retardo
+ *   service = exponential 1.0            ; constant a, exponential a, uniform a b, shifted_exponential a b
+ *   arrivals = exponential 2.0           ; llegadas externas (none por defecto)
+ *   population = 10                      ; clientes iniciales de la clase 0
+ *   route = disk 0.5, think 0.5          ; lo que falta hasta 1 abandona la red
+ *
+ *   [class batch]                        ; clase adicional (red cerrada)
+ *   population.cpu = 5
+ *   route.cpu = disk 1
+ *   reference = cpu                      ; estación en la que se mide el tiempo de ciclo
+ *
+ * Las estaciones se numeran por orden de aparición. Cualquier asignación se puede cambiar
+ * después con macsim_model_set usando claves con puntos: model.horizon, station.cpu.service,
+ * class.batch.route.cpu... */
+
+#define MODEL_LINE_SIZE 4096
+
+static const char *engine_names[] = {"sequential", "parallel", "optimistic", "closed", NULL};
+static const char *queue_names[] = {"heap", "radix", "auto", NULL};
+
+
+/* Funciones */
+/* Función privada que termina con un mensaje de error que indica el origen de la asignación */
+static void macsim_model_error(struct macsim_model_t *model, struct macsim_model_entry_t *entry, const char *fmt, ...) __attribute__ ((noreturn, format (printf, 3, 4)));
+static void macsim_model_error(struct macsim_model_t *model, struct macsim_model_entry_t *entry, const char *fmt, ...){
+	char msg[512];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	if(entry && entry->line)
+		fatal("%s:%d: %s", model->path, entry->line, msg);
+	if(entry)
+		fatal("%s: [%s] %s: %s", model->path, entry->section, entry->key, msg);
+	fatal("%s: %s", model->path, msg);
+}
+
+
+/* Función privada que quita los espacios del principio y del final */
+static char * macsim_model_trim(char *s){
+	char *end;
+
+	while(isspace((unsigned char) *s))
+		s++;
+	end = s + strlen(s);
+	while(end > s && isspace((unsigned char) end[-1]))
+		end--;
+	*end = 0;
+	return s;
+}
+
+
+/* Función privada que duplica una cadena */
+static char * macsim_model_strdup(const char *s){
+	char *copy = strdup(s);
+	if(!copy)
+		fatal("%s: out of memory", __func__);
+	return copy;
+}
+
+
+/* Función privada que da valor a una clave de una sección, sustituyendo el anterior si lo había */
+static void macsim_model_entry_set(struct macsim_model_t *model, const char *section, const char *key, const char *value, int line){
+	struct macsim_model_entry_t *entry;
+	int i;
+
+	/* El modelo compilado deja de valer */
+	if(model->net){
+		macsim_network_free(model->net);
+		model->net = NULL;
+	}
+
+	for(i = 0; i < model->entry_count; i++){
+		entry = &model->entries[i];
+		if(!strcmp(entry->section, section) && !strcmp(entry->key, key)){
+			free(entry->value);
+			entry->value = macsim_model_strdup(value);
+			entry->line = line;
+			return;
+		}
+	}
+
+	if(model->entry_count == model->entry_size){
+		model->entry_size = model->entry_size ? model->entry_size * 2 : 32;
+		model->entries = (struct macsim_model_entry_t *) realloc(model->entries, model->entry_size * sizeof(struct macsim_model_entry_t));
+		if(!model->entries)
+			fatal("%s: out of memory", __func__);
+	}
+	entry = &model->entries[model->entry_count++];
+	entry->section = macsim_model_strdup(section);
+	entry->key = macsim_model_strdup(key);
+	entry->value = macsim_model_strdup(value);
+	entry->line = line;
+}
+
+
+/* Función privada que normaliza el nombre de una sección ("station  cpu" -> "station cpu")
+ * @return 0 si el tipo de sección no existe o le falta el nombre */
+static int macsim_model_section(const char *text, char *section, size_t size){
+	char type[64], name[256], extra[2];
+	int n = sscanf(text, "%63s %255s %1s", type, name, extra);
+
+	if(n == 1 && !strcmp(type, "model")){
+		snprintf(section, size, "model");
+		return 1;
+	}
+	if(n == 2 && (!strcmp(type, "station") || !strcmp(type, "class"))){
+		snprintf(section, size, "%s %s", type, name);
+		return 1;
+	}
+	return 0;
+}
+
+
+/* Carga un modelo de un fichero. Los errores de formato terminan el programa indicando la línea.
+ * @return El modelo, sin compilar, o NULL si no se puede abrir el fichero */
+struct macsim_model_t * macsim_model_load(const char *path){
+	struct macsim_model_t *model;
+	char line[MODEL_LINE_SIZE], section[320] = "", *text, *eq, *c;
+	int number = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if(!f)
+		return NULL;
+	model = (struct macsim_model_t *) calloc(1, sizeof(struct macsim_model_t));
+	if(!model)
+		fatal("%s: out of memory", __func__);
+	model->path = macsim_model_strdup(path);
+
+	while(fgets(line, sizeof(line), f)){
+		number++;
+		if(!strchr(line, '\n') && !feof(f))
+			fatal("%s:%d: line too long", path, number);
+		for(c = line; *c; c++){
+			if(*c == '#' || *c == ';'){
+				*c = 0;
+				break;
+			}
+		}
+		text = macsim_model_trim(line);
+		if(!*text)
+			continue;
+
+		/* Sección */
+		if(*text == '['){
+			c = strchr(text, ']');
+			if(!c || c[1])
+				fatal("%s:%d: expected \"[section]\"", path, number);
+			*c = 0;
+			if(!macsim_model_section(text + 1, section, sizeof(section)))
+				fatal("%s:%d: unknown section \"%s\"", path, number, text + 1);
+			continue;
+		}
+
+		/* Asignación */
+		eq = strchr(text, '=');
+		if(!eq)
+			fatal("%s:%d: expected \"key = value\"", path, number);
+		if(!*section)
+			fatal("%s:%d: assignment outside a section", path, number);
+		*eq = 0;
+		macsim_model_entry_set(model, section, macsim_model_trim(text), macsim_model_trim(eq + 1), number);
+	}
+
+	fclose(f);
+	return model;
+}
+
+
+/* Copia las asignaciones de un modelo, sin la red compilada, para cambiarlas o simularlo
+ * desde otro hilo sin tocar el original */
+struct macsim_model_t * macsim_model_copy(struct macsim_model_t *model){
+	struct macsim_model_t *copy;
+	int i;
+
+	copy = (struct macsim_model_t *) calloc(1, sizeof(struct macsim_model_t));
+	if(!copy)
+		fatal("%s: out of memory", __func__);
+	copy->path = macsim_model_strdup(model->path);
+	for(i = 0; i < model->entry_count; i++)
+		macsim_model_entry_set(copy, model->entries[i].section, model->entries[i].key, model->entries[i].value, model->entries[i].line);
+	return copy;
+}
+
+
+/* Libera el modelo y la red compilada */
+void macsim_model_free(struct macsim_model_t *model){
+	int i;
+
+	for(i = 0; i < model->entry_count; i++){
+		free(model->entries[i].section);
+		free(model->entries[i].key);
+		free(model->entries[i].value);
+	}
+	if(model->net)
+		macsim_network_free(model->net);
+	free(model->entries);
+	free(model->path);
+	free(model);
+}
+
+
+/* Función privada que separa una clave con puntos en sección y clave:
+ * model.horizon, station.cpu.service, class.batch.route.cpu
+ * @return 0 si la clave no tiene ese formato */
+static int macsim_model_split(const char *dotted, char *section, size_t size, const char **key){
+	const char *dot, *name;
+
+	if(!strncmp(dotted, "model.", 6)){
+		snprintf(section, size, "model");
+		*key = dotted + 6;
+		return **key != 0;
+	}
+	if(!strncmp(dotted, "station.", 8))
+		name = dotted + 8;
+	else if(!strncmp(dotted, "class.", 6))
+		name = dotted + 6;
+	else
+		return 0;
+	dot = strchr(name, '.');
+	if(!dot || dot == name || !dot[1])
+		return 0;
+	snprintf(section, size, "%.*s %.*s", (int) (name - dotted - 1), dotted, (int) (dot - name), name);
+	*key = dot + 1;
+	return 1;
+}
+
+
+/* Cambia el valor de una clave con puntos (station.cpu.service, model.horizon...).
+ * El modelo se vuelve a compilar en el siguiente macsim_model_compile o macsim_model_run. */
+void macsim_model_set(struct macsim_model_t *model, const char *key, const char *value){
+	char section[320];
+	const char *k;
+
+	if(!macsim_model_split(key, section, sizeof(section), &k))
+		macsim_model_error(model, NULL, "invalid key \"%s\"", key);
+	macsim_model_entry_set(model, section, k, value, 0);
+}
+
+
+/* Como macsim_model_set, con la asignación en la forma clave=valor */
+void macsim_model_override(struct macsim_model_t *model, const char *assignment){
+	char key[512], *value;
+
+	snprintf(key, sizeof(key), "%s", assignment);
+	value = strchr(key, '=');
+	if(!value)
+		macsim_model_error(model, NULL, "expected key=value, got \"%s\"", assignment);
+	*value++ = 0;
+	macsim_model_set(model, macsim_model_trim(key), macsim_model_trim(value));
+}
+
+
+/* Devuelve el valor de una clave con puntos, o NULL si no tiene */
+const char * macsim_model_get(struct macsim_model_t *model, const char *key){
+	char section[320];
+	const char *k;
+	int i;
+
+	if(!macsim_model_split(key, section, sizeof(section), &k))
+		return NULL;
+	for(i = 0; i < model->entry_count; i++){
+		if(!strcmp(model->entries[i].section, section) && !strcmp(model->entries[i].key, k))
+			return model->entries[i].value;
+	}
+	return NULL;
+}
+
+
+/* Función privada que lee un número real */
+static double macsim_model_number(struct macsim_model_t *model, struct macsim_model_entry_t *entry, const char *text){
+	char *end;
+	double value = strtod(text, &end);
+	if(end == text || *macsim_model_trim(end))
+		macsim_model_error(model, entry, "expected a number, got \"%s\"", text);
+	return value;
+}
+
+
+/* Función privada que lee un entero no negativo */
+static int macsim_model_integer(struct macsim_model_t *model, struct macsim_model_entry_t *entry, const char *text){
+	char *end;
+	long value = strtol(text, &end, 10);
+	if(end == text || *macsim_model_trim(end) || value < 0 || value > 0x7fffffff)
+		macsim_model_error(model, entry, "expected a non-negative integer, got \"%s\"", text);
+	return (int) value;
+}
+
+
+/* Función privada que lee una distribución: nombre y parámetros */
+static void macsim_model_dist(struct macsim_model_t *model, struct macsim_model_entry_t *entry, int *type, double *a, double *b){
+	char name[64];
+	int n, params;
+
+	*a = *b = 0;
+	n = sscanf(entry->value, "%63s %lf %lf", name, a, b);
+	if(n < 1)
+		macsim_model_error(model, entry, "expected a distribution");
+	if(!strcmp(name, "none")){
+		*type = MACSIM_DIST_NONE;
+		params = 0;
+	}
+	else if(!strcmp(name, "constant")){
+		*type = MACSIM_DIST_CONSTANT;
+		params = 1;
+	}
+	else if(!strcmp(name, "exponential")){
+		*type = MACSIM_DIST_EXPONENTIAL;
+		params = 1;
+	}
+	else if(!strcmp(name, "uniform")){
+		*type = MACSIM_DIST_UNIFORM;
+		params = 2;
+	}
+	else if(!strcmp(name, "shifted_exponential")){
+		*type = MACSIM_DIST_SHIFTED_EXPONENTIAL;
+		params = 2;
+	}
+	else
+		macsim_model_error(model, entry, "unknown distribution \"%s\"", name);
+	if(n != params + 1)
+		macsim_model_error(model, entry, "distribution \"%s\" takes %d parameters", name, params);
+
+	/* Los mismos límites que macsim_network_service, pero con la línea del fichero */
+	if(params == 1 && *a <= 0)
+		macsim_model_error(model, entry, "the mean must be positive");
+	if(params == 2 && (*a < 0 || *b <= *a))
+		macsim_model_error(model, entry, "invalid parameters %g, %g", *a, *b);
+}
+
+
+/* Función privada que busca una estación por nombre en la red */
+static int macsim_model_station(struct macsim_model_t *model, struct macsim_model_entry_t *entry, struct macsim_network_t *net, const char *name){
+	int k;
+	for(k = 0; k < net->count; k++){
+		if(!strcmp(net->stations[k].name, name))
+			return k;
+	}
+	macsim_model_error(model, entry, "unknown station \"%s\"", name);
+}
+
+
+/* Función privada que devuelve la suma de las probabilidades de las rutas que ya tiene la
+ * estación \from en la clase \cls */
+static double macsim_model_route_sum(struct macsim_network_t *net, int cls, int from){
+	double sum = 0;
+	int r;
+
+	if(!cls){
+		for(r = 0; r < net->stations[from].route_count; r++)
+			sum += net->stations[from].routes[r].prob;
+		return sum;
+	}
+	for(r = 0; r < net->classes[cls].route_count; r++){
+		if(net->classes[cls].routes[r].from == from)
+			sum += net->classes[cls].routes[r].prob;
+	}
+	return sum;
+}
+
+
+/* Función privada que lee una lista de rutas "destino prob, destino prob..." y la añade
+ * a la estación \from de la clase \cls. Las probabilidades se comprueban aquí, con las que ya
+ * tenía la estación, para que el error indique la línea y no lo dé macsim_network_class_route */
+static void macsim_model_routes(struct macsim_model_t *model, struct macsim_model_entry_t *entry, struct macsim_network_t *net, int cls, int from){
+	char *list = macsim_model_strdup(entry->value), *to, *prob, *save = NULL;
+	double p, sum = macsim_model_route_sum(net, cls, from);
+	int k;
+
+	for(to = strtok_r(list, " \t,", &save); to; to = strtok_r(NULL, " \t,", &save)){
+		prob = strtok_r(NULL, " \t,", &save);
+		if(!prob)
+			macsim_model_error(model, entry, "station \"%s\" without probability", to);
+		k = macsim_model_station(model, entry, net, to);
+		p = macsim_model_number(model, entry, prob);
+		if(p < 0 || p > 1)
+			macsim_model_error(model, entry, "invalid probability %g", p);
+		sum += p;
+		if(sum > 1 + 1e-9)
+			macsim_model_error(model, entry, "routing probabilities of \"%s\" add up to %g", net->stations[from].name, sum);
+		macsim_network_class_route(net, cls, from, k, p);
+	}
+	free(list);
+}
+
+
+/* Función privada que aplica una asignación de una sección [station] */
+static void macsim_model_compile_station(struct macsim_model_t *model, struct macsim_model_entry_t *entry, struct macsim_network_t *net, int k){
+	struct macsim_network_station_t *s = &net->stations[k];
+	double a, b;
+	int type;
+
+	if(!strcmp(entry->key, "service") || !strcmp(entry->key, "arrivals")){
+		macsim_model_dist(model, entry, &type, &a, &b);
+		if(entry->key[0] == 's'){
+			if(type == MACSIM_DIST_NONE)
+				macsim_model_error(model, entry, "a station needs a service time");
+			macsim_network_service(net, k, type, a, b);
+		}
+		else
+			macsim_network_arrivals(net, k, type, a, b);
+	}
+	else if(!strcmp(entry->key, "discipline")){
+		if(!strcmp(entry->value, "fcfs"))
+			s->delay = 0;
+		else if(!strcmp(entry->value, "delay"))
+			s->delay = 1;
+		else
+			macsim_model_error(model, entry, "unknown discipline \"%s\" (fcfs or delay)", entry->value);
+	}
+	else if(!strcmp(entry->key, "servers")){
+		if(!strcmp(entry->value, "inf"))
+			s->delay = 1;
+		else if(macsim_model_integer(model, entry, entry->value) == 1)
+			s->delay = 0;
+		else
+			macsim_model_error(model, entry, "only single-server FCFS and infinite-server stations are supported");
+	}
+	else if(!strcmp(entry->key, "population"))
+		macsim_network_population(net, k, macsim_model_integer(model, entry, entry->value));
+	else if(!strcmp(entry->key, "route"))
+		macsim_model_routes(model, entry, net, 0, k);
+	else
+		macsim_model_error(model, entry, "unknown station key \"%s\"", entry->key);
+}
+
+
+/* Función privada que aplica una asignación de una sección [class] */
+static void macsim_model_compile_class(struct macsim_model_t *model, struct macsim_model_entry_t *entry, struct macsim_network_t *net, const char *name){
+	int cls;
+
+	for(cls = 0; cls < net->class_count && strcmp(net->classes[cls].name, name); cls++);
+	if(cls == net->class_count)
+		macsim_network_class_create(net, name);
+
+	if(!strcmp(entry->key, "reference"))
+		macsim_network_class_reference(net, cls, macsim_model_station(model, entry, net, entry->value));
+	else if(!strncmp(entry->key, "population.", 11))
+		macsim_network_class_population(net, cls, macsim_model_station(model, entry, net, entry->key + 11),
+			macsim_model_integer(model, entry, entry->value));
+	else if(!strncmp(entry->key, "route.", 6))
+		macsim_model_routes(model, entry, net, cls, macsim_model_station(model, entry, net, entry->key + 6));
+	else
+		macsim_model_error(model, entry, "unknown class key \"%s\"", entry->key);
+}
+
+
+/* Función privada que aplica una asignación de la sección [model] */
+static void macsim_model_compile_model(struct macsim_model_t *model, struct macsim_model_entry_t *entry, struct macsim_network_t *net){
+	int i;
+
+	if(!strcmp(entry->key, "horizon")){
+		model->horizon_ms = macsim_model_number(model, entry, entry->value);
+		if(model->horizon_ms <= 0)
+			macsim_model_error(model, entry, "the horizon must be positive");
+	}
+	else if(!strcmp(entry->key, "seed"))
+		macsim_network_seed(net, macsim_model_integer(model, entry, entry->value));
+	else if(!strcmp(entry->key, "threads"))
+		model->threads = macsim_model_integer(model, entry, entry->value);
+	else if(!strcmp(entry->key, "trace"))
+		macsim_model_integer(model, entry, entry->value);
+	else if(!strcmp(entry->key, "spill")){ //Se lee al simular
+		if(!*entry->value)
+			macsim_model_error(model, entry, "the spill directory can't be empty");
+	}
+	else if(!strcmp(entry->key, "memory")){
+		model->memory_mb = macsim_model_number(model, entry, entry->value);
+		if(model->memory_mb < 0)
+			macsim_model_error(model, entry, "the memory can't be negative");
+	}
+	else if(!strcmp(entry->key, "engine")){
+		for(i = 0; engine_names[i] && strcmp(engine_names[i], entry->value); i++);
+		if(!engine_names[i])
+			macsim_model_error(model, entry, "unknown engine \"%s\"", entry->value);
+		model->engine = i;
+	}
+	else if(!strcmp(entry->key, "queue")){
+		for(i = 0; queue_names[i] && strcmp(queue_names[i], entry->value); i++);
+		if(!queue_names[i])
+			macsim_model_error(model, entry, "unknown event queue \"%s\"", entry->value);
+		model->queue = i;
+	}
+	else if(!strcmp(entry->key, "wheel")){
+		model->wheel_ms = macsim_model_number(model, entry, entry->value);
+		if(model->wheel_ms < 0)
+			macsim_model_error(model, entry, "the wheel horizon can't be negative");
+	}
+	else
+		macsim_model_error(model, entry, "unknown model key \"%s\"", entry->key);
+}
+
+
+/* Función privada que comprueba que el motor elegido puede simular la red, como hacen
+ * macsim_network_check_simple y macsim_network_run_closed, pero señalando la asignación que
+ * lo impide: estaciones de retardo y clases con clientes solo con el motor closed, y llegadas
+ * externas solo con los demás */
+static void macsim_model_check_engine(struct macsim_model_t *model, struct macsim_network_t *net){
+	struct macsim_model_entry_t *entry;
+	int i, k, cls, closed = model->engine == MACSIM_ENGINE_CLOSED;
+
+	for(i = 0; i < model->entry_count; i++){
+		entry = &model->entries[i];
+		if(!strncmp(entry->section, "station ", 8)){
+			k = macsim_model_station(model, entry, net, entry->section + 8);
+			if(!closed && net->stations[k].delay && (!strcmp(entry->key, "discipline") || !strcmp(entry->key, "servers")) &&
+					(!strcmp(entry->value, "delay") || !strcmp(entry->value, "inf")))
+				macsim_model_error(model, entry, "delay stations need engine = closed");
+			if(closed && net->stations[k].arrivals.type != MACSIM_DIST_NONE && !strcmp(entry->key, "arrivals"))
+				macsim_model_error(model, entry, "external arrivals need an open-network engine");
+		}
+		else if(!closed && !strncmp(entry->section, "class ", 6) && !strncmp(entry->key, "population.", 11)){
+			for(cls = 0; strcmp(net->classes[cls].name, entry->section + 6); cls++);
+			if(cls && macsim_model_integer(model, entry, entry->value))
+				macsim_model_error(model, entry, "classes with customers need engine = closed");
+		}
+	}
+}
+
+
+/* Traduce las asignaciones del modelo a una red. Las cadenas solo se miran aquí: la red
+ * resultante usa índices de estación y la simulan los motores sin buscar nombres.
+ * @return La red, que pertenece al modelo y vale hasta que se cambie alguna asignación */
+struct macsim_network_t * macsim_model_compile(struct macsim_model_t *model){
+	struct macsim_model_entry_t *entry;
+	struct macsim_network_t *net;
+	const char **names;
+	int i, k, count = 0;
+
+	if(model->net)
+		return model->net;
+
+	/* Estaciones, por orden de aparición */
+	names = (const char **) malloc((model->entry_count + 1) * sizeof(const char *));
+	if(!names)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < model->entry_count; i++){
+		if(strncmp(model->entries[i].section, "station ", 8))
+			continue;
+		for(k = 0; k < count && strcmp(names[k], model->entries[i].section + 8); k++);
+		if(k == count)
+			names[count++] = model->entries[i].section + 8;
+	}
+	if(!count)
+		macsim_model_error(model, NULL, "the model has no stations");
+	net = macsim_network_create(count);
+	for(k = 0; k < count; k++)
+		macsim_network_name(net, k, names[k]);
+	free(names);
+
+	/* Valores por defecto y asignaciones, en orden */
+	model->horizon_ms = 1000;
+	model->engine = MACSIM_ENGINE_SEQUENTIAL;
+	model->threads = 1;
+	model->queue = MACSIM_QUEUE_HEAP;
+	model->wheel_ms = 0;
+	model->memory_mb = 0;
+	for(i = 0; i < model->entry_count; i++){
+		entry = &model->entries[i];
+		if(!strcmp(entry->section, "model"))
+			macsim_model_compile_model(model, entry, net);
+		else if(!strncmp(entry->section, "station ", 8))
+			macsim_model_compile_station(model, entry, net, macsim_model_station(model, entry, net, entry->section + 8));
+		else
+			macsim_model_compile_class(model, entry, net, entry->section + 6);
+	}
+	macsim_model_check_engine(model, net);
+
+	model->net = net;
+	return net;
+}
+
+
+/* Simula el modelo ya compilado con su motor, sin inicializar ni liberar la librería:
+ * con el motor sequential debe estar inicializada y vacía (macsim_init o macsim_reset).
+ * Los nombres de los resultados pertenecen al modelo.
+ * @return Eventos procesados (closed), eventos deshechos (optimistic) o 0 */
+long long macsim_model_simulate(struct macsim_model_t *model, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results){
+	struct macsim_network_t *net = macsim_model_compile(model);
+	const char *trace = macsim_model_get(model, "model.trace");
+	long long ret = 0;
+	int k;
+
+	switch(model->engine){
+	case MACSIM_ENGINE_SEQUENTIAL:
+		macsim_trace(trace ? atoi(trace) : 0);
+		macsim_queue_backend(model->queue);
+		macsim_queue_wheel(model->wheel_ms);
+		macsim_queue_spill(model->memory_mb, macsim_model_get(model, "model.spill"));
+		macsim_network_run(net, model->horizon_ms, results);
+		break;
+	case MACSIM_ENGINE_PARALLEL:
+		macsim_network_run_parallel(net, model->horizon_ms, model->threads, results);
+		break;
+	case MACSIM_ENGINE_OPTIMISTIC:
+		ret = macsim_network_run_optimistic(net, model->horizon_ms, model->threads, results);
+		break;
+	case MACSIM_ENGINE_CLOSED:
+		ret = macsim_network_run_closed(net, model->horizon_ms, results, class_results);
+		break;
+	}
+
+	/* Los nombres de la librería dejan de existir con macsim_exit */
+	for(k = 0; k < net->count; k++)
+		results[k].name = net->stations[k].name;
+	return ret;
+}
+
+
+/* Simula el modelo con el motor y el horizonte que indica.
+ * \results debe tener sitio para todas las estaciones y \class_results (si no es NULL) para todas
+ * las clases; este último solo se rellena con el motor closed. Los nombres de los resultados
+ * pertenecen al modelo.
+ * Con el motor sequential la librería se inicializa y se libera aquí, así que no debe estar en uso.
+ * @return Eventos procesados (closed), eventos deshechos (optimistic) o 0 */
+long long macsim_model_run(struct macsim_model_t *model, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results){
+	long long ret;
+
+	macsim_model_compile(model);
+	if(model->engine != MACSIM_ENGINE_SEQUENTIAL)
+		return macsim_model_simulate(model, results, class_results);
+	macsim_init();
+	ret = macsim_model_simulate(model, results, class_results);
+	macsim_exit();
+	return ret;
+}
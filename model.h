@@ -0,0 +1,53 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "network.h"
+
+/* Motores con los que se puede simular un modelo */
+enum macsim_model_engine_enum {
+	MACSIM_ENGINE_SEQUENTIAL = 0, //macsim_network_run
+	MACSIM_ENGINE_PARALLEL, //macsim_network_run_parallel
+	MACSIM_ENGINE_OPTIMISTIC, //macsim_network_run_optimistic
+	MACSIM_ENGINE_CLOSED //macsim_network_run_closed
+};
+
+/* Estructuras */
+/* Asignación clave = valor de una sección del fichero */
+struct macsim_model_entry_t {
+	char *section; //"model", "station <nombre>" o "class <nombre>"
+	char *key;
+	char *value;
+	int line; //Línea del fichero (0 si se ha cambiado con macsim_model_set)
+};
+
+/* Modelo descrito en un fichero de texto (formato INI).
+ * Las asignaciones se guardan tal cual y macsim_model_compile las traduce a una red
+ * (macsim_network_t) indexada por número de estación, que es lo que simulan los motores;
+ * así se pueden cambiar parámetros y volver a compilar sin tocar código. */
+struct macsim_model_t {
+	char *path;
+	struct macsim_model_entry_t *entries;
+	int entry_count, entry_size;
+
+	/* Modelo compilado */
+	struct macsim_network_t *net; //NULL si no está compilado o ha cambiado
+	double horizon_ms; //Criterio de parada: tiempo simulado
+	int engine; //enum macsim_model_engine_enum
+	int threads; //Hilos de los motores paralelos
+	int queue; //Cola de eventos del motor secuencial (enum macsim_queue_enum)
+	double wheel_ms; //Horizonte de la rueda de tiempos del motor secuencial, 0 sin rueda
+	double memory_mb; //Memoria de la cola de eventos del motor secuencial, 0 sin límite
+};
+
+/* Prototipos */
+struct macsim_model_t * macsim_model_load(const char *path);
+struct macsim_model_t * macsim_model_copy(struct macsim_model_t *model);
+void macsim_model_free(struct macsim_model_t *model);
+void macsim_model_set(struct macsim_model_t *model, const char *key, const char *value);
+void macsim_model_override(struct macsim_model_t *model, const char *assignment);
+const char * macsim_model_get(struct macsim_model_t *model, const char *key);
+struct macsim_network_t * macsim_model_compile(struct macsim_model_t *model);
+long long macsim_model_run(struct macsim_model_t *model, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results);
+long long macsim_model_simulate(struct macsim_model_t *model, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results);
+
+#endif /* MODEL_H */
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "monitor.h"
+#include "debug.h"
+
+#define MACSIM_MONITOR_RETRIES 1000 //Intentos de macsim_monitor_read antes de rendirse
+
+/* Estadísticas en vivo en memoria compartida (POSIX shm_open).
+ *
+ * El segmento tiene tamaño fijo y lo crea la simulación, que lo actualiza de vez en cuando
+ * (macsim_monitor en macsim.h); cualquier proceso de la máquina puede abrirlo por su nombre y
+ * leerlo sin coordinarse con ella, como hace tools/macsim-top. Los nombres son los de
+ * shm_open: si no empiezan por '/' se les añade. */
+
+
+/* Funciones */
+/* Función privada que devuelve el nombre de shm_open correspondiente a \name, que se libera con free */
+static char * macsim_monitor_path(const char *name){
+	char *path = (char *) malloc(strlen(name) + 2);
+
+	if(!path)
+		fatal("%s: out of memory", __func__);
+	sprintf(path, "%s%s", name[0] == '/' ? "" : "/", name);
+	return path;
+}
+
+
+/* Función privada que abre el segmento \path que ya existía para reutilizarlo. Solo se reutiliza
+ * si lo dejó una simulación que ya no existe (o si quedó vacío al crearlo); si el proceso que lo
+ * creó sigue vivo el nombre está en uso y es un error.
+ * @return El descriptor o -1 si no se puede abrir */
+static int macsim_monitor_reuse(const char *path, const char *name){
+	struct macsim_monitor_segment_t *segment;
+	struct stat st;
+	int fd, pid;
+
+	fd = shm_open(path, O_RDWR, 0);
+	if(fd < 0)
+		return -1;
+	if(fstat(fd, &st)){
+		close(fd);
+		return -1;
+	}
+	if(!st.st_size)
+		return fd;
+	if(st.st_size != sizeof(struct macsim_monitor_segment_t))
+		fatal("%s: \"%s\" exists and is not a macsim segment", __func__, name);
+	segment = (struct macsim_monitor_segment_t *) mmap(NULL, sizeof(struct macsim_monitor_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+	if(segment == MAP_FAILED){
+		close(fd);
+		return -1;
+	}
+	if(memcmp(segment->magic, MACSIM_MONITOR_MAGIC, sizeof(segment->magic)))
+		fatal("%s: \"%s\" exists and is not a macsim segment", __func__, name);
+	pid = segment->pid;
+	munmap(segment, sizeof(struct macsim_monitor_segment_t));
+	if(pid > 0 && (!kill(pid, 0) || errno != ESRCH))
+		fatal("%s: \"%s\" is in use by process %d", __func__, name, pid);
+	return fd;
+}
+
+
+/* Crea el segmento \name y lo deja vacío y en estado MACSIM_MONITOR_RUNNING. Si ya existe solo se
+ * reutiliza cuando el proceso que lo publicaba ha terminado; si sigue vivo se termina con fatal,
+ * para que dos simulaciones no compartan segmento ni se borren el nombre la una a la otra.
+ * @return El segmento o NULL si no se puede crear */
+struct macsim_monitor_segment_t * macsim_monitor_create(const char *name){
+	struct macsim_monitor_segment_t *segment;
+	char *path = macsim_monitor_path(name);
+	int fd;
+
+	fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0 && errno == EEXIST)
+		fd = macsim_monitor_reuse(path, name);
+	free(path);
+	if(fd < 0)
+		return NULL;
+	if(ftruncate(fd, sizeof(struct macsim_monitor_segment_t))){
+		close(fd);
+		return NULL;
+	}
+	segment = (struct macsim_monitor_segment_t *) mmap(NULL, sizeof(struct macsim_monitor_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(segment == MAP_FAILED)
+		return NULL;
+
+	/* Un escritor que se cayera a mitad de una actualización deja seq impar: se vuelve a empezar
+	 * desde 0 para que los lectores vean seq impar solo hasta que el segmento está listo */
+	atomic_store_explicit(&segment->seq, 0, memory_order_relaxed);
+	macsim_monitor_write_begin(segment);
+	memset((char *) segment + offsetof(struct macsim_monitor_segment_t, state), 0,
+		sizeof(struct macsim_monitor_segment_t) - offsetof(struct macsim_monitor_segment_t, state));
+	memcpy(segment->magic, MACSIM_MONITOR_MAGIC, sizeof(segment->magic));
+	segment->version = MACSIM_MONITOR_VERSION;
+	segment->segment_size = sizeof(struct macsim_monitor_segment_t);
+	segment->pid = getpid();
+	macsim_monitor_write_end(segment);
+	return segment;
+}
+
+
+/* Suelta el segmento y borra su nombre; los lectores que lo tengan abierto lo siguen viendo
+ * tal como quedó */
+void macsim_monitor_destroy(struct macsim_monitor_segment_t *segment, const char *name){
+	char *path = macsim_monitor_path(name);
+
+	munmap(segment, sizeof(struct macsim_monitor_segment_t));
+	shm_unlink(path);
+	free(path);
+}
+
+
+/* Empieza una actualización: hasta macsim_monitor_write_end los lectores descartan lo que copien */
+void macsim_monitor_write_begin(struct macsim_monitor_segment_t *segment){
+	unsigned seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+
+	atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+
+/* Termina una actualización */
+void macsim_monitor_write_end(struct macsim_monitor_segment_t *segment){
+	unsigned seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+
+	atomic_store_explicit(&segment->seq, seq + 1, memory_order_release);
+}
+
+
+/* Abre para lectura el segmento \name que ha creado una simulación
+ * @return El segmento o NULL si no existe o no es un segmento de macsim */
+const struct macsim_monitor_segment_t * macsim_monitor_attach(const char *name){
+	struct macsim_monitor_segment_t *segment;
+	char *path = macsim_monitor_path(name);
+	struct stat st;
+	int fd;
+
+	fd = shm_open(path, O_RDONLY, 0);
+	free(path);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) || st.st_size != sizeof(struct macsim_monitor_segment_t)){
+		close(fd);
+		return NULL;
+	}
+	segment = (struct macsim_monitor_segment_t *) mmap(NULL, sizeof(struct macsim_monitor_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(segment == MAP_FAILED)
+		return NULL;
+	if(memcmp(segment->magic, MACSIM_MONITOR_MAGIC, sizeof(segment->magic)) || segment->version != MACSIM_MONITOR_VERSION ||
+			segment->segment_size != sizeof(struct macsim_monitor_segment_t)){
+		munmap(segment, sizeof(struct macsim_monitor_segment_t));
+		return NULL;
+	}
+	return segment;
+}
+
+
+/* Cierra un segmento abierto con macsim_monitor_attach */
+void macsim_monitor_detach(const struct macsim_monitor_segment_t *segment){
+	munmap((void *) segment, sizeof(struct macsim_monitor_segment_t));
+}
+
+
+/* Copia el segmento en \copy. Si la simulación lo está actualizando se vuelve a intentar, sin
+ * esperarla; una actualización dura microsegundos, así que en la práctica basta con pocos intentos.
+ * @return 1 si la copia es coherente, 0 si tras MACSIM_MONITOR_RETRIES intentos no lo es */
+int macsim_monitor_read(const struct macsim_monitor_segment_t *segment, struct macsim_monitor_segment_t *copy){
+	struct macsim_monitor_segment_t *shared = (struct macsim_monitor_segment_t *) segment;
+	unsigned before, after;
+	int i;
+
+	for(i = 0; i < MACSIM_MONITOR_RETRIES; i++){
+		before = atomic_load_explicit(&shared->seq, memory_order_acquire);
+		if(before & 1)
+			continue;
+		memcpy(copy, segment, sizeof(struct macsim_monitor_segment_t));
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&shared->seq, memory_order_relaxed);
+		if(before == after)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdatomic.h>
+
+#define MACSIM_MONITOR_MAGIC "MACSIMMN"
+#define MACSIM_MONITOR_VERSION 1
+#define MACSIM_MONITOR_NAME 48 //Bytes del nombre de la estación (se trunca)
+#define MACSIM_MONITOR_STATIONS 256 //Estaciones que caben en el segmento; las demás solo se cuentan
+
+/* Estados de la simulación publicados en el segmento */
+enum macsim_monitor_state_enum {
+	MACSIM_MONITOR_RUNNING = 0,
+	MACSIM_MONITOR_FINISHED //macsim_exit o macsim_monitor(NULL, 0): el segmento ya no cambia
+};
+
+/* Estadísticas de una estación, en las unidades de macsim_report */
+struct macsim_monitor_station_t {
+	char name[MACSIM_MONITOR_NAME]; //Terminado en 0
+	long long total_clients;
+	long long queue_length; //Clientes en la estación, en cola o en servicio
+	double service_time; //ms
+	double response_time; //ms
+	double queue_time; //ms
+	double throughput; //Clientes/ms
+	double utilization;
+};
+
+/* Segmento de memoria compartida con las estadísticas en vivo de una simulación.
+ * La simulación es el único escritor y lo protege con un seqlock: \seq es impar mientras
+ * escribe, y un lector que copie el segmento y vea el mismo \seq par antes y después tiene
+ * una copia coherente (macsim_monitor_read). Los lectores no escriben nada en el segmento, así
+ * que por muchos que haya nunca hacen esperar a la simulación. */
+struct macsim_monitor_segment_t {
+	char magic[8]; //MACSIM_MONITOR_MAGIC
+	int version; //MACSIM_MONITOR_VERSION
+	int segment_size; //sizeof(struct macsim_monitor_segment_t)
+	int pid; //Proceso que simula
+	atomic_uint seq;
+
+	/* Protegido por seq */
+	int state; //enum macsim_monitor_state_enum
+	long long updates; //Veces que se ha publicado
+	double wall_seconds; //Tiempo real desde que se creó el segmento
+	double time_ms; //Instante de la simulación
+	long long events; //Eventos extraídos desde macsim_init o macsim_reset
+	double events_per_second; //En el último periodo de publicación
+	long long pending; //Eventos en la cola
+	int batches; //Lotes de batch means completados por el bucle de macsim_run en marcha
+	double precision; //Semiintervalo relativo buscado, 0 si el bucle no usa batch means
+	double mean, half_width; //Estimación con los lotes completados (a partir de 10 lotes)
+	int station_count; //Estaciones de la simulación; solo las MACSIM_MONITOR_STATIONS primeras están en stations
+	struct macsim_monitor_station_t stations[MACSIM_MONITOR_STATIONS];
+};
+
+/* Prototipos */
+struct macsim_monitor_segment_t * macsim_monitor_create(const char *name);
+void macsim_monitor_destroy(struct macsim_monitor_segment_t *segment, const char *name);
+void macsim_monitor_write_begin(struct macsim_monitor_segment_t *segment);
+void macsim_monitor_write_end(struct macsim_monitor_segment_t *segment);
+const struct macsim_monitor_segment_t * macsim_monitor_attach(const char *name);
+void macsim_monitor_detach(const struct macsim_monitor_segment_t *segment);
+int macsim_monitor_read(const struct macsim_monitor_segment_t *segment, struct macsim_monitor_segment_t *copy);
+
+#endif /* MONITOR_H */
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "network.h"
+#include "random.h"
+#include "debug.h"
+
+/* Tipos de evento del motor secuencial */
+#define NETWORK_ARRIVE(k) (3 * (k)) //Llegada a la estación k
+#define NETWORK_DEPART(k) (3 * (k) + 1) //Fin de servicio en la estación k
+#define NETWORK_SOURCE(k) (3 * (k) + 2) //Llegada externa a la estación k
+
+#define NETWORK_MODULO 2147483647 //Módulo del generador de random.c
+
+
+/* Funciones */
+/* Crea una red con \stations estaciones sin servicio definido, sin rutas y sin clientes.
+ * Las estaciones se llaman s0, s1... mientras no se les dé nombre. */
+struct macsim_network_t * macsim_network_create(int stations){
+	struct macsim_network_t *net;
+	char name[32];
+	int k;
+
+	if(stations < 1)
+		fatal("%s: a network needs at least one station", __func__);
+	net = (struct macsim_network_t *) calloc(1, sizeof(struct macsim_network_t));
+	if(!net)
+		fatal("%s: out of memory", __func__);
+	net->stations = (struct macsim_network_station_t *) calloc(stations, sizeof(struct macsim_network_station_t));
+	if(!net->stations)
+		fatal("%s: out of memory", __func__);
+	net->count = stations;
+	net->seed = 1;
+	for(k = 0; k < stations; k++){
+		snprintf(name, sizeof(name), "s%d", k);
+		macsim_network_name(net, k, name);
+		net->stations[k].service.type = MACSIM_DIST_EXPONENTIAL;
+		net->stations[k].service.a = 1.0;
+	}
+	macsim_network_class_create(net, NULL);
+	return net;
+}
+
+
+/* Libera la red */
+void macsim_network_free(struct macsim_network_t *net){
+	int k;
+	for(k = 0; k < net->count; k++){
+		free(net->stations[k].name);
+		free(net->stations[k].routes);
+	}
+	for(k = 0; k < net->class_count; k++){
+		free(net->classes[k].name);
+		free(net->classes[k].population);
+		free(net->classes[k].routes);
+	}
+	free(net->classes);
+	free(net->stations);
+	free(net);
+}
+
+
+/* Función privada que comprueba el índice de una estación */
+static struct macsim_network_station_t * macsim_network_station(struct macsim_network_t *net, int station, const char *func){
+	if(station < 0 || station >= net->count)
+		fatal("%s: unknown station %d", func, station);
+	return &net->stations[station];
+}
+
+
+/* Función privada que comprueba los parámetros de una distribución */
+static void macsim_dist_set(struct macsim_dist_t *d, int type, double a, double b, const char *func){
+	switch(type){
+	case MACSIM_DIST_NONE:
+		break;
+	case MACSIM_DIST_CONSTANT:
+	case MACSIM_DIST_EXPONENTIAL:
+		if(a <= 0)
+			fatal("%s: the mean must be positive", func);
+		break;
+	case MACSIM_DIST_UNIFORM:
+	case MACSIM_DIST_SHIFTED_EXPONENTIAL:
+		if(a < 0 || b <= a)
+			fatal("%s: invalid parameters %f, %f", func, a, b);
+		break;
+	default:
+		fatal("%s: unknown distribution %d", func, type);
+	}
+	d->type = type;
+	d->a = a;
+	d->b = b;
+}
+
+
+/* Da nombre a una estación; será el nombre de la estación de la simulación */
+void macsim_network_name(struct macsim_network_t *net, int station, const char *name){
+	struct macsim_network_station_t *s = macsim_network_station(net, station, __func__);
+	free(s->name);
+	s->name = strdup(name);
+	if(!s->name)
+		fatal("%s: out of memory", __func__);
+}
+
+
+/* Distribución del tiempo de servicio de una estación (exponencial de media 1 ms por defecto) */
+void macsim_network_service(struct macsim_network_t *net, int station, int dist, double a, double b){
+	if(dist == MACSIM_DIST_NONE)
+		fatal("%s: a station needs a service time", __func__);
+	macsim_dist_set(&macsim_network_station(net, station, __func__)->service, dist, a, b, __func__);
+}
+
+
+/* Llegadas externas a una estación con la distribución de tiempo entre llegadas indicada */
+void macsim_network_arrivals(struct macsim_network_t *net, int station, int dist, double a, double b){
+	macsim_dist_set(&macsim_network_station(net, station, __func__)->arrivals, dist, a, b, __func__);
+}
+
+
+/* Número de clientes que están en la estación al empezar la simulación */
+void macsim_network_population(struct macsim_network_t *net, int station, int customers){
+	if(customers < 0)
+		fatal("%s: negative population", __func__);
+	macsim_network_station(net, station, __func__)->population = customers;
+}
+
+
+/* Un cliente que sale de \from va a \to con probabilidad \prob */
+void macsim_network_route(struct macsim_network_t *net, int from, int to, double prob){
+	struct macsim_network_station_t *s = macsim_network_station(net, from, __func__);
+	double sum = prob;
+	int r;
+
+	macsim_network_station(net, to, __func__);
+	if(prob < 0 || prob > 1)
+		fatal("%s: invalid probability %f", __func__, prob);
+	for(r = 0; r < s->route_count; r++)
+		sum += s->routes[r].prob;
+	if(sum > 1 + 1e-9)
+		fatal("%s: routing probabilities of \"%s\" add up to %f", __func__, s->name, sum);
+
+	if(s->route_count == s->route_size){
+		s->route_size = s->route_size ? s->route_size * 2 : 4;
+		s->routes = (struct macsim_network_route_t *) realloc(s->routes, s->route_size * sizeof(struct macsim_network_route_t));
+		if(!s->routes)
+			fatal("%s: out of memory", __func__);
+	}
+	s->routes[s->route_count].to = to;
+	s->routes[s->route_count].prob = prob;
+	s->route_count++;
+}
+
+
+/* Convierte una estación en una estación de retardo (servidores infinitos): cada cliente
+ * pasa en ella un tiempo de reflexión con la distribución indicada, sin esperar a los demás.
+ * Solo la simula macsim_network_run_closed. */
+void macsim_network_delay(struct macsim_network_t *net, int station, int dist, double a, double b){
+	struct macsim_network_station_t *s = macsim_network_station(net, station, __func__);
+	if(dist == MACSIM_DIST_NONE)
+		fatal("%s: a delay station needs a think time", __func__);
+	macsim_dist_set(&s->service, dist, a, b, __func__);
+	s->delay = 1;
+}
+
+
+/* Semilla de la que se derivan los streams de todas las estaciones y fuentes */
+void macsim_network_seed(struct macsim_network_t *net, long seed){
+	net->seed = seed;
+}
+
+
+/* Añade una clase de clientes sin población ni encaminamiento. Las clases se llaman
+ * c0, c1... si \name es NULL. La clase 0 la crea macsim_network_create.
+ * @return Índice de la clase */
+int macsim_network_class_create(struct macsim_network_t *net, const char *name){
+	struct macsim_network_class_t *c;
+	char buf[32];
+
+	net->classes = (struct macsim_network_class_t *) realloc(net->classes, (net->class_count + 1) * sizeof(struct macsim_network_class_t));
+	if(!net->classes)
+		fatal("%s: out of memory", __func__);
+	c = &net->classes[net->class_count];
+	memset(c, 0, sizeof(*c));
+	if(!name){
+		snprintf(buf, sizeof(buf), "c%d", net->class_count);
+		name = buf;
+	}
+	c->name = strdup(name);
+	if(!c->name)
+		fatal("%s: out of memory", __func__);
+	c->reference = -1;
+	if(net->class_count){
+		c->population = (int *) calloc(net->count, sizeof(int));
+		if(!c->population)
+			fatal("%s: out of memory", __func__);
+	}
+	return net->class_count++;
+}
+
+
+/* Función privada que comprueba el índice de una clase */
+static struct macsim_network_class_t * macsim_network_class(struct macsim_network_t *net, int cls, const char *func){
+	if(cls < 0 || cls >= net->class_count)
+		fatal("%s: unknown class %d", func, cls);
+	return &net->classes[cls];
+}
+
+
+/* Número de clientes de la clase \cls en la estación al empezar la simulación */
+void macsim_network_class_population(struct macsim_network_t *net, int cls, int station, int customers){
+	struct macsim_network_class_t *c = macsim_network_class(net, cls, __func__);
+	if(!cls){
+		macsim_network_population(net, station, customers);
+		return;
+	}
+	if(customers < 0)
+		fatal("%s: negative population", __func__);
+	macsim_network_station(net, station, __func__);
+	c->population[station] = customers;
+}
+
+
+/* Un cliente de la clase \cls que sale de \from va a \to con probabilidad \prob */
+void macsim_network_class_route(struct macsim_network_t *net, int cls, int from, int to, double prob){
+	struct macsim_network_class_t *c = macsim_network_class(net, cls, __func__);
+	double sum = prob;
+	int r;
+
+	if(!cls){
+		macsim_network_route(net, from, to, prob);
+		return;
+	}
+	macsim_network_station(net, from, __func__);
+	macsim_network_station(net, to, __func__);
+	if(prob < 0 || prob > 1)
+		fatal("%s: invalid probability %f", __func__, prob);
+	for(r = 0; r < c->route_count; r++){
+		if(c->routes[r].from == from)
+			sum += c->routes[r].prob;
+	}
+	if(sum > 1 + 1e-9)
+		fatal("%s: routing probabilities of \"%s\" in class \"%s\" add up to %f", __func__, net->stations[from].name, c->name, sum);
+
+	if(c->route_count == c->route_size){
+		c->route_size = c->route_size ? c->route_size * 2 : 4;
+		c->routes = (struct macsim_network_class_route_t *) realloc(c->routes, c->route_size * sizeof(struct macsim_network_class_route_t));
+		if(!c->routes)
+			fatal("%s: out of memory", __func__);
+	}
+	c->routes[c->route_count].from = from;
+	c->routes[c->route_count].to = to;
+	c->routes[c->route_count].prob = prob;
+	c->route_count++;
+}
+
+
+/* Estación en la que se mide el tiempo de ciclo de la clase \cls: un ciclo es el tiempo
+ * entre dos llegadas consecutivas de un cliente a ella */
+void macsim_network_class_reference(struct macsim_network_t *net, int cls, int station){
+	macsim_network_station(net, station, __func__);
+	macsim_network_class(net, cls, __func__)->reference = station;
+}
+
+
+/* Devuelve el número de clases de clientes de la red */
+int macsim_network_class_count(struct macsim_network_t *net){
+	return net->class_count;
+}
+
+
+/* Comprueba que la red la pueden simular los motores con estaciones FCFS y una sola clase
+ * (las clases sin clientes no cuentan) */
+void macsim_network_check_simple(struct macsim_network_t *net, const char *func){
+	int k, cls;
+	for(cls = 1; cls < net->class_count; cls++){
+		for(k = 0; k < net->count; k++){
+			if(net->classes[cls].population[k])
+				fatal("%s: networks with several classes need macsim_network_run_closed", func);
+		}
+	}
+	for(k = 0; k < net->count; k++){
+		if(net->stations[k].delay)
+			fatal("%s: delay station \"%s\" needs macsim_network_run_closed", func, net->stations[k].name);
+	}
+}
+
+
+/* Devuelve el número de estaciones de la red */
+int macsim_network_count(struct macsim_network_t *net){
+	return net->count;
+}
+
+
+/* Devuelve el número total de clientes iniciales */
+int macsim_network_total_population(struct macsim_network_t *net){
+	int k, total = 0;
+	for(k = 0; k < net->count; k++)
+		total += net->stations[k].population;
+	return total;
+}
+
+
+/* Genera un valor de la distribución en ms usando el stream \state */
+double macsim_dist_sample(const struct macsim_dist_t *dist, long *state){
+	switch(dist->type){
+	case MACSIM_DIST_CONSTANT:
+		return dist->a;
+	case MACSIM_DIST_EXPONENTIAL:
+		return -dist->a * log(macsim_random_r(state));
+	case MACSIM_DIST_UNIFORM:
+		return dist->a + (dist->b - dist->a) * macsim_random_r(state);
+	case MACSIM_DIST_SHIFTED_EXPONENTIAL:
+		return dist->a - (dist->b - dist->a) * log(macsim_random_r(state));
+	}
+	return 0;
+}
+
+
+/* Devuelve el menor valor que puede generar la distribución, en ms */
+double macsim_dist_min(const struct macsim_dist_t *dist){
+	switch(dist->type){
+	case MACSIM_DIST_CONSTANT:
+	case MACSIM_DIST_UNIFORM:
+	case MACSIM_DIST_SHIFTED_EXPONENTIAL:
+		return dist->a;
+	}
+	return 0;
+}
+
+
+/* Elige la estación a la que va un cliente que sale de \station
+ * @return La estación destino o -1 si el cliente abandona la red */
+int macsim_network_next(struct macsim_network_t *net, int station, long *state){
+	struct macsim_network_station_t *s = &net->stations[station];
+	double u;
+	int r;
+
+	if(!s->route_count)
+		return -1;
+	u = macsim_random_r(state);
+	for(r = 0; r < s->route_count; r++){
+		u -= s->routes[r].prob;
+		if(u < 0)
+			return s->routes[r].to;
+	}
+	return -1;
+}
+
+
+/* Calcula el estado inicial de los streams de servicio/encaminamiento y de llegadas de cada estación */
+void macsim_network_streams(struct macsim_network_t *net, long *service_streams, long *arrival_streams){
+	unsigned long long z;
+	int k, i;
+
+	for(k = 0; k < 2 * net->count; k++){
+		/* splitmix64 de la semilla y el número de stream */
+		z = (unsigned long long) net->seed * 0x9e3779b97f4a7c15ULL + (unsigned long long) (k + 1) * 0xbf58476d1ce4e5b9ULL;
+		for(i = 0; i < 2; i++){
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			z ^= z >> 31;
+		}
+		if(k < net->count)
+			service_streams[k] = 1 + (long) (z % (NETWORK_MODULO - 1));
+		else
+			arrival_streams[k - net->count] = 1 + (long) (z % (NETWORK_MODULO - 1));
+	}
+}
+
+
+/* Rellena los resultados de una estación a partir de sus acumulados, igual que macsim_report.
+ * \elapsed es la duración del periodo medido en ns. */
+void macsim_network_result(struct macsim_result_t *result, const char *name, long long clients, long long response_time, long long service_time, long long elapsed){
+	memset(result, 0, sizeof(*result));
+	result->name = name;
+	result->total_clients = clients;
+	if(!clients || elapsed <= 0)
+		return;
+	result->service_time = service_time / (double) clients / 1000000.0;
+	result->response_time = response_time / (double) clients / 1000000.0;
+	result->queue_time = result->response_time - result->service_time;
+	result->throughput = clients / (double) elapsed * 1000000;
+	result->utilization = result->throughput * result->service_time;
+	result->mean_clients = response_time / (double) elapsed;
+}
+
+
+/* Simula la red durante \horizon_ms con el bucle de eventos de la librería
+ * (macsim_extract, macsim_station_request, macsim_station_leave), creando una estación
+ * de la simulación por cada estación de la red o reutilizando la que tenga su nombre, que
+ * debe estar vacía (p.ej. tras macsim_reset). La librería debe estar inicializada y
+ * las estaciones quedan creadas, así que macsim_report sigue funcionando.
+ * Los clientes iniciales tienen ids 0..N-1 por orden de estación y los externos
+ * N + secuencia * estaciones + estación. */
+void macsim_network_run(struct macsim_network_t *net, double horizon_ms, struct macsim_result_t *results){
+	struct macsim_station_t **stations;
+	long *service_streams, *arrival_streams;
+	long long *seq, *ids, *delays, start, end, client, id, population;
+	int k, j, kind, pending = 0;
+
+	macsim_network_check_simple(net, __func__);
+	stations = (struct macsim_station_t **) malloc(net->count * sizeof(struct macsim_station_t *));
+	service_streams = (long *) malloc(net->count * sizeof(long));
+	arrival_streams = (long *) malloc(net->count * sizeof(long));
+	seq = (long long *) calloc(net->count, sizeof(long long));
+	if(!stations || !service_streams || !arrival_streams || !seq)
+		fatal("%s: out of memory", __func__);
+	for(k = 0; k < net->count; k++){
+		stations[k] = macsim_station_get(net->stations[k].name);
+		if(!stations[k])
+			stations[k] = macsim_station_create(net->stations[k].name);
+	}
+	macsim_network_streams(net, service_streams, arrival_streams);
+	population = macsim_network_total_population(net);
+
+	start = macsim_time_ns();
+	end = start + (long long) (horizon_ms * 1000000);
+
+	/* Clientes iniciales, de una vez, y primera llegada de cada fuente */
+	ids = (long long *) malloc((population + 1) * sizeof(long long));
+	delays = (long long *) calloc(population + 1, sizeof(long long));
+	if(!ids || !delays)
+		fatal("%s: out of memory", __func__);
+	for(k = 0, id = 0; k < net->count; k++){
+		for(j = 0; j < net->stations[k].population; j++)
+			ids[j] = id++;
+		macsim_schedule_bulk_ns(NETWORK_ARRIVE(k), ids, delays, net->stations[k].population);
+		pending += net->stations[k].population;
+	}
+	free(ids);
+	free(delays);
+	for(k = 0; k < net->count; k++){
+		if(net->stations[k].arrivals.type != MACSIM_DIST_NONE){
+			macsim_schedule(NETWORK_SOURCE(k), 0, macsim_dist_sample(&net->stations[k].arrivals, &arrival_streams[k]));
+			pending++;
+		}
+	}
+
+	while(pending){
+		macsim_extract(&kind, &client);
+		if(macsim_time_ns() >= end)
+			break;
+		k = kind / 3;
+		switch(kind % 3){
+		case 0: //Llegada
+			if(macsim_station_request(stations[k], client) == MACSIM_USING_STATION)
+				macsim_schedule(NETWORK_DEPART(k), client, macsim_dist_sample(&net->stations[k].service, &service_streams[k]));
+			break;
+		case 1: //Fin de servicio
+			macsim_station_leave(stations[k], client);
+			j = macsim_network_next(net, k, &service_streams[k]);
+			if(j >= 0)
+				macsim_schedule_ns(NETWORK_ARRIVE(j), client, 0);
+			else
+				pending--;
+			break;
+		case 2: //Llegada externa
+			macsim_schedule(NETWORK_SOURCE(k), 0, macsim_dist_sample(&net->stations[k].arrivals, &arrival_streams[k]));
+			macsim_schedule_ns(NETWORK_ARRIVE(k), population + seq[k]++ * net->count + k, 0);
+			pending++;
+			break;
+		}
+	}
+
+	for(k = 0; k < net->count; k++)
+		macsim_network_result(&results[k], stations[k]->name, stations[k]->total_clients,
+			stations[k]->total_response_time, stations[k]->total_service_time, end - start);
+
+	free(stations);
+	free(service_streams);
+	free(arrival_streams);
+	free(seq);
+}
@@ -0,0 +1,102 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "macsim.h"
+
+/* Distribuciones de los tiempos del modelo. Los parámetros van en ms. */
+enum macsim_dist_enum {
+	MACSIM_DIST_NONE = 0, //Sin llegadas externas
+	MACSIM_DIST_CONSTANT, //Valor a
+	MACSIM_DIST_EXPONENTIAL, //Media a
+	MACSIM_DIST_UNIFORM, //Entre a y b
+	MACSIM_DIST_SHIFTED_EXPONENTIAL //Mínimo a y media b
+};
+
+/* Estructuras */
+struct macsim_dist_t {
+	int type; //enum macsim_dist_enum
+	double a, b;
+};
+
+struct macsim_network_route_t {
+	int to; //Estación destino
+	double prob; //Probabilidad de ir a ella
+};
+
+/* Estación de una red: un servidor FCFS, o una estación de retardo */
+struct macsim_network_station_t {
+	char *name;
+	int delay; //Estación de retardo (servidores infinitos, sin cola): el servicio es el tiempo de reflexión
+	struct macsim_dist_t service; //Tiempo de servicio
+	struct macsim_dist_t arrivals; //Tiempo entre llegadas externas (MACSIM_DIST_NONE si no hay)
+	int population; //Clientes en la estación al empezar (redes cerradas)
+	struct macsim_network_route_t *routes; //Encaminamiento a la salida; lo que falta hasta 1 abandona la red
+	int route_count, route_size;
+};
+
+/* Ruta de una clase de clientes */
+struct macsim_network_class_route_t {
+	int from, to;
+	double prob;
+};
+
+/* Clase de clientes de una red cerrada. La clase 0 usa la población y el encaminamiento
+ * de las estaciones; el resto tienen los suyos. */
+struct macsim_network_class_t {
+	char *name;
+	int reference; //Estación en la que se mide el tiempo de ciclo (-1: la primera con clientes de la clase)
+	int *population; //Clientes de la clase en cada estación al empezar (NULL en la clase 0)
+	struct macsim_network_class_route_t *routes; //Encaminamiento de la clase (sin usar en la clase 0)
+	int route_count, route_size;
+};
+
+/* Resultados de una clase en macsim_network_run_closed */
+struct macsim_network_class_result_t {
+	const char *name;
+	long long cycles; //Ciclos completados (pasos por la estación de referencia)
+	double cycle_time; //Tiempo medio de ciclo en ms
+	double throughput; //Ciclos por ms
+};
+
+/* Red de colas completa, que la librería puede simular sin código de usuario.
+ * Cada estación y cada fuente de llegadas tiene su propio stream aleatorio, así que
+ * los resultados no dependen del orden en que se intercalan los eventos de estaciones distintas. */
+struct macsim_network_t {
+	int count; //Número de estaciones
+	long seed; //Semilla de la que se derivan los streams
+	struct macsim_network_station_t *stations;
+	int class_count; //Número de clases de clientes, al menos 1
+	struct macsim_network_class_t *classes;
+};
+
+/* Prototipos */
+struct macsim_network_t * macsim_network_create(int stations);
+void macsim_network_free(struct macsim_network_t *net);
+void macsim_network_name(struct macsim_network_t *net, int station, const char *name);
+void macsim_network_service(struct macsim_network_t *net, int station, int dist, double a, double b);
+void macsim_network_arrivals(struct macsim_network_t *net, int station, int dist, double a, double b);
+void macsim_network_population(struct macsim_network_t *net, int station, int customers);
+void macsim_network_route(struct macsim_network_t *net, int from, int to, double prob);
+void macsim_network_delay(struct macsim_network_t *net, int station, int dist, double a, double b);
+void macsim_network_seed(struct macsim_network_t *net, long seed);
+int macsim_network_class_create(struct macsim_network_t *net, const char *name);
+void macsim_network_class_population(struct macsim_network_t *net, int cls, int station, int customers);
+void macsim_network_class_route(struct macsim_network_t *net, int cls, int from, int to, double prob);
+void macsim_network_class_reference(struct macsim_network_t *net, int cls, int station);
+int macsim_network_class_count(struct macsim_network_t *net);
+int macsim_network_count(struct macsim_network_t *net);
+void macsim_network_run(struct macsim_network_t *net, double horizon_ms, struct macsim_result_t *results);
+void macsim_network_run_parallel(struct macsim_network_t *net, double horizon_ms, int threads, struct macsim_result_t *results);
+long long macsim_network_run_optimistic(struct macsim_network_t *net, double horizon_ms, int threads, struct macsim_result_t *results);
+long long macsim_network_run_closed(struct macsim_network_t *net, double horizon_ms, struct macsim_result_t *results, struct macsim_network_class_result_t *class_results);
+
+/* Uso interno de los motores de simulación */
+double macsim_dist_sample(const struct macsim_dist_t *dist, long *state);
+double macsim_dist_min(const struct macsim_dist_t *dist);
+int macsim_network_next(struct macsim_network_t *net, int station, long *state);
+void macsim_network_streams(struct macsim_network_t *net, long *service_streams, long *arrival_streams);
+int macsim_network_total_population(struct macsim_network_t *net);
+void macsim_network_check_simple(struct macsim_network_t *net, const char *func);
+void macsim_network_result(struct macsim_result_t *result, const char *name, long long clients, long long response_time, long long service_time, long long elapsed);
+
+#endif /* NETWORK_H */
@@ -0,0 +1,611 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "network.h"
+#include "heap.h"
+#include "debug.h"
+
+/* Motor paralelo conservador (Chandy-Misra-Bryant) para redes de colas.
+ *
+ * Las estaciones se reparten en particiones contiguas, una por hilo, y cada partición
+ * tiene sus propias colas de eventos. Los eventos se ordenan por una clave entera:
+ * 2t para los fines de servicio y 2t+1 para las llegadas, de modo que en el mismo
+ * nanosegundo las salidas van antes que las llegadas, igual que en la cola global.
+ *
+ * Los clientes que pasan a otra partición viajan por canales SPSC sin cerrojos. Cada canal
+ * lleva además un reloj: una cota inferior de las claves que el emisor enviará en el futuro
+ * (mensajes nulos). La cota se obtiene del servicio mínimo de las estaciones de la partición
+ * (lookahead). Una partición solo procesa eventos con clave menor que el menor de los relojes
+ * de sus canales de entrada.
+ *
+ * Cuando el lookahead es nulo (servicios exponenciales) los relojes dejan de avanzar y todas las
+ * particiones se bloquean. Entonces se hace una ronda de recuperación: con todos los hilos parados
+ * se calcula la menor clave pendiente de toda la simulación y se permite procesar los eventos con
+ * esa clave. Los eventos de la misma clave son llegadas o salidas de estaciones distintas, o
+ * llegadas simultáneas a la misma estación, cuyo orden no cambia las estadísticas.
+ *
+ * Cada estación usa sus propios streams (macsim_network_streams), así que los resultados son los
+ * mismos que los de macsim_network_run. */
+
+#define PDES_RING_SIZE 1024 //Mensajes en cada canal (potencia de 2)
+#define PDES_RING_MASK (PDES_RING_SIZE - 1)
+#define PDES_SPIN 64 //Iteraciones sin progreso antes de pedir una ronda de recuperación
+
+/* Tipos de evento */
+#define PDES_ARRIVE 0
+#define PDES_DEPART 1
+#define PDES_SOURCE 2
+
+/* Estructuras */
+struct pdes_message_t {
+	long long key; //Clave de la llegada
+	long long client;
+	int station; //Estación destino
+	int reserved;
+};
+
+/* Canal de una partición a otra. Las posiciones crecen indefinidamente, como en la traza binaria. */
+struct pdes_channel_t {
+	_Alignas(64) atomic_llong clock; //Cota inferior de las claves de los mensajes futuros
+
+	_Alignas(64) atomic_ulong head; //Siguiente posición a escribir (emisor)
+	unsigned long cached_tail;
+	struct pdes_message_t *overflow; //Mensajes que no caben en el canal, en orden (emisor)
+	int overflow_count, overflow_size;
+
+	_Alignas(64) atomic_ulong tail; //Siguiente posición a leer (receptor)
+
+	struct pdes_message_t *messages; //PDES_RING_SIZE mensajes
+};
+
+struct pdes_event_t {
+	long long client;
+	int station;
+	int kind;
+	struct pdes_event_t *next; //Lista de eventos libres
+};
+
+/* Cliente en una estación; el primero de la cola es el que está en servicio */
+struct pdes_client_t {
+	long long id;
+	long long entry; //Llegada a la estación
+};
+
+struct pdes_station_t {
+	struct pdes_client_t *queue; //Cola circular
+	int queue_head, queue_count, queue_size;
+	long long server_entry; //Entrada en servicio del primer cliente
+	long service_stream, arrival_stream;
+	long long seq; //Llegadas externas generadas
+	long long clients, response, service; //Estadísticas en ns
+};
+
+struct pdes_engine_t;
+
+/* Partición: un proceso lógico ejecutado por un hilo */
+struct pdes_lp_t {
+	struct pdes_engine_t *engine;
+	int id;
+	int first, last; //Estaciones [first, last)
+	struct heap_t *arrivals, *departures; //Llegadas (y fuentes) y fines de servicio
+	struct pdes_event_t *free_events;
+	struct pdes_channel_t **inputs;
+	int input_count;
+	struct pdes_channel_t **outputs; //Indexado por partición, NULL si no hay encaminamiento
+	long long lookahead; //Servicio mínimo de la partición, en unidades de clave
+	long long stall_min; //Menor clave pendiente al pedir una ronda
+	int stalled;
+	pthread_t thread;
+};
+
+struct pdes_engine_t {
+	struct macsim_network_t *net;
+	struct pdes_station_t *stations;
+	int *partition; //Partición de cada estación
+	struct pdes_lp_t *lps;
+	int count; //Número de particiones
+	struct pdes_channel_t **channels; //count x count, NULL si no se usa
+	long long horizon; //Clave límite: se procesan las menores
+
+	/* Rondas de recuperación */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int waiting, active;
+	long long generation;
+	atomic_llong floor; //Se pueden procesar las claves menores o iguales
+};
+
+
+/* Funciones */
+/* Suma saturada para cotas que pueden ser LLONG_MAX */
+static long long pdes_add(long long a, long long b){
+	return a > LLONG_MAX - b ? LLONG_MAX : a + b;
+}
+
+
+static long long pdes_min(long long a, long long b){
+	return a < b ? a : b;
+}
+
+
+/* Menor clave de una cola de eventos, LLONG_MAX si está vacía */
+static long long pdes_peek(struct heap_t *heap){
+	return heap_count(heap) ? heap_peek(heap, NULL) : LLONG_MAX;
+}
+
+
+static long long pdes_local_min(struct pdes_lp_t *lp){
+	return pdes_min(pdes_peek(lp->arrivals), pdes_peek(lp->departures));
+}
+
+
+static void pdes_insert(struct pdes_lp_t *lp, struct heap_t *heap, long long key, int kind, int station, long long client){
+	struct pdes_event_t *event = lp->free_events;
+
+	if(event)
+		lp->free_events = event->next;
+	else if(!(event = (struct pdes_event_t *) malloc(sizeof(struct pdes_event_t))))
+		fatal("%s: out of memory", __func__);
+	event->client = client;
+	event->station = station;
+	event->kind = kind;
+	heap_insert(heap, key, event);
+	if(heap_error(heap))
+		fatal("%s: %s", __func__, heap_error_msg(heap));
+}
+
+
+/* Clave de un instante desplazado \ms, con el mismo redondeo que macsim_schedule */
+static long long pdes_delay(long long time, double ms){
+	return time + (long long) (ms * 1000000);
+}
+
+
+/* Escribe un mensaje en el canal
+ * @return 0 si el canal está lleno */
+static int pdes_ring_push(struct pdes_channel_t *ch, const struct pdes_message_t *message){
+	unsigned long head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+
+	if(head - ch->cached_tail == PDES_RING_SIZE){
+		ch->cached_tail = atomic_load_explicit(&ch->tail, memory_order_acquire);
+		if(head - ch->cached_tail == PDES_RING_SIZE)
+			return 0;
+	}
+	ch->messages[head & PDES_RING_MASK] = *message;
+	atomic_store_explicit(&ch->head, head + 1, memory_order_release);
+	return 1;
+}
+
+
+/* Intenta pasar al canal los mensajes que no cupieron */
+static void pdes_flush(struct pdes_channel_t *ch){
+	int sent = 0;
+
+	while(sent < ch->overflow_count && pdes_ring_push(ch, &ch->overflow[sent]))
+		sent++;
+	if(sent){
+		memmove(ch->overflow, ch->overflow + sent, (ch->overflow_count - sent) * sizeof(struct pdes_message_t));
+		ch->overflow_count -= sent;
+	}
+}
+
+
+/* Envía un cliente a una estación de otra partición. El emisor nunca espera: si el canal
+ * está lleno el mensaje se guarda hasta que haya sitio. */
+static void pdes_send(struct pdes_lp_t *lp, int station, long long key, long long client){
+	struct pdes_channel_t *ch = lp->outputs[lp->engine->partition[station]];
+	struct pdes_message_t message;
+
+	if(key >= lp->engine->horizon)
+		return;
+	message.key = key;
+	message.client = client;
+	message.station = station;
+	message.reserved = 0;
+	if(!ch->overflow_count && pdes_ring_push(ch, &message))
+		return;
+
+	if(ch->overflow_count == ch->overflow_size){
+		ch->overflow_size = ch->overflow_size ? ch->overflow_size * 2 : PDES_RING_SIZE;
+		ch->overflow = (struct pdes_message_t *) realloc(ch->overflow, ch->overflow_size * sizeof(struct pdes_message_t));
+		if(!ch->overflow)
+			fatal("%s: out of memory", __func__);
+	}
+	ch->overflow[ch->overflow_count++] = message;
+}
+
+
+/* Lee los mensajes de los canales de entrada
+ * @return Número de mensajes recibidos; en \safe el menor de los relojes de entrada */
+static int pdes_receive(struct pdes_lp_t *lp, long long *safe){
+	struct pdes_channel_t *ch;
+	unsigned long head, tail;
+	long long clock;
+	int i, received = 0;
+
+	*safe = LLONG_MAX;
+	for(i = 0; i < lp->input_count; i++){
+		ch = lp->inputs[i];
+
+		/* El reloj se lee antes que los mensajes: los enviados después tienen claves mayores */
+		clock = atomic_load_explicit(&ch->clock, memory_order_acquire);
+		*safe = pdes_min(*safe, clock);
+
+		tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+		head = atomic_load_explicit(&ch->head, memory_order_acquire);
+		for(; tail != head; tail++, received++){
+			struct pdes_message_t *message = &ch->messages[tail & PDES_RING_MASK];
+			pdes_insert(lp, lp->arrivals, message->key, PDES_ARRIVE, message->station, message->client);
+		}
+		atomic_store_explicit(&ch->tail, tail, memory_order_release);
+	}
+	return received;
+}
+
+
+/* Publica en los canales de salida la cota de las claves que se enviarán en el futuro.
+ * Los fines de servicio ya planificados envían en D+1; cualquier otro cliente tiene que
+ * llegar (en A o después de \safe), empezar el servicio y completarlo, lo que lleva al menos
+ * el lookahead de la partición. */
+static void pdes_publish(struct pdes_lp_t *lp, long long safe){
+	struct pdes_channel_t *ch;
+	long long bound, pending;
+	int p, i;
+
+	bound = pdes_min(pdes_add(pdes_peek(lp->departures), 1),
+		pdes_add(pdes_min(pdes_peek(lp->arrivals), safe), lp->lookahead));
+	for(p = 0; p < lp->engine->count; p++){
+		if(!(ch = lp->outputs[p]))
+			continue;
+		pdes_flush(ch);
+		for(i = 0, pending = LLONG_MAX; i < ch->overflow_count; i++)
+			pending = pdes_min(pending, ch->overflow[i].key);
+		if(pdes_min(bound, pending) > atomic_load_explicit(&ch->clock, memory_order_relaxed))
+			atomic_store_explicit(&ch->clock, pdes_min(bound, pending), memory_order_release);
+	}
+}
+
+
+/* Empieza el servicio del primer cliente de la estación */
+static void pdes_start(struct pdes_lp_t *lp, int k, long long time){
+	struct pdes_station_t *s = &lp->engine->stations[k];
+	struct pdes_client_t *client = &s->queue[s->queue_head];
+
+	s->server_entry = time;
+	pdes_insert(lp, lp->departures, 2 * pdes_delay(time, macsim_dist_sample(&lp->engine->net->stations[k].service, &s->service_stream)),
+		PDES_DEPART, k, client->id);
+}
+
+
+/* Un cliente llega a una estación de la partición */
+static void pdes_arrive(struct pdes_lp_t *lp, int k, long long client, long long time){
+	struct pdes_station_t *s = &lp->engine->stations[k];
+	struct pdes_client_t *queue;
+	int i;
+
+	if(s->queue_count == s->queue_size){
+		queue = (struct pdes_client_t *) malloc((s->queue_size ? s->queue_size * 2 : 4) * sizeof(struct pdes_client_t));
+		if(!queue)
+			fatal("%s: out of memory", __func__);
+		for(i = 0; i < s->queue_count; i++)
+			queue[i] = s->queue[(s->queue_head + i) % s->queue_size];
+		free(s->queue);
+		s->queue = queue;
+		s->queue_head = 0;
+		s->queue_size = s->queue_size ? s->queue_size * 2 : 4;
+	}
+	queue = &s->queue[(s->queue_head + s->queue_count) % s->queue_size];
+	queue->id = client;
+	queue->entry = time;
+	if(++s->queue_count == 1)
+		pdes_start(lp, k, time);
+}
+
+
+/* Procesa el evento de menor clave de la partición */
+static void pdes_process(struct pdes_lp_t *lp){
+	struct pdes_engine_t *engine = lp->engine;
+	struct macsim_network_t *net = engine->net;
+	struct pdes_event_t *event;
+	struct pdes_station_t *s;
+	struct pdes_client_t client;
+	long long key, time;
+	int j;
+
+	if(pdes_peek(lp->departures) < pdes_peek(lp->arrivals))
+		key = heap_extract(lp->departures, (void **) &event);
+	else
+		key = heap_extract(lp->arrivals, (void **) &event);
+	time = key >> 1;
+	s = &engine->stations[event->station];
+
+	switch(event->kind){
+	case PDES_ARRIVE:
+		pdes_arrive(lp, event->station, event->client, time);
+		break;
+
+	case PDES_DEPART:
+		/* Estadísticas, como macsim_station_leave */
+		client = s->queue[s->queue_head];
+		s->queue_head = (s->queue_head + 1) % s->queue_size;
+		s->queue_count--;
+		s->clients++;
+		s->response += time - client.entry;
+		s->service += time - s->server_entry;
+
+		/* Igual que el motor secuencial: primero el encaminamiento y después el servicio del siguiente */
+		j = macsim_network_next(net, event->station, &s->service_stream);
+		if(s->queue_count)
+			pdes_start(lp, event->station, time);
+		if(j >= 0 && engine->partition[j] == lp->id)
+			pdes_insert(lp, lp->arrivals, 2 * time + 1, PDES_ARRIVE, j, client.id);
+		else if(j >= 0)
+			pdes_send(lp, j, 2 * time + 1, client.id);
+		break;
+
+	case PDES_SOURCE:
+		pdes_insert(lp, lp->arrivals, 2 * pdes_delay(time, macsim_dist_sample(&net->stations[event->station].arrivals, &s->arrival_stream)) + 1,
+			PDES_SOURCE, event->station, event->client);
+		pdes_arrive(lp, event->station, event->client + s->seq++ * net->count, time);
+		break;
+	}
+
+	event->next = lp->free_events;
+	lp->free_events = event;
+}
+
+
+/* Ronda de recuperación. Se llama con el cerrojo cogido cuando todas las particiones activas
+ * están paradas: nadie envía ni recibe, así que se pueden mirar los canales ajenos. */
+static void pdes_round(struct pdes_engine_t *engine){
+	struct pdes_channel_t *ch;
+	long long floor = LLONG_MAX;
+	unsigned long tail, head;
+	int p;
+
+	for(p = 0; p < engine->count; p++){
+		if(engine->lps[p].stalled)
+			floor = pdes_min(floor, engine->lps[p].stall_min);
+	}
+	for(p = 0; p < engine->count * engine->count; p++){
+		if(!(ch = engine->channels[p]))
+			continue;
+		head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+		for(tail = atomic_load_explicit(&ch->tail, memory_order_relaxed); tail != head; tail++)
+			floor = pdes_min(floor, ch->messages[tail & PDES_RING_MASK].key);
+		for(tail = 0; tail < ch->overflow_count; tail++)
+			floor = pdes_min(floor, ch->overflow[tail].key);
+	}
+
+	if(floor > atomic_load_explicit(&engine->floor, memory_order_relaxed))
+		atomic_store_explicit(&engine->floor, floor, memory_order_release);
+	for(p = 0; p < engine->count; p++)
+		engine->lps[p].stalled = 0;
+	engine->waiting = 0;
+	engine->generation++;
+	pthread_cond_broadcast(&engine->cond);
+}
+
+
+/* La partición no puede avanzar: espera a que se paren todas y se haga una ronda */
+static void pdes_stall(struct pdes_lp_t *lp){
+	struct pdes_engine_t *engine = lp->engine;
+	long long generation;
+
+	pthread_mutex_lock(&engine->lock);
+	lp->stalled = 1;
+	lp->stall_min = pdes_local_min(lp);
+	if(++engine->waiting == engine->active)
+		pdes_round(engine);
+	else {
+		generation = engine->generation;
+		while(generation == engine->generation)
+			pthread_cond_wait(&engine->cond, &engine->lock);
+	}
+	pthread_mutex_unlock(&engine->lock);
+}
+
+
+/* Hilo de una partición */
+static void * pdes_worker(void *arg){
+	struct pdes_lp_t *lp = (struct pdes_lp_t *) arg;
+	struct pdes_engine_t *engine = lp->engine;
+	long long safe, floor, limit;
+	int p, received, processed, pending, spins = 0;
+
+	for(;;){
+		received = pdes_receive(lp, &safe);
+		floor = atomic_load_explicit(&engine->floor, memory_order_acquire);
+		if(floor > safe)
+			safe = floor;
+
+		/* Eventos seguros: los anteriores a cualquier mensaje futuro y los de la ronda */
+		limit = pdes_add(floor, 1) > safe ? pdes_add(floor, 1) : safe;
+		limit = pdes_min(limit, engine->horizon);
+		for(processed = 0; pdes_local_min(lp) < limit; processed++)
+			pdes_process(lp);
+		pdes_publish(lp, safe);
+
+		for(p = 0, pending = 0; p < engine->count; p++)
+			pending += lp->outputs[p] ? lp->outputs[p]->overflow_count : 0;
+		if(pdes_local_min(lp) >= engine->horizon && safe >= engine->horizon && !pending)
+			break;
+
+		if(received || processed)
+			spins = 0;
+		else if(++spins < PDES_SPIN)
+			sched_yield();
+		else {
+			spins = 0;
+			pdes_stall(lp);
+		}
+	}
+
+	/* No se enviará nada más */
+	for(p = 0; p < engine->count; p++){
+		if(lp->outputs[p])
+			atomic_store_explicit(&lp->outputs[p]->clock, LLONG_MAX, memory_order_release);
+	}
+	pthread_mutex_lock(&engine->lock);
+	if(--engine->active && engine->waiting == engine->active)
+		pdes_round(engine);
+	pthread_mutex_unlock(&engine->lock);
+	return NULL;
+}
+
+
+/* Simula la red durante \horizon_ms repartiendo las estaciones entre \threads hilos.
+ * No usa la cola de eventos ni las estaciones de la librería, que no necesita estar inicializada.
+ * Los resultados son los mismos que los de macsim_network_run. El paralelismo depende del
+ * servicio mínimo de las estaciones: con servicios que pueden ser nulos (exponenciales) las
+ * particiones avanzan por rondas y el motor es más lento que el secuencial. */
+void macsim_network_run_parallel(struct macsim_network_t *net, double horizon_ms, int threads, struct macsim_result_t *results){
+	struct pdes_engine_t engine;
+	struct pdes_lp_t *lp;
+	struct pdes_channel_t *ch;
+	struct pdes_event_t *event;
+	long *service_streams, *arrival_streams;
+	long long id, lookahead;
+	int k, p, q, r, j;
+
+	macsim_network_check_simple(net, __func__);
+	if(threads < 1)
+		threads = 1;
+	if(threads > net->count)
+		threads = net->count;
+
+	memset(&engine, 0, sizeof(engine));
+	engine.net = net;
+	engine.count = threads;
+	engine.horizon = 2 * (long long) (horizon_ms * 1000000);
+	engine.active = threads;
+	pthread_mutex_init(&engine.lock, NULL);
+	pthread_cond_init(&engine.cond, NULL);
+	atomic_init(&engine.floor, -1);
+
+	engine.stations = (struct pdes_station_t *) calloc(net->count, sizeof(struct pdes_station_t));
+	engine.partition = (int *) malloc(net->count * sizeof(int));
+	engine.lps = (struct pdes_lp_t *) calloc(threads, sizeof(struct pdes_lp_t));
+	engine.channels = (struct pdes_channel_t **) calloc(threads * threads, sizeof(struct pdes_channel_t *));
+	service_streams = (long *) malloc(net->count * sizeof(long));
+	arrival_streams = (long *) malloc(net->count * sizeof(long));
+	if(!engine.stations || !engine.partition || !engine.lps || !engine.channels || !service_streams || !arrival_streams)
+		fatal("%s: out of memory", __func__);
+
+	/* Streams de cada estación */
+	macsim_network_streams(net, service_streams, arrival_streams);
+	for(k = 0; k < net->count; k++){
+		engine.stations[k].service_stream = service_streams[k];
+		engine.stations[k].arrival_stream = arrival_streams[k];
+	}
+
+	/* Particiones contiguas */
+	for(p = 0; p < threads; p++){
+		lp = &engine.lps[p];
+		lp->engine = &engine;
+		lp->id = p;
+		lp->first = (long long) net->count * p / threads;
+		lp->last = (long long) net->count * (p + 1) / threads;
+		lp->arrivals = heap_create(64);
+		lp->departures = heap_create(64);
+		lp->outputs = (struct pdes_channel_t **) calloc(threads, sizeof(struct pdes_channel_t *));
+		lp->inputs = (struct pdes_channel_t **) calloc(threads, sizeof(struct pdes_channel_t *));
+		if(!lp->arrivals || !lp->departures || !lp->outputs || !lp->inputs)
+			fatal("%s: out of memory", __func__);
+		lp->lookahead = LLONG_MAX;
+		for(k = lp->first; k < lp->last; k++){
+			engine.partition[k] = p;
+			lookahead = 2 * (long long) (macsim_dist_min(&net->stations[k].service) * 1000000);
+			lp->lookahead = pdes_min(lp->lookahead, lookahead);
+		}
+	}
+
+	/* Canales entre particiones con encaminamiento */
+	for(k = 0; k < net->count; k++){
+		for(r = 0; r < net->stations[k].route_count; r++){
+			p = engine.partition[k];
+			q = engine.partition[net->stations[k].routes[r].to];
+			if(p == q || engine.channels[p * threads + q])
+				continue;
+			ch = (struct pdes_channel_t *) aligned_alloc(64, sizeof(struct pdes_channel_t));
+			if(!ch)
+				fatal("%s: out of memory", __func__);
+			memset(ch, 0, sizeof(*ch));
+			ch->messages = (struct pdes_message_t *) malloc(PDES_RING_SIZE * sizeof(struct pdes_message_t));
+			if(!ch->messages)
+				fatal("%s: out of memory", __func__);
+			atomic_init(&ch->clock, 0);
+			atomic_init(&ch->head, 0);
+			atomic_init(&ch->tail, 0);
+			engine.channels[p * threads + q] = ch;
+			engine.lps[p].outputs[q] = ch;
+			engine.lps[q].inputs[engine.lps[q].input_count++] = ch;
+		}
+	}
+
+	/* Clientes iniciales y primera llegada de cada fuente; los ids son los de macsim_network_run */
+	for(k = 0, id = 0; k < net->count; k++){
+		lp = &engine.lps[engine.partition[k]];
+		for(j = 0; j < net->stations[k].population; j++)
+			pdes_insert(lp, lp->arrivals, 1, PDES_ARRIVE, k, id++);
+	}
+	for(k = 0; k < net->count; k++){
+		lp = &engine.lps[engine.partition[k]];
+		if(net->stations[k].arrivals.type != MACSIM_DIST_NONE)
+			pdes_insert(lp, lp->arrivals, 2 * pdes_delay(0, macsim_dist_sample(&net->stations[k].arrivals, &engine.stations[k].arrival_stream)) + 1,
+				PDES_SOURCE, k, id + k);
+	}
+
+	for(p = 0; p < threads; p++){
+		if(pthread_create(&engine.lps[p].thread, NULL, pdes_worker, &engine.lps[p]))
+			fatal("%s: can't create thread", __func__);
+	}
+	for(p = 0; p < threads; p++)
+		pthread_join(engine.lps[p].thread, NULL);
+
+	for(k = 0; k < net->count; k++){
+		macsim_network_result(&results[k], net->stations[k].name, engine.stations[k].clients,
+			engine.stations[k].response, engine.stations[k].service, engine.horizon / 2);
+		free(engine.stations[k].queue);
+	}
+
+	/* Liberar */
+	for(p = 0; p < threads; p++){
+		lp = &engine.lps[p];
+		while(heap_count(lp->arrivals)){
+			heap_extract(lp->arrivals, (void **) &event);
+			free(event);
+		}
+		while(heap_count(lp->departures)){
+			heap_extract(lp->departures, (void **) &event);
+			free(event);
+		}
+		while((event = lp->free_events)){
+			lp->free_events = event->next;
+			free(event);
+		}
+		heap_free(lp->arrivals);
+		heap_free(lp->departures);
+		free(lp->inputs);
+		free(lp->outputs);
+	}
+	for(p = 0; p < threads * threads; p++){
+		if((ch = engine.channels[p])){
+			free(ch->messages);
+			free(ch->overflow);
+			free(ch);
+		}
+	}
+	pthread_mutex_destroy(&engine.lock);
+	pthread_cond_destroy(&engine.cond);
+	free(engine.channels);
+	free(engine.lps);
+	free(engine.partition);
+	free(engine.stations);
+	free(service_streams);
+	free(arrival_streams);
+}
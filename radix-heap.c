@@ -0,0 +1,323 @@
+#include <stdlib.h>
+#include <string.h>
+#include "radix-heap.h"
+
+
+#define RADIX_HEAP_BUCKETS	65
+
+struct radix_heap_elem_t {
+	long long value;
+	void *data;
+};
+
+/* elements 'head' to 'tail' - 1 of 'elem', in insertion order */
+struct radix_heap_bucket_t {
+	struct radix_heap_elem_t *elem;
+	int head, tail, size;
+};
+
+struct radix_heap_t {
+	int count;
+	int error;
+	long long last;  /* last extracted minimum */
+	int peek_bucket;  /* bucket of the minimum found by peek, -1 if unknown */
+	int peek_offset;  /* and its position from the bucket head */
+	struct radix_heap_bucket_t bucket[RADIX_HEAP_BUCKETS];
+};
+
+
+
+
+/* Private Methods */
+
+/* bucket of a key: 0 if it equals the last minimum, otherwise one plus the
+ * highest bit in which they differ */
+static inline int radix_heap_bucket(long long last, long long value)
+{
+	if (value == last)
+		return 0;
+	return 64 - __builtin_clzll((unsigned long long) (value ^ last));
+}
+
+
+/* append an element to a bucket */
+static int radix_heap_push(struct radix_heap_bucket_t *bucket, long long value, void *data)
+{
+	struct radix_heap_elem_t *nelem;
+	int nsize;
+
+	if (bucket->tail == bucket->size) {
+
+		/* reuse the space of extracted elements before growing */
+		if (bucket->head > bucket->size / 2) {
+			memmove(bucket->elem, bucket->elem + bucket->head,
+				(bucket->tail - bucket->head) * sizeof(struct radix_heap_elem_t));
+			bucket->tail -= bucket->head;
+			bucket->head = 0;
+		} else {
+			nsize = bucket->size ? bucket->size * 2 : 16;
+			nelem = realloc(bucket->elem, nsize * sizeof(struct radix_heap_elem_t));
+			if (!nelem)
+				return 0;
+			bucket->elem = nelem;
+			bucket->size = nsize;
+		}
+	}
+	bucket->elem[bucket->tail].value = value;
+	bucket->elem[bucket->tail].data = data;
+	bucket->tail++;
+	return 1;
+}
+
+
+/* make bucket 0 non-empty: the lowest non-empty bucket gives the new
+ * minimum and its elements go to lower buckets, in order, so that equal
+ * keys keep their insertion order */
+static int radix_heap_refill(struct radix_heap_t *heap)
+{
+	struct radix_heap_bucket_t *bucket;
+	struct radix_heap_elem_t *elem;
+	long long min;
+	int b, i;
+
+	for (b = 1; heap->bucket[b].head == heap->bucket[b].tail; b++);
+	bucket = &heap->bucket[b];
+	min = bucket->elem[bucket->head].value;
+	for (i = bucket->head + 1; i < bucket->tail; i++)
+		if (bucket->elem[i].value < min)
+			min = bucket->elem[i].value;
+
+	heap->last = min;
+	for (i = bucket->head; i < bucket->tail; i++) {
+		elem = &bucket->elem[i];
+		if (!radix_heap_push(&heap->bucket[radix_heap_bucket(min, elem->value)], elem->value, elem->data))
+			return 0;
+	}
+	bucket->head = bucket->tail = 0;
+	return 1;
+}
+
+
+
+
+/* Public Methods */
+
+/* creation */
+struct radix_heap_t *radix_heap_create(void)
+{
+	struct radix_heap_t *heap = calloc(1, sizeof(struct radix_heap_t));
+
+	if (heap)
+		heap->peek_bucket = -1;
+	return heap;
+}
+
+
+/* destruction */
+void radix_heap_free(struct radix_heap_t *heap)
+{
+	int b;
+
+	for (b = 0; b < RADIX_HEAP_BUCKETS; b++)
+		free(heap->bucket[b].elem);
+	free(heap);
+}
+
+
+/* error messages */
+int radix_heap_error(struct radix_heap_t *heap)
+{
+	return heap->error;
+}
+
+
+char *radix_heap_error_msg(struct radix_heap_t *heap)
+{
+	switch (heap->error) {
+	case RADIX_HEAP_ENOMEM: return "out of memory";
+	case RADIX_HEAP_EEMPTY: return "radix heap is empty";
+	case RADIX_HEAP_EMONOTONE: return "key smaller than the last minimum";
+	}
+	return "";
+}
+
+
+int radix_heap_count(struct radix_heap_t *heap)
+{
+	return heap->count;
+}
+
+
+void radix_heap_insert(struct radix_heap_t *heap, long long value, void *data)
+{
+	struct radix_heap_bucket_t *bucket;
+
+	/* an empty heap accepts smaller keys too, starting over from them */
+	if (!heap->count && value < heap->last)
+		heap->last = value;
+	else if (value < heap->last) {
+		heap->error = RADIX_HEAP_EMONOTONE;
+		return;
+	}
+
+	bucket = &heap->bucket[radix_heap_bucket(heap->last, value)];
+	if (!radix_heap_push(bucket, value, data)) {
+		heap->error = RADIX_HEAP_ENOMEM;
+		return;
+	}
+
+	/* a smaller key becomes the known minimum; an equal one goes after it */
+	if (heap->peek_bucket >= 0 && value < radix_heap_peek(heap, NULL)) {
+		heap->peek_bucket = bucket - heap->bucket;
+		heap->peek_offset = bucket->tail - 1 - bucket->head;
+	}
+	heap->count++;
+	heap->error = 0;
+}
+
+
+void radix_heap_floor(struct radix_heap_t *heap, long long value)
+{
+	if (heap->count) {
+		heap->error = RADIX_HEAP_EMONOTONE;
+		return;
+	}
+	heap->last = value;
+	heap->error = 0;
+}
+
+
+/* the minimum does not move the heap forward, so keys between the last
+ * extracted minimum and the current one can still be inserted afterwards;
+ * its position is remembered until the next extraction */
+long long radix_heap_peek(struct radix_heap_t *heap, void **data)
+{
+	struct radix_heap_bucket_t *bucket;
+	int b, i, min;
+
+	/* heap empty */
+	if (!heap->count) {
+		heap->error = RADIX_HEAP_EEMPTY;
+		if (data)
+			*data = NULL;
+		return 0;
+	}
+
+	if (heap->peek_bucket >= 0) {
+		bucket = &heap->bucket[heap->peek_bucket];
+		min = bucket->head + heap->peek_offset;
+		if (data)
+			*data = bucket->elem[min].data;
+		heap->error = 0;
+		return bucket->elem[min].value;
+	}
+
+	/* the first of the smallest keys of the lowest non-empty bucket */
+	for (b = 0; heap->bucket[b].head == heap->bucket[b].tail; b++);
+	bucket = &heap->bucket[b];
+	min = bucket->head;
+	for (i = bucket->head + 1; b && i < bucket->tail; i++)
+		if (bucket->elem[i].value < bucket->elem[min].value)
+			min = i;
+	heap->peek_bucket = b;
+	heap->peek_offset = min - bucket->head;
+	if (data)
+		*data = bucket->elem[min].data;
+	heap->error = 0;
+	return bucket->elem[min].value;
+}
+
+
+long long radix_heap_extract(struct radix_heap_t *heap, void **data)
+{
+	struct radix_heap_bucket_t *bucket = &heap->bucket[0];
+
+	/* heap empty */
+	if (!heap->count) {
+		heap->error = RADIX_HEAP_EEMPTY;
+		if (data)
+			*data = NULL;
+		return 0;
+	}
+
+	/* minimum */
+	if (bucket->head == bucket->tail && !radix_heap_refill(heap)) {
+		heap->error = RADIX_HEAP_ENOMEM;
+		return 0;
+	}
+	if (data)
+		*data = bucket->elem[bucket->head].data;
+
+	/* delete element */
+	heap->peek_bucket = -1;
+	bucket->head++;
+	if (bucket->head == bucket->tail)
+		bucket->head = bucket->tail = 0;
+	heap->count--;
+	heap->error = 0;
+	return heap->last;
+}
+
+
+/* extract every element whose key equals the minimum, up to 'size', in
+ * insertion order; they are exactly the contents of bucket 0 */
+int radix_heap_extract_min_all(struct radix_heap_t *heap, long long *value, void **data, int size)
+{
+	struct radix_heap_bucket_t *bucket = &heap->bucket[0];
+	int count;
+
+	/* heap empty */
+	if (!heap->count) {
+		heap->error = RADIX_HEAP_EEMPTY;
+		return 0;
+	}
+
+	/* minimum */
+	if (bucket->head == bucket->tail && !radix_heap_refill(heap)) {
+		heap->error = RADIX_HEAP_ENOMEM;
+		return 0;
+	}
+	if (value)
+		*value = heap->last;
+
+	/* delete elements */
+	heap->peek_bucket = -1;
+	for (count = 0; count < size && bucket->head < bucket->tail; count++)
+		data[count] = bucket->elem[bucket->head++].data;
+	if (bucket->head == bucket->tail)
+		bucket->head = bucket->tail = 0;
+	heap->count -= count;
+	heap->error = 0;
+	return count;
+}
+
+
+void radix_heap_iter_init(const struct radix_heap_t *heap, struct radix_heap_iter_t *iter)
+{
+	iter->bucket = 0;
+	iter->index = heap->bucket[0].head;
+}
+
+
+int radix_heap_iter_next(const struct radix_heap_t *heap, struct radix_heap_iter_t *iter, long long *value, void **data)
+{
+	const struct radix_heap_bucket_t *bucket;
+
+	/* skip to the next element */
+	while (iter->bucket < RADIX_HEAP_BUCKETS && iter->index >= heap->bucket[iter->bucket].tail) {
+		iter->bucket++;
+		if (iter->bucket < RADIX_HEAP_BUCKETS)
+			iter->index = heap->bucket[iter->bucket].head;
+	}
+	if (iter->bucket == RADIX_HEAP_BUCKETS)
+		return 0;
+
+	/* return element and advance */
+	bucket = &heap->bucket[iter->bucket];
+	if (value)
+		*value = bucket->elem[iter->index].value;
+	if (data)
+		*data = bucket->elem[iter->index].data;
+	iter->index++;
+	return 1;
+}
@@ -0,0 +1,52 @@
+#ifndef RADIX_HEAP_H
+#define RADIX_HEAP_H
+
+/* error constants */
+#define RADIX_HEAP_ENOMEM	1
+#define RADIX_HEAP_EEMPTY	2
+#define RADIX_HEAP_EMONOTONE	3
+
+/* Radix heap: a priority queue for non-negative integer keys where no key
+ * smaller than the last extracted minimum is ever inserted (simulation
+ * time). Elements are kept in 65 buckets indexed by the highest bit in
+ * which their key differs from the last minimum; an element only moves to
+ * lower buckets, so operations are amortized O(log C) for keys spanning C.
+ * Elements with equal keys are extracted in insertion order (FIFO). */
+struct radix_heap_t;
+
+/* external cursor for radix heap enumeration (elements in storage order) */
+struct radix_heap_iter_t {
+	int bucket;
+	int index;
+};
+
+/* creation and destruction */
+struct radix_heap_t *radix_heap_create(void);
+void radix_heap_free(struct radix_heap_t *heap);
+
+/* return error occurred in last operation;
+ * 0 means success */
+int radix_heap_error(struct radix_heap_t *heap);
+char *radix_heap_error_msg(struct radix_heap_t *heap);
+
+/* radix heap operations; an empty heap accepts any key */
+int radix_heap_count(struct radix_heap_t *heap);
+void radix_heap_insert(struct radix_heap_t *heap, long long value, void *data);  /* EMONOTONE */
+long long radix_heap_extract(struct radix_heap_t *heap, void **data);  /* EEMPTY */
+long long radix_heap_peek(struct radix_heap_t *heap, void **data);  /* EEMPTY */
+
+/* set the smallest key an empty heap accepts from now on */
+void radix_heap_floor(struct radix_heap_t *heap, long long value);  /* EMONOTONE if not empty */
+int radix_heap_extract_min_all(struct radix_heap_t *heap, long long *value, void **data, int size);  /* EEMPTY */
+
+/* radix heap enumeration with an external cursor;
+ * radix_heap_iter_next returns 0 when there are no more elements */
+void radix_heap_iter_init(const struct radix_heap_t *heap, struct radix_heap_iter_t *iter);
+int radix_heap_iter_next(const struct radix_heap_t *heap, struct radix_heap_iter_t *iter, long long *value, void **data);
+
+#define RADIX_HEAP_ITER_FOR_EACH(heap, iter, value, data) \
+	for (radix_heap_iter_init((heap), &(iter)); \
+		radix_heap_iter_next((heap), &(iter), &(value), (void **) &(data)); )
+
+
+#endif
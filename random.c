@@ -13,6 +13,9 @@
 //    numeros.
 /*****************************************************************************/
 
+#include <string.h>
+#include "random.h"
+
 /* Define constantes del generador */
 
 static const long MODULO = 2147483647;
@@ -41,16 +44,29 @@ static long inicial[] =
   190641742,1645390429, 264907697, 620389253,1502074852, 927711160,
   364849192,2049576050, 638580085, 547070247 };
 
+/* Estado de partida de los streams, al que vuelve macsim_streams_restore */
+
+static long partida[MACSIM_STREAMS];
+
 /*****************************************************************************/
 //   Generador congruencial lineal multiplicativo de modulo primo
 //   Genera el siguiente numero aleatorio U(1,0)
 //   [LawKelton2000, pag. 430]
 
 double macsim_random(int stream)
+{
+    return macsim_random_r(&inicial[stream]);
+}
+
+/*****************************************************************************/
+//   Mismo generador sobre un estado propio del llamador, para modelos que
+//   necesitan más streams que los 101 predefinidos o usarlos desde varios hilos
+
+double macsim_random_r(long *state)
 {
     long zi, lowprd, hi31;
 
-    zi     = inicial[stream];
+    zi     = *state;
     lowprd = (zi & 65535) * MULT1;
     hi31   = (zi >> 16) * MULT1 + (lowprd >> 16);
     zi     = ((lowprd & 65535) - MODULO) +
@@ -61,7 +77,7 @@ double macsim_random(int stream)
     zi     = ((lowprd & 65535) - MODULO) +
              ((hi31 & 32767) << 16) + (hi31 >> 15);
     if (zi < 0) zi += MODULO;
-    inicial[stream] = zi;
+    *state = zi;
     return((zi >> 7 | 1) / 16777216.0);
 }
 
@@ -70,6 +86,7 @@ double macsim_random(int stream)
 void macsim_seed(long seed, int stream) 
 {
     inicial[stream] = seed;
+    partida[stream] = seed;
 }
 
 /*****************************************************************************/
@@ -78,3 +95,18 @@ long  macsim_stream_value(int stream)
 {
     return inicial[stream];
 }
+
+/*****************************************************************************/
+//   Guarda el estado actual de todos los streams como estado de partida
+//   (macsim_seed también cambia el estado de partida del stream)
+void macsim_streams_save()
+{
+    memcpy(partida, inicial, sizeof(partida));
+}
+
+/*****************************************************************************/
+//   Devuelve todos los streams a su estado de partida
+void macsim_streams_restore()
+{
+    memcpy(inicial, partida, sizeof(partida));
+}
@@ -1,8 +1,13 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#define MACSIM_STREAMS 101 //Número de streams del generador
+
 double macsim_random(int stream);
+double macsim_random_r(long *state);
 long macsim_stream_value(int stream);
 void macsim_seed(long seed, int stream); 
+void macsim_streams_save();
+void macsim_streams_restore();
 
 #endif /* RANDOM_H */
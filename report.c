@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "report.h"
+#include "debug.h"
+
+#define MACSIM_REPORT_BUFFER (1 << 16) //Buffer de stdio de los ficheros de resultados
+
+/* Ficheros de resultados para procesar con otras herramientas.
+ *
+ * Cada llamada a macsim_report_write añade los resultados de una ejecución (los que rellenan
+ * macsim_results o los motores de network.h) con el identificador que elija quien escribe,
+ * así que un mismo fichero puede juntar miles de ejecuciones. Los reales se escriben con
+ * 17 cifras significativas para que CSV y JSON no pierdan precisión respecto al binario.
+ * macsim_report_profile escribe de la misma forma la instrumentación de macsim_profile; en JSON
+ * las dos clases de filas pueden ir en un mismo fichero, pero un CSV lleva solo una (su cabecera
+ * se escribe con la primera fila) y el binario solo guarda estaciones. */
+
+/* Estructuras */
+struct macsim_report_t {
+	FILE *file;
+	int format; //enum macsim_report_format_enum
+	char *buffer; //Buffer de stdio
+	int rows; //Filas escritas: 0 ninguna, 1 estaciones, 2 instrumentación
+};
+
+
+/* Funciones */
+/* Función privada que escribe un nombre entre comillas, escapando lo que haga falta en CSV
+ * (comillas dobles) o en JSON (comillas, barras y caracteres de control) */
+static void macsim_report_string(FILE *f, const char *s, int json){
+	const unsigned char *c;
+
+	fputc('"', f);
+	for(c = (const unsigned char *) s; *c; c++){
+		if(*c == '"')
+			fputs(json ? "\\\"" : "\"\"", f);
+		else if(json && *c == '\\')
+			fputs("\\\\", f);
+		else if(json && *c < 0x20)
+			fprintf(f, "\\u%04x", *c);
+		else
+			fputc(*c, f);
+	}
+	fputc('"', f);
+}
+
+
+/* Crea un fichero de resultados en el formato \format (enum macsim_report_format_enum)
+ * @return El fichero o NULL si no se puede crear */
+struct macsim_report_t * macsim_report_open(const char *path, int format){
+	struct macsim_report_t *report;
+	struct macsim_report_header_t header;
+
+	if(format < MACSIM_REPORT_CSV || format > MACSIM_REPORT_BINARY)
+		fatal("%s: unknown format %d", __func__, format);
+	report = (struct macsim_report_t *) calloc(1, sizeof(struct macsim_report_t));
+	if(!report)
+		fatal("%s: out of memory", __func__);
+	report->format = format;
+	report->file = fopen(path, format == MACSIM_REPORT_BINARY ? "wb" : "w");
+	if(!report->file){
+		free(report);
+		return NULL;
+	}
+	report->buffer = (char *) malloc(MACSIM_REPORT_BUFFER);
+	if(!report->buffer)
+		fatal("%s: out of memory", __func__);
+	setvbuf(report->file, report->buffer, _IOFBF, MACSIM_REPORT_BUFFER);
+
+	if(format == MACSIM_REPORT_BINARY){
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MACSIM_REPORT_MAGIC, sizeof(header.magic));
+		header.version = MACSIM_REPORT_VERSION;
+		header.record_size = sizeof(struct macsim_report_record_t);
+		if(fwrite(&header, sizeof(header), 1, report->file) != 1)
+			fatal("%s: can't write \"%s\"", __func__, path);
+	}
+	return report;
+}
+
+
+/* Añade los resultados de las \count estaciones de la ejecución \run */
+void macsim_report_write(struct macsim_report_t *report, long long run, const struct macsim_result_t *results, int count){
+	struct macsim_report_record_t record;
+	const struct macsim_result_t *r;
+	int k;
+
+	if(report->format == MACSIM_REPORT_CSV && report->rows == 2)
+		fatal("%s: a CSV file holds either station or profile rows", __func__);
+	if(report->format == MACSIM_REPORT_CSV && !report->rows)
+		fprintf(report->file, "run,station,service_time,response_time,queue_time,total_clients,mean_clients,throughput,utilization\n");
+	report->rows = 1;
+	for(k = 0; k < count; k++){
+		r = &results[k];
+		switch(report->format){
+		case MACSIM_REPORT_CSV:
+			fprintf(report->file, "%lld,", run);
+			macsim_report_string(report->file, r->name ? r->name : "", 0);
+			fprintf(report->file, ",%.17g,%.17g,%.17g,%lld,%.17g,%.17g,%.17g\n", r->service_time, r->response_time,
+				r->queue_time, r->total_clients, r->mean_clients, r->throughput, r->utilization);
+			break;
+		case MACSIM_REPORT_JSON:
+			fprintf(report->file, "{\"run\":%lld,\"station\":", run);
+			macsim_report_string(report->file, r->name ? r->name : "", 1);
+			fprintf(report->file, ",\"service_time\":%.17g,\"response_time\":%.17g,\"queue_time\":%.17g,\"total_clients\":%lld,"
+				"\"mean_clients\":%.17g,\"throughput\":%.17g,\"utilization\":%.17g}\n", r->service_time, r->response_time,
+				r->queue_time, r->total_clients, r->mean_clients, r->throughput, r->utilization);
+			break;
+		default:
+			memset(&record, 0, sizeof(record));
+			record.run = run;
+			record.total_clients = r->total_clients;
+			record.service_time = r->service_time;
+			record.response_time = r->response_time;
+			record.queue_time = r->queue_time;
+			record.mean_clients = r->mean_clients;
+			record.throughput = r->throughput;
+			record.utilization = r->utilization;
+			if(r->name)
+				strncpy(record.name, r->name, sizeof(record.name) - 1);
+			if(fwrite(&record, sizeof(record), 1, report->file) != 1)
+				fatal("%s: write error", __func__);
+		}
+	}
+}
+
+
+/* Añade las \count filas de macsim_profile de la ejecución \run */
+void macsim_report_profile(struct macsim_report_t *report, long long run, const struct macsim_profile_entry_t *entries, int count){
+	const struct macsim_profile_entry_t *e;
+	int k;
+
+	if(report->format == MACSIM_REPORT_BINARY)
+		fatal("%s: the binary format only holds station results", __func__);
+	if(report->format == MACSIM_REPORT_CSV && report->rows == 1)
+		fatal("%s: a CSV file holds either station or profile rows", __func__);
+	if(report->format == MACSIM_REPORT_CSV && !report->rows)
+		fprintf(report->file, "run,metric,name,time,count,value\n");
+	report->rows = 2;
+	for(k = 0; k < count; k++){
+		e = &entries[k];
+		fprintf(report->file, report->format == MACSIM_REPORT_CSV ? "%lld,%s," : "{\"run\":%lld,\"metric\":\"%s\",\"name\":", run, e->metric);
+		macsim_report_string(report->file, e->name, report->format == MACSIM_REPORT_JSON);
+		fprintf(report->file, report->format == MACSIM_REPORT_CSV ? ",%.17g,%lld,%.17g\n" : ",\"time\":%.17g,\"count\":%lld,\"value\":%.17g}\n",
+			e->time, e->count, e->value);
+	}
+}
+
+
+/* Cierra el fichero de resultados */
+void macsim_report_close(struct macsim_report_t *report){
+	if(fclose(report->file))
+		fatal("%s: write error", __func__);
+	free(report->buffer);
+	free(report);
+}
+
+
+/* Devuelve el formato que corresponde a la extensión de \path: .csv, .json o .jsonl y .bin;
+ * cualquier otra es un error */
+int macsim_report_format(const char *path){
+	const char *ext = strrchr(path, '.');
+
+	if(ext && !strcmp(ext, ".csv"))
+		return MACSIM_REPORT_CSV;
+	if(ext && (!strcmp(ext, ".json") || !strcmp(ext, ".jsonl")))
+		return MACSIM_REPORT_JSON;
+	if(ext && !strcmp(ext, ".bin"))
+		return MACSIM_REPORT_BINARY;
+	fatal("%s: unknown extension in \"%s\" (.csv, .json, .jsonl or .bin)", __func__, path);
+}
+
+
+/* Lee todos los registros de un fichero binario de resultados
+ * @return Los registros (se liberan con free) o NULL si no se puede abrir el fichero */
+struct macsim_report_record_t * macsim_report_load(const char *path, int *count){
+	struct macsim_report_header_t header;
+	struct macsim_report_record_t *records;
+	FILE *f;
+	long size;
+
+	f = fopen(path, "rb");
+	if(!f)
+		return NULL;
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, MACSIM_REPORT_MAGIC, sizeof(header.magic)) ||
+			header.version != MACSIM_REPORT_VERSION || header.record_size != sizeof(struct macsim_report_record_t))
+		fatal("%s: \"%s\" is not a report file", __func__, path);
+	if(fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 || fseek(f, sizeof(header), SEEK_SET))
+		fatal("%s: can't read \"%s\"", __func__, path);
+	size = (size - sizeof(header)) / sizeof(struct macsim_report_record_t);
+
+	records = (struct macsim_report_record_t *) malloc((size ? size : 1) * sizeof(struct macsim_report_record_t));
+	if(!records)
+		fatal("%s: out of memory", __func__);
+	if(fread(records, sizeof(struct macsim_report_record_t), size, f) != (size_t) size)
+		fatal("%s: can't read \"%s\"", __func__, path);
+	fclose(f);
+	*count = size;
+	return records;
+}
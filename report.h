@@ -0,0 +1,47 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "macsim.h"
+
+#define MACSIM_REPORT_MAGIC "MACSIMRP"
+#define MACSIM_REPORT_VERSION 1
+#define MACSIM_REPORT_NAME 48 //Bytes del nombre de la estación en el formato binario (se trunca)
+
+/* Formatos de los ficheros de resultados */
+enum macsim_report_format_enum {
+	MACSIM_REPORT_CSV = 0, //Una línea por estación y ejecución, con cabecera
+	MACSIM_REPORT_JSON, //JSON lines: un objeto por estación y ejecución
+	MACSIM_REPORT_BINARY //Cabecera y registros macsim_report_record_t de tamaño fijo
+};
+
+/* Cabecera del fichero binario */
+struct macsim_report_header_t {
+	char magic[8]; //MACSIM_REPORT_MAGIC
+	int version; //MACSIM_REPORT_VERSION
+	int record_size; //sizeof(struct macsim_report_record_t)
+};
+
+/* Registro del fichero binario: los resultados de una estación en una ejecución */
+struct macsim_report_record_t {
+	long long run; //Identificador de la ejecución que da quien escribe
+	long long total_clients;
+	double service_time; //ms
+	double response_time; //ms
+	double queue_time; //ms
+	double mean_clients;
+	double throughput; //Clientes/ms
+	double utilization;
+	char name[MACSIM_REPORT_NAME]; //Terminado en 0
+};
+
+struct macsim_report_t;
+
+/* Prototipos */
+struct macsim_report_t * macsim_report_open(const char *path, int format);
+void macsim_report_write(struct macsim_report_t *report, long long run, const struct macsim_result_t *results, int count);
+void macsim_report_profile(struct macsim_report_t *report, long long run, const struct macsim_profile_entry_t *entries, int count);
+void macsim_report_close(struct macsim_report_t *report);
+int macsim_report_format(const char *path);
+struct macsim_report_record_t * macsim_report_load(const char *path, int *count);
+
+#endif /* REPORT_H */
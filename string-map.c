@@ -0,0 +1,448 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string-map.h"
+#include "debug.h"
+
+
+#define STRING_MAP_MIN_INITIAL_SIZE  8
+#define STRING_MAP_INLINE_KEY  16  /* keys up to 15 characters are not allocated */
+
+
+
+
+/*
+ * String Map Element
+ */
+
+/* The key is either stored inline or in a heap buffer pointed to by 'ext.ptr';
+ * the last byte tells them apart (always 0 for inline keys). */
+struct string_map_elem_t
+{
+	unsigned long long hash;
+	void *data;
+	union
+	{
+		char buf[STRING_MAP_INLINE_KEY];
+		struct
+		{
+			char *ptr;
+			char pad[STRING_MAP_INLINE_KEY - sizeof(char *) - 1];
+			char external;
+		} ext;
+	} key;
+};
+
+
+static char *string_map_elem_key(const struct string_map_elem_t *elem)
+{
+	return elem->key.ext.external ? elem->key.ext.ptr : (char *) elem->key.buf;
+}
+
+
+static void string_map_elem_set_key(struct string_map_elem_t *elem, const char *key)
+{
+	int len = strlen(key);
+
+	if (len < STRING_MAP_INLINE_KEY)
+	{
+		memcpy(elem->key.buf, key, len + 1);
+		elem->key.ext.external = 0;
+		return;
+	}
+	elem->key.ext.ptr = strdup(key);
+	if (!elem->key.ext.ptr)
+		fatal("%s: out of memory", __FUNCTION__);
+	elem->key.ext.external = 1;
+}
+
+
+static void string_map_elem_free_key(struct string_map_elem_t *elem)
+{
+	if (elem->key.ext.external)
+		free(elem->key.ext.ptr);
+}
+
+
+
+
+/*
+ * String Map
+ */
+
+/* Slot of the open-addressing index: low 32 bits of the hash and position of
+ * the element in the dense vector, plus one (0 = empty slot) */
+struct string_map_slot_t
+{
+	unsigned int hash;
+	int elem;
+};
+
+struct string_map_t
+{
+	int count;
+	int size;  /* slots, power of 2 */
+	int case_sensitive;
+
+	int find_op;
+	int find_index;
+
+	struct string_map_slot_t *slot_vector;
+	struct string_map_elem_t *elem_vector;  /* dense, 'count' elements in insertion order */
+
+	int (*str_compare_func)(const char *, const char *);
+};
+
+
+/* FNV-1a over the key, followed by a 64-bit finalizer so that the low bits
+ * used to pick the slot depend on every character. */
+static unsigned long long string_map_hash(struct string_map_t *map, const char *key)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	const unsigned char *c;
+
+	if (map->case_sensitive)
+	{
+		for (c = (const unsigned char *) key; *c; c++)
+			hash = (hash ^ *c) * 0x100000001b3ULL;
+	}
+	else
+	{
+		for (c = (const unsigned char *) key; *c; c++)
+			hash = (hash ^ tolower(*c)) * 0x100000001b3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+
+/* Distance from the slot where an element would ideally be */
+static int string_map_distance(struct string_map_t *map, unsigned int hash, int index)
+{
+	return (index - (int) (hash & (map->size - 1))) & (map->size - 1);
+}
+
+
+/* Place a slot whose key is not in the map (Robin Hood: an element that is
+ * further from its ideal slot takes the place of a closer one) */
+static void string_map_place(struct string_map_t *map, struct string_map_slot_t slot)
+{
+	struct string_map_slot_t tmp;
+	int index;
+	int dist;
+
+	index = slot.hash & (map->size - 1);
+	for (dist = 0; ; dist++, index = (index + 1) & (map->size - 1))
+	{
+		if (!map->slot_vector[index].elem)
+		{
+			map->slot_vector[index] = slot;
+			return;
+		}
+		if (string_map_distance(map, map->slot_vector[index].hash, index) < dist)
+		{
+			tmp = map->slot_vector[index];
+			map->slot_vector[index] = slot;
+			slot = tmp;
+			dist = string_map_distance(map, slot.hash, index);
+		}
+	}
+}
+
+
+/* Allocate a new index of 'size' slots and place all elements in it.
+ * Hashes are not recomputed. */
+static void string_map_resize(struct string_map_t *map, int size)
+{
+	struct string_map_slot_t slot;
+	int i;
+
+	/* Allocate new index and dense vector (load factor up to 7/8) */
+	free(map->slot_vector);
+	map->size = size;
+	map->slot_vector = calloc(map->size, sizeof(struct string_map_slot_t));
+	map->elem_vector = realloc(map->elem_vector, (map->size / 8 * 7) * sizeof(struct string_map_elem_t));
+	if (!map->slot_vector || !map->elem_vector)
+		fatal("%s: out of memory", __FUNCTION__);
+
+	/* Index elements */
+	for (i = 0; i < map->count; i++)
+	{
+		slot.hash = map->elem_vector[i].hash;
+		slot.elem = i + 1;
+		string_map_place(map, slot);
+	}
+}
+
+
+/* Return the slot of a key, or -1 if it is not in the map */
+static int string_map_find(struct string_map_t *map, const char *key)
+{
+	struct string_map_slot_t *slot;
+	struct string_map_elem_t *elem;
+	unsigned long long hash;
+	int index;
+	int dist;
+
+	hash = string_map_hash(map, key);
+	index = hash & (map->size - 1);
+	for (dist = 0; ; dist++, index = (index + 1) & (map->size - 1))
+	{
+		slot = &map->slot_vector[index];
+
+		/* An element closer to its slot than we are means the key is not here */
+		if (!slot->elem || string_map_distance(map, slot->hash, index) < dist)
+			return -1;
+		if (slot->hash != (unsigned int) hash)
+			continue;
+		elem = &map->elem_vector[slot->elem - 1];
+		if (elem->hash == hash && !map->str_compare_func(key, string_map_elem_key(elem)))
+			return index;
+	}
+}
+
+
+struct string_map_t *string_map_create(int size, int case_sensitive)
+{
+	struct string_map_t *map;
+	int slots;
+
+	/* Create */
+	map = calloc(1, sizeof(struct string_map_t));
+	if (!map)
+		fatal("%s: out of memory", __FUNCTION__);
+
+	/* Assign fields */
+	map->case_sensitive = case_sensitive;
+	map->str_compare_func = case_sensitive ? strcmp : strcasecmp;
+
+	/* Index and vector of elements */
+	for (slots = STRING_MAP_MIN_INITIAL_SIZE; slots < size; slots *= 2);
+	string_map_resize(map, slots);
+
+	/* Return */
+	return map;
+}
+
+
+void string_map_free(struct string_map_t *map)
+{
+	/* Clear map */
+	string_map_clear(map);
+
+	/* Free vectors and map */
+	free(map->slot_vector);
+	free(map->elem_vector);
+	free(map);
+}
+
+
+void string_map_clear(struct string_map_t *map)
+{
+	int i;
+
+	/* No find operation */
+	map->find_op = 0;
+
+	/* Free keys */
+	for (i = 0; i < map->count; i++)
+		string_map_elem_free_key(&map->elem_vector[i]);
+	memset(map->slot_vector, 0, map->size * sizeof(struct string_map_slot_t));
+
+	/* Reset count */
+	map->count = 0;
+}
+
+
+int string_map_insert(struct string_map_t *map, const char *key, void *data)
+{
+	struct string_map_elem_t *elem;
+	struct string_map_slot_t slot;
+
+	/* No find operation */
+	map->find_op = 0;
+
+	/* Data cannot be null */
+	if (!data)
+		return 0;
+
+	/* Element must not exist */
+	if (string_map_find(map, key) >= 0)
+		return 0;
+
+	/* Rehashing: keep the load factor under 7/8 */
+	if (map->count == map->size / 8 * 7)
+		string_map_resize(map, map->size * 2);
+
+	/* Create element at the end of the dense vector and index it */
+	elem = &map->elem_vector[map->count];
+	memset(elem, 0, sizeof(struct string_map_elem_t));
+	elem->hash = string_map_hash(map, key);
+	elem->data = data;
+	string_map_elem_set_key(elem, key);
+	slot.hash = elem->hash;
+	slot.elem = map->count + 1;
+	string_map_place(map, slot);
+
+	/* One more element */
+	map->count++;
+	assert(map->count < map->size);
+
+	/* Success */
+	return 1;
+}
+
+
+int string_map_set(struct string_map_t *map, const char *key, void *data)
+{
+	int index;
+
+	/* Data cannot be null */
+	if (!data)
+		return 0;
+
+	/* Find element */
+	index = string_map_find(map, key);
+	if (index < 0)
+		return 0;
+
+	/* Set new data, success */
+	map->elem_vector[map->slot_vector[index].elem - 1].data = data;
+	return 1;
+}
+
+
+int string_map_count(struct string_map_t *map)
+{
+	return map->count;
+}
+
+
+void *string_map_get(struct string_map_t *map, const char *key)
+{
+	int index;
+
+	/* Find element */
+	index = string_map_find(map, key);
+	if (index < 0)
+		return NULL;
+
+	/* Return data */
+	return map->elem_vector[map->slot_vector[index].elem - 1].data;
+}
+
+
+void *string_map_remove(struct string_map_t *map, const char *key)
+{
+	struct string_map_elem_t *elem;
+	void *data;
+	int index;
+	int next;
+	int pos;
+
+	/* No find operation */
+	map->find_op = 0;
+
+	/* Find element */
+	index = string_map_find(map, key);
+	if (index < 0)
+		return NULL;
+
+	/* Free element */
+	pos = map->slot_vector[index].elem - 1;
+	elem = &map->elem_vector[pos];
+	data = elem->data;
+	string_map_elem_free_key(elem);
+
+	/* Backward shift: move back the following slots that are not in their
+	 * ideal position, so no tombstones are needed */
+	for (next = (index + 1) & (map->size - 1);
+		map->slot_vector[next].elem && string_map_distance(map, map->slot_vector[next].hash, next);
+		index = next, next = (next + 1) & (map->size - 1))
+		map->slot_vector[index] = map->slot_vector[next];
+	memset(&map->slot_vector[index], 0, sizeof(struct string_map_slot_t));
+
+	/* Keep the vector dense: the last element takes the place of the removed one */
+	assert(map->count > 0);
+	map->count--;
+	if (pos != map->count)
+	{
+		*elem = map->elem_vector[map->count];
+		for (index = elem->hash & (map->size - 1); map->slot_vector[index].elem != map->count + 1;
+			index = (index + 1) & (map->size - 1));
+		map->slot_vector[index].elem = pos + 1;
+	}
+
+	/* Return associated data */
+	return data;
+}
+
+
+char *string_map_find_first(struct string_map_t *map, void **data_ptr)
+{
+	/* Record find operation */
+	map->find_op = 1;
+	map->find_index = -1;
+
+	/* Find first element */
+	return string_map_find_next(map, data_ptr);
+}
+
+
+char *string_map_find_next(struct string_map_t *map, void **data_ptr)
+{
+	struct string_map_elem_t *elem;
+
+	if (data_ptr)
+		*data_ptr = NULL;
+
+	/* Not allowed if a find_first operation has not been done */
+	if (!map->find_op)
+		return NULL;
+
+	/* No more elements */
+	if (++map->find_index >= map->count)
+	{
+		map->find_op = 0;
+		return NULL;
+	}
+
+	/* Next element of the dense vector */
+	elem = &map->elem_vector[map->find_index];
+	if (data_ptr)
+		*data_ptr = elem->data;
+	return string_map_elem_key(elem);
+}
+
+
+char *string_map_iter_first(const struct string_map_t *map, struct string_map_iter_t *iter, void **data_ptr)
+{
+	/* Position before the first element */
+	iter->index = -1;
+	return string_map_iter_next(map, iter, data_ptr);
+}
+
+
+char *string_map_iter_next(const struct string_map_t *map, struct string_map_iter_t *iter, void **data_ptr)
+{
+	const struct string_map_elem_t *elem;
+
+	/* No more elements */
+	if (++iter->index >= map->count)
+	{
+		iter->index = map->count;
+		if (data_ptr)
+			*data_ptr = NULL;
+		return NULL;
+	}
+
+	/* Next element of the dense vector */
+	elem = &map->elem_vector[iter->index];
+	if (data_ptr)
+		*data_ptr = elem->data;
+	return string_map_elem_key(elem);
+}
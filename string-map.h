@@ -0,0 +1,84 @@
+#ifndef STRING_MAP_H
+#define STRING_MAP_H
+
+struct string_map_t;
+
+/* External cursor for string_map_iter_first/next. It lives in the caller, so
+ * iterations can be nested or run from several threads as long as the map
+ * is not modified meanwhile. */
+struct string_map_iter_t
+{
+	int index;
+};
+
+/** Iterate through all elements of the string map.
+ *
+ * @param map
+ * @param key
+ * @param data
+ */
+#define STRING_MAP_FOR_EACH(map, key, data) \
+	for ((key) = string_map_find_first((map), (void **) &(data)); \
+		(key); \
+		(key) = string_map_find_next((map), (void **) &(data)))
+
+
+/** Iterate through all elements of the string map with an external cursor,
+ * without modifying the map.
+ *
+ * @param map
+ * @param iter  variable of type 'struct string_map_iter_t'
+ * @param key
+ * @param data
+ */
+#define STRING_MAP_ITER_FOR_EACH(map, iter, key, data) \
+	for ((key) = string_map_iter_first((map), &(iter), (void **) &(data)); \
+		(key); \
+		(key) = string_map_iter_next((map), &(iter), (void **) &(data)))
+
+
+/* Creation and destruction.
+ * Same interface as hash_table_t, but elements live in a dense vector indexed by
+ * an open-addressing table (Robin Hood hashing). The 64-bit hash of every key is
+ * kept, so lookups compare hashes before touching the key and growing the table
+ * never rehashes strings. Keys of up to 15 characters are stored inside the element.
+ * Iteration walks the dense vector; removing an element moves the last one to its place. */
+struct string_map_t *string_map_create(int size, int case_sensitive);
+void string_map_free(struct string_map_t *map);
+
+/* Delete all elements */
+void string_map_clear(struct string_map_t *map);
+
+/* Insert a new element.
+ * The key is copied, so it can be freely modified by the caller.
+ * Return value: 1=success, 0=key already exists/data=NULL
+ */
+int string_map_insert(struct string_map_t *map, const char *key, void *data);
+
+/* Change element data.
+ * Return value: 1=success, 0=key does not exist/data=NULL
+ */
+int string_map_set(struct string_map_t *map, const char *key, void *data);
+
+/* Return number of elements in the map. */
+int string_map_count(struct string_map_t *map);
+
+/* Get data associated to a key.
+ * Return value: NULL=key does not exist, ptr=data */
+void *string_map_get(struct string_map_t *map, const char *key);
+
+/* Remove data associated to a key; the key is freed.
+ * Return value: NULL=key does not exist, ptr=data removed */
+void *string_map_remove(struct string_map_t *map, const char *key);
+
+/* Find elements in the map sequentially.
+ * Return value: NULL=no more elements,
+ *   non-NULL=key (data returned in 'data' if not NULL) */
+char *string_map_find_first(struct string_map_t *map, void **data);
+char *string_map_find_next(struct string_map_t *map, void **data);
+
+/* Same, with the position kept in 'iter' instead of the map */
+char *string_map_iter_first(const struct string_map_t *map, struct string_map_iter_t *iter, void **data);
+char *string_map_iter_next(const struct string_map_t *map, struct string_map_iter_t *iter, void **data);
+
+#endif
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "sweep.h"
+#include "macsim.h"
+#include "debug.h"
+
+/* Barridos de parámetros: el mismo modelo se simula una vez por cada valor de una clave.
+ *
+ * Cada hilo trabaja sobre su propia copia del modelo y va tomando puntos del barrido; al
+ * cambiar la clave solo se vuelve a compilar la red. El motor sequential usa el estado global
+ * de la librería, así que si algún punto lo usa el barrido se hace en un solo hilo, con un único
+ * macsim_init y un macsim_reset por punto en vez de inicializar y liberar la librería cada vez. */
+
+struct macsim_sweep_worker_t {
+	struct macsim_sweep_t *sweep;
+	atomic_int *next; //Siguiente punto por simular
+	pthread_t thread;
+};
+
+
+/* Funciones */
+/* Función privada que devuelve el instante actual en segundos */
+static double macsim_sweep_now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Función privada que duplica una cadena */
+static char * macsim_sweep_strdup(const char *s){
+	char *copy = strdup(s);
+	if(!copy)
+		fatal("%s: out of memory", __func__);
+	return copy;
+}
+
+
+/* Crea un barrido vacío de la clave \key (con puntos, como en macsim_model_set) del modelo.
+ * El modelo no se modifica y debe existir mientras exista el barrido. */
+struct macsim_sweep_t * macsim_sweep_create(struct macsim_model_t *model, const char *key){
+	struct macsim_sweep_t *sweep = (struct macsim_sweep_t *) calloc(1, sizeof(struct macsim_sweep_t));
+	if(!sweep)
+		fatal("%s: out of memory", __func__);
+	sweep->model = model;
+	sweep->key = macsim_sweep_strdup(key);
+	return sweep;
+}
+
+
+/* Libera el barrido y sus resultados */
+void macsim_sweep_free(struct macsim_sweep_t *sweep){
+	struct macsim_sweep_point_t *point;
+	int i, k;
+
+	for(i = 0; i < sweep->count; i++){
+		point = &sweep->points[i];
+		for(k = 0; point->results && k < point->station_count; k++)
+			free((char *) point->results[k].name);
+		for(k = 0; point->class_results && k < point->class_count; k++)
+			free((char *) point->class_results[k].name);
+		free(point->results);
+		free(point->class_results);
+		free(point->value);
+	}
+	free(sweep->points);
+	free(sweep->key);
+	free(sweep);
+}
+
+
+/* Añade un punto al barrido: el valor que tomará la clave */
+void macsim_sweep_add(struct macsim_sweep_t *sweep, const char *value){
+	if(sweep->count == sweep->size){
+		sweep->size = sweep->size ? sweep->size * 2 : 16;
+		sweep->points = (struct macsim_sweep_point_t *) realloc(sweep->points, sweep->size * sizeof(struct macsim_sweep_point_t));
+		if(!sweep->points)
+			fatal("%s: out of memory", __func__);
+	}
+	memset(&sweep->points[sweep->count], 0, sizeof(struct macsim_sweep_point_t));
+	sweep->points[sweep->count++].value = macsim_sweep_strdup(value);
+}
+
+
+/* Añade \points valores equiespaciados entre \from y \to. Si el valor que tiene la clave en el
+ * modelo empieza por un nombre (una distribución, p.ej. "exponential 2"), lo que cambia es su
+ * primer parámetro y el resto se conserva. */
+void macsim_sweep_range(struct macsim_sweep_t *sweep, double from, double to, int points){
+	const char *current = macsim_model_get(sweep->model, sweep->key), *rest = "";
+	char value[512], prefix[64] = "";
+	int i, len;
+
+	if(points < 1)
+		fatal("%s: a sweep needs at least one point", __func__);
+	if(current && isalpha((unsigned char) *current)){
+		for(len = 0; current[len] && !isspace((unsigned char) current[len]) && len < (int) sizeof(prefix) - 2; len++)
+			prefix[len] = current[len];
+		prefix[len++] = ' ';
+		prefix[len] = 0;
+		rest = current + len - 1;
+		while(isspace((unsigned char) *rest))
+			rest++;
+		while(*rest && !isspace((unsigned char) *rest)) //Primer parámetro
+			rest++;
+	}
+	for(i = 0; i < points; i++){
+		snprintf(value, sizeof(value), "%s%.10g%s", prefix, points > 1 ? from + (to - from) * i / (points - 1) : from, rest);
+		macsim_sweep_add(sweep, value);
+	}
+}
+
+
+/* Función privada que simula un punto con la copia del modelo de un hilo */
+static void macsim_sweep_point(struct macsim_sweep_t *sweep, struct macsim_model_t *model, int i){
+	struct macsim_sweep_point_t *point = &sweep->points[i];
+	struct macsim_network_t *net;
+	double start;
+	int k;
+
+	macsim_model_set(model, sweep->key, point->value);
+	net = macsim_model_compile(model);
+	point->station_count = net->count;
+	point->class_count = model->engine == MACSIM_ENGINE_CLOSED ? net->class_count : 0;
+	point->results = (struct macsim_result_t *) calloc(net->count, sizeof(struct macsim_result_t));
+	point->class_results = (struct macsim_network_class_result_t *) calloc(net->class_count, sizeof(struct macsim_network_class_result_t));
+	if(!point->results || !point->class_results)
+		fatal("%s: out of memory", __func__);
+
+	start = macsim_sweep_now();
+	if(model->engine == MACSIM_ENGINE_SEQUENTIAL)
+		macsim_reset();
+	point->events = macsim_model_simulate(model, point->results, point->class_results);
+	point->seconds = macsim_sweep_now() - start;
+
+	/* Los nombres son del modelo, que cambia en el siguiente punto */
+	for(k = 0; k < point->station_count; k++)
+		point->results[k].name = macsim_sweep_strdup(point->results[k].name);
+	for(k = 0; k < point->class_count; k++)
+		point->class_results[k].name = macsim_sweep_strdup(point->class_results[k].name);
+}
+
+
+/* Función privada de cada hilo */
+static void * macsim_sweep_worker(void *arg){
+	struct macsim_sweep_worker_t *worker = (struct macsim_sweep_worker_t *) arg;
+	struct macsim_model_t *model = macsim_model_copy(worker->sweep->model);
+	int i;
+
+	while((i = atomic_fetch_add(worker->next, 1)) < worker->sweep->count)
+		macsim_sweep_point(worker->sweep, model, i);
+	macsim_model_free(model);
+	return NULL;
+}
+
+
+/* Simula todos los puntos del barrido repartiéndolos entre \threads hilos.
+ * Si algún punto usa el motor sequential, la librería no debe estar en uso: se inicializa y
+ * se libera aquí y el barrido se hace en el hilo que llama. */
+void macsim_sweep_run(struct macsim_sweep_t *sweep, int threads){
+	struct macsim_sweep_worker_t *workers;
+	struct macsim_model_t *model;
+	atomic_int next = 0;
+	int i, sequential = 0;
+	double start = macsim_sweep_now();
+
+	/* Comprobar los puntos antes de empezar, y qué motor usan */
+	model = macsim_model_copy(sweep->model);
+	for(i = 0; i < sweep->count; i++){
+		macsim_model_set(model, sweep->key, sweep->points[i].value);
+		macsim_model_compile(model);
+		if(model->engine == MACSIM_ENGINE_SEQUENTIAL)
+			sequential = 1;
+	}
+	macsim_model_free(model);
+
+	if(threads < 1 || sequential)
+		threads = 1;
+	if(threads > sweep->count)
+		threads = sweep->count ? sweep->count : 1;
+	workers = (struct macsim_sweep_worker_t *) calloc(threads, sizeof(struct macsim_sweep_worker_t));
+	if(!workers)
+		fatal("%s: out of memory", __func__);
+	for(i = 0; i < threads; i++){
+		workers[i].sweep = sweep;
+		workers[i].next = &next;
+	}
+
+	if(sequential)
+		macsim_init();
+	if(threads == 1)
+		macsim_sweep_worker(&workers[0]);
+	else{
+		for(i = 0; i < threads; i++){
+			if(pthread_create(&workers[i].thread, NULL, macsim_sweep_worker, &workers[i]))
+				fatal("%s: can't create thread", __func__);
+		}
+		for(i = 0; i < threads; i++)
+			pthread_join(workers[i].thread, NULL);
+	}
+	if(sequential)
+		macsim_exit();
+
+	free(workers);
+	sweep->seconds = macsim_sweep_now() - start;
+}
+
+
+/* Escribe los resultados de todos los puntos en una sola tabla, una fila por punto y estación,
+ * seguida de la de tiempos de ciclo por clase si alguno la tiene */
+void macsim_sweep_print(struct macsim_sweep_t *sweep, FILE *f){
+	struct macsim_sweep_point_t *point;
+	struct macsim_result_t *r;
+	double simulation = 0;
+	int i, k, classes = 0;
+
+	fprintf(f, "%-20s  %-20s  %-14s  %-14s  %-14s  %-14s  %-14s  %-14s\n", sweep->key, "Estación",
+		"T. servicio", "T. respuesta", "T. en cola", "Clientes", "Productividad", "Utilización");
+	for(i = 0; i < sweep->count; i++){
+		point = &sweep->points[i];
+		simulation += point->seconds;
+		classes += point->class_count;
+		for(k = 0; k < point->station_count; k++){
+			r = &point->results[k];
+			fprintf(f, "%-20s  %-20s  %-14.4f  %-14.4f  %-14.4f  %-14lld  %-14.4f  %-14.4f\n", point->value, r->name,
+				r->service_time, r->response_time, r->queue_time, r->total_clients, r->throughput, r->utilization);
+		}
+	}
+
+	if(classes){
+		fprintf(f, "\n%-20s  %-20s  %-14s  %-14s  %-14s\n", sweep->key, "Clase", "Ciclos", "T. de ciclo", "Productividad");
+		for(i = 0; i < sweep->count; i++){
+			point = &sweep->points[i];
+			for(k = 0; k < point->class_count; k++)
+				fprintf(f, "%-20s  %-20s  %-14lld  %-14.4f  %-14.4f\n", point->value, point->class_results[k].name,
+					point->class_results[k].cycles, point->class_results[k].cycle_time, point->class_results[k].throughput);
+		}
+	}
+
+	fprintf(f, "\n%d puntos en %.3f s (%.3f s simulando)\n", sweep->count, sweep->seconds, simulation);
+}
@@ -0,0 +1,35 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include "model.h"
+
+/* Estructuras */
+/* Resultados de un punto del barrido */
+struct macsim_sweep_point_t {
+	char *value; //Valor de la clave barrida
+	struct macsim_result_t *results; //Uno por estación
+	struct macsim_network_class_result_t *class_results; //Uno por clase
+	int station_count, class_count;
+	long long events; //Lo que devuelve macsim_model_simulate
+	double seconds; //Tiempo real de la simulación
+};
+
+/* Barrido de una clave de un modelo (ver model.h) sobre una lista de valores */
+struct macsim_sweep_t {
+	struct macsim_model_t *model;
+	char *key;
+	struct macsim_sweep_point_t *points;
+	int count, size;
+	double seconds; //Tiempo real de todo el barrido
+};
+
+/* Prototipos */
+struct macsim_sweep_t * macsim_sweep_create(struct macsim_model_t *model, const char *key);
+void macsim_sweep_free(struct macsim_sweep_t *sweep);
+void macsim_sweep_add(struct macsim_sweep_t *sweep, const char *value);
+void macsim_sweep_range(struct macsim_sweep_t *sweep, double from, double to, int points);
+void macsim_sweep_run(struct macsim_sweep_t *sweep, int threads);
+void macsim_sweep_print(struct macsim_sweep_t *sweep, FILE *f);
+
+#endif /* SWEEP_H */
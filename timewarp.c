@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "network.h"
+#include "heap.h"
+#include "debug.h"
+
+/* Motor paralelo optimista (Time Warp) para redes de colas.
+ *
+ * Como en el motor conservador (pdes.c), las estaciones se reparten en particiones contiguas
+ * y los eventos se ordenan por la clave 2t (fin de servicio) o 2t+1 (llegada). Aquí cada
+ * partición procesa sus eventos sin esperar a las demás. Si después le llega un cliente con
+ * una clave menor que la de algún evento ya procesado (un rezagado), deshace esos eventos:
+ * cada evento procesado guarda lo que cambió (el estado escalar de la estación, con sus
+ * estadísticas y la posición de sus streams, y el cliente que salió de la cola) y los eventos
+ * que generó. Los generados en la partición se marcan como cancelados y los enviados a otras se
+ * anulan con antimensajes que llevan el puntero del evento.
+ *
+ * Cada TW_BATCH eventos todos los hilos se sincronizan para calcular el GVT, la menor clave
+ * pendiente de la simulación. Cada partición solo se adelanta al GVT lo que le permite su
+ * ventana, que se ajusta según la proporción de eventos deshechos. Ningún evento anterior al GVT puede deshacerse, así que se liberan
+ * (fossil collection) y la memoria queda acotada por el tamaño del lote.
+ *
+ * Los resultados son los mismos que los de macsim_network_run. */
+
+#define TW_BATCH 4096 //Eventos que procesa cada partición entre dos cálculos del GVT
+#define TW_WINDOW 2000000 //Ventana optimista inicial (1 ms) en unidades de clave
+#define TW_RING_SIZE 4096 //Mensajes en cada canal (potencia de 2)
+#define TW_RING_MASK (TW_RING_SIZE - 1)
+
+/* Tipos de evento */
+#define TW_ARRIVE 0
+#define TW_DEPART 1
+#define TW_SOURCE 2
+
+/* Estados de un evento */
+#define TW_PENDING 0 //En la cola de eventos
+#define TW_PROCESSED 1 //En el registro de eventos procesados
+#define TW_CANCELLED 2 //En la cola de eventos pero anulado; se libera al extraerlo
+
+/* Estructuras */
+struct tw_client_t {
+	long long id;
+	long long entry; //Llegada a la estación
+};
+
+/* Estado escalar de una estación: lo que se guarda antes de procesar cada evento */
+struct tw_state_t {
+	long long server_entry; //Entrada en servicio del primer cliente
+	long service_stream, arrival_stream;
+	long long seq; //Llegadas externas generadas
+	long long clients, response, service; //Estadísticas en ns
+};
+
+struct tw_station_t {
+	struct tw_client_t *queue; //Cola circular; el primero es el que está en servicio
+	int queue_head, queue_count, queue_size;
+	struct tw_state_t state;
+};
+
+struct tw_event_t {
+	long long key;
+	long long client;
+	int station;
+	int kind;
+	int state; //TW_PENDING, TW_PROCESSED o TW_CANCELLED
+	int reserved;
+
+	/* Datos para deshacer el evento, válidos mientras está procesado */
+	long long prefix; //Mayor clave procesada hasta este evento, incluido
+	struct tw_state_t saved; //Estado de la estación antes del evento
+	struct tw_client_t popped; //Cliente que salió de la cola (TW_DEPART)
+	struct tw_event_t *children[2]; //Eventos generados
+};
+
+struct tw_message_t {
+	struct tw_event_t *event;
+	long long anti; //1 si es un antimensaje
+};
+
+/* Canal de una partición a otra */
+struct tw_channel_t {
+	_Alignas(64) atomic_ulong head; //Siguiente posición a escribir (emisor)
+	unsigned long cached_tail;
+	struct tw_message_t *overflow; //Mensajes que no caben en el canal, en orden (emisor)
+	int overflow_count, overflow_size;
+
+	_Alignas(64) atomic_ulong tail; //Siguiente posición a leer (receptor)
+
+	struct tw_message_t *messages; //TW_RING_SIZE mensajes
+};
+
+struct tw_engine_t;
+
+/* Partición: un proceso lógico ejecutado por un hilo */
+struct tw_lp_t {
+	struct tw_engine_t *engine;
+	int id;
+	struct heap_t *pending; //Eventos pendientes
+	struct tw_event_t **log; //Eventos procesados en orden de procesamiento
+	int log_head, log_count, log_size; //Los anteriores a log_head ya se han liberado
+	long long committed; //Mayor clave de los eventos liberados
+	struct tw_channel_t **inputs;
+	int input_count;
+	struct tw_channel_t **outputs; //Indexado por partición, NULL si no hay encaminamiento
+	long long rollbacks; //Eventos deshechos
+	pthread_t thread;
+};
+
+struct tw_engine_t {
+	struct macsim_network_t *net;
+	struct tw_station_t *stations;
+	int *partition; //Partición de cada estación
+	struct tw_lp_t *lps;
+	int count; //Número de particiones
+	struct tw_channel_t **channels; //count x count, NULL si no se usa
+	long long horizon; //Clave límite: se procesan las menores
+	long long *local_min; //Menor clave pendiente de cada partición, para el GVT
+	pthread_barrier_t barrier;
+};
+
+
+/* Funciones */
+static struct tw_event_t * tw_event_create(long long key, int kind, int station, long long client){
+	struct tw_event_t *event = (struct tw_event_t *) malloc(sizeof(struct tw_event_t));
+
+	if(!event)
+		fatal("%s: out of memory", __func__);
+	event->key = key;
+	event->client = client;
+	event->station = station;
+	event->kind = kind;
+	event->state = TW_PENDING;
+	event->children[0] = event->children[1] = NULL;
+	return event;
+}
+
+
+static void tw_insert(struct tw_lp_t *lp, struct tw_event_t *event){
+	heap_insert(lp->pending, event->key, event);
+	if(heap_error(lp->pending))
+		fatal("%s: %s", __func__, heap_error_msg(lp->pending));
+}
+
+
+/* Devuelve el siguiente evento pendiente sin extraerlo, liberando los cancelados que encuentre */
+static struct tw_event_t * tw_peek(struct tw_lp_t *lp){
+	struct tw_event_t *event;
+
+	while(heap_count(lp->pending)){
+		heap_peek(lp->pending, (void **) &event);
+		if(event->state != TW_CANCELLED)
+			return event;
+		heap_extract(lp->pending, NULL);
+		free(event);
+	}
+	return NULL;
+}
+
+
+/* Escribe un mensaje en el canal
+ * @return 0 si el canal está lleno */
+static int tw_ring_push(struct tw_channel_t *ch, const struct tw_message_t *message){
+	unsigned long head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+
+	if(head - ch->cached_tail == TW_RING_SIZE){
+		ch->cached_tail = atomic_load_explicit(&ch->tail, memory_order_acquire);
+		if(head - ch->cached_tail == TW_RING_SIZE)
+			return 0;
+	}
+	ch->messages[head & TW_RING_MASK] = *message;
+	atomic_store_explicit(&ch->head, head + 1, memory_order_release);
+	return 1;
+}
+
+
+/* Intenta pasar al canal los mensajes que no cupieron */
+static void tw_flush(struct tw_channel_t *ch){
+	int sent = 0;
+
+	while(sent < ch->overflow_count && tw_ring_push(ch, &ch->overflow[sent]))
+		sent++;
+	if(sent){
+		memmove(ch->overflow, ch->overflow + sent, (ch->overflow_count - sent) * sizeof(struct tw_message_t));
+		ch->overflow_count -= sent;
+	}
+}
+
+
+/* Envía un evento (o su antimensaje) a la partición de su estación. El emisor nunca espera:
+ * si el canal está lleno el mensaje se guarda hasta que haya sitio. A partir del envío
+ * el evento pertenece a la partición destino. */
+static void tw_send(struct tw_lp_t *lp, struct tw_event_t *event, int anti){
+	struct tw_channel_t *ch = lp->outputs[lp->engine->partition[event->station]];
+	struct tw_message_t message;
+
+	message.event = event;
+	message.anti = anti;
+	if(!ch->overflow_count && tw_ring_push(ch, &message))
+		return;
+
+	if(ch->overflow_count == ch->overflow_size){
+		ch->overflow_size = ch->overflow_size ? ch->overflow_size * 2 : TW_RING_SIZE;
+		ch->overflow = (struct tw_message_t *) realloc(ch->overflow, ch->overflow_size * sizeof(struct tw_message_t));
+		if(!ch->overflow)
+			fatal("%s: out of memory", __func__);
+	}
+	ch->overflow[ch->overflow_count++] = message;
+}
+
+
+/* Deshace un evento procesado: anula los eventos que generó y restaura la estación */
+static void tw_undo(struct tw_lp_t *lp, struct tw_event_t *event){
+	struct tw_station_t *s = &lp->engine->stations[event->station];
+	struct tw_event_t *child;
+	int i;
+
+	/* Los hijos locales se procesaron después que el padre, así que ya se han deshecho */
+	for(i = 0; i < 2; i++){
+		if(!(child = event->children[i]))
+			continue;
+		if(lp->engine->partition[child->station] == lp->id)
+			child->state = TW_CANCELLED;
+		else
+			tw_send(lp, child, 1);
+	}
+
+	if(event->kind == TW_DEPART){
+		s->queue_head = (s->queue_head + s->queue_size - 1) % s->queue_size;
+		s->queue[s->queue_head] = event->popped;
+		s->queue_count++;
+	} else
+		s->queue_count--;
+	s->state = event->saved;
+}
+
+
+/* Deshace, en orden inverso, todos los eventos procesados desde el primero con clave \key o mayor */
+static void tw_rollback(struct tw_lp_t *lp, long long key){
+	struct tw_event_t *event;
+
+	while(lp->log_count > lp->log_head && lp->log[lp->log_count - 1]->prefix >= key){
+		event = lp->log[--lp->log_count];
+		tw_undo(lp, event);
+		event->state = TW_PENDING;
+		tw_insert(lp, event);
+		lp->rollbacks++;
+	}
+}
+
+
+/* Lee los mensajes de los canales de entrada
+ * @return Número de mensajes recibidos */
+static int tw_receive(struct tw_lp_t *lp){
+	struct tw_channel_t *ch;
+	struct tw_message_t *message;
+	unsigned long head, tail;
+	int i, received = 0;
+
+	for(i = 0; i < lp->input_count; i++){
+		ch = lp->inputs[i];
+		tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+		head = atomic_load_explicit(&ch->head, memory_order_acquire);
+		for(; tail != head; tail++, received++){
+			message = &ch->messages[tail & TW_RING_MASK];
+			if(message->anti){
+				/* Antimensaje: si el evento ya se procesó hay que deshacerlo primero */
+				if(message->event->state == TW_PROCESSED)
+					tw_rollback(lp, message->event->key);
+				message->event->state = TW_CANCELLED;
+			} else {
+				/* Rezagado */
+				if(lp->log_count > lp->log_head && lp->log[lp->log_count - 1]->prefix >= message->event->key)
+					tw_rollback(lp, message->event->key);
+				tw_insert(lp, message->event);
+			}
+		}
+		atomic_store_explicit(&ch->tail, tail, memory_order_release);
+	}
+	return received;
+}
+
+
+/* Clave de un instante desplazado \ms, con el mismo redondeo que macsim_schedule */
+static long long tw_delay(long long time, double ms){
+	return time + (long long) (ms * 1000000);
+}
+
+
+/* Empieza el servicio del primer cliente de la estación
+ * @return El fin de servicio */
+static struct tw_event_t * tw_start(struct tw_lp_t *lp, int k, long long time){
+	struct tw_station_t *s = &lp->engine->stations[k];
+	struct tw_event_t *departure;
+
+	s->state.server_entry = time;
+	departure = tw_event_create(2 * tw_delay(time, macsim_dist_sample(&lp->engine->net->stations[k].service, &s->state.service_stream)),
+		TW_DEPART, k, s->queue[s->queue_head].id);
+	tw_insert(lp, departure);
+	return departure;
+}
+
+
+/* Un cliente llega a una estación de la partición
+ * @return El fin de servicio, si el cliente entra directamente en el servidor */
+static struct tw_event_t * tw_arrive(struct tw_lp_t *lp, int k, long long client, long long time){
+	struct tw_station_t *s = &lp->engine->stations[k];
+	struct tw_client_t *queue;
+	int i;
+
+	if(s->queue_count == s->queue_size){
+		queue = (struct tw_client_t *) malloc((s->queue_size ? s->queue_size * 2 : 4) * sizeof(struct tw_client_t));
+		if(!queue)
+			fatal("%s: out of memory", __func__);
+		for(i = 0; i < s->queue_count; i++)
+			queue[i] = s->queue[(s->queue_head + i) % s->queue_size];
+		free(s->queue);
+		s->queue = queue;
+		s->queue_head = 0;
+		s->queue_size = s->queue_size ? s->queue_size * 2 : 4;
+	}
+	queue = &s->queue[(s->queue_head + s->queue_count) % s->queue_size];
+	queue->id = client;
+	queue->entry = time;
+	if(++s->queue_count == 1)
+		return tw_start(lp, k, time);
+	return NULL;
+}
+
+
+/* Procesa un evento guardando lo necesario para deshacerlo */
+static void tw_execute(struct tw_lp_t *lp, struct tw_event_t *event){
+	struct tw_engine_t *engine = lp->engine;
+	struct macsim_network_t *net = engine->net;
+	struct tw_station_t *s = &engine->stations[event->station];
+	struct tw_event_t *child;
+	long long time = event->key >> 1;
+	int j;
+
+	event->saved = s->state;
+	event->children[0] = event->children[1] = NULL;
+
+	switch(event->kind){
+	case TW_ARRIVE:
+		event->children[0] = tw_arrive(lp, event->station, event->client, time);
+		break;
+
+	case TW_DEPART:
+		/* Estadísticas, como macsim_station_leave */
+		event->popped = s->queue[s->queue_head];
+		s->queue_head = (s->queue_head + 1) % s->queue_size;
+		s->queue_count--;
+		s->state.clients++;
+		s->state.response += time - event->popped.entry;
+		s->state.service += time - s->state.server_entry;
+
+		/* Igual que el motor secuencial: primero el encaminamiento y después el servicio del siguiente */
+		j = macsim_network_next(net, event->station, &s->state.service_stream);
+		if(s->queue_count)
+			event->children[0] = tw_start(lp, event->station, time);
+		if(j >= 0){
+			child = tw_event_create(2 * time + 1, TW_ARRIVE, j, event->popped.id);
+			if(engine->partition[j] == lp->id)
+				tw_insert(lp, child);
+			else if(child->key < engine->horizon)
+				tw_send(lp, child, 0);
+			else {
+				free(child);
+				child = NULL;
+			}
+			event->children[1] = child;
+		}
+		break;
+
+	case TW_SOURCE:
+		child = tw_event_create(2 * tw_delay(time, macsim_dist_sample(&net->stations[event->station].arrivals, &s->state.arrival_stream)) + 1,
+			TW_SOURCE, event->station, event->client);
+		tw_insert(lp, child);
+		event->children[0] = child;
+		event->children[1] = tw_arrive(lp, event->station, event->client + s->state.seq++ * net->count, time);
+		break;
+	}
+
+	/* Registro de eventos procesados */
+	if(lp->log_count == lp->log_size){
+		lp->log_size = lp->log_size ? lp->log_size * 2 : TW_BATCH;
+		lp->log = (struct tw_event_t **) realloc(lp->log, lp->log_size * sizeof(struct tw_event_t *));
+		if(!lp->log)
+			fatal("%s: out of memory", __func__);
+	}
+	event->prefix = lp->log_count > lp->log_head ? lp->log[lp->log_count - 1]->prefix : lp->committed;
+	if(event->key > event->prefix)
+		event->prefix = event->key;
+	event->state = TW_PROCESSED;
+	lp->log[lp->log_count++] = event;
+}
+
+
+/* Libera los eventos procesados que ya no pueden deshacerse */
+static void tw_fossil_collect(struct tw_lp_t *lp, long long gvt){
+	while(lp->log_head < lp->log_count && lp->log[lp->log_head]->prefix < gvt){
+		lp->committed = lp->log[lp->log_head]->prefix;
+		free(lp->log[lp->log_head++]);
+	}
+
+	/* Sin eventos liberados no hay nada que compactar (y el registro puede no existir todavía) */
+	if(lp->log_head){
+		memmove(lp->log, lp->log + lp->log_head, (lp->log_count - lp->log_head) * sizeof(struct tw_event_t *));
+		lp->log_count -= lp->log_head;
+		lp->log_head = 0;
+	}
+}
+
+
+/* Hilo de una partición */
+static void * tw_worker(void *arg){
+	struct tw_lp_t *lp = (struct tw_lp_t *) arg;
+	struct tw_engine_t *engine = lp->engine;
+	struct tw_event_t *event;
+	long long gvt = 0, window = TW_WINDOW, limit, rollbacks;
+	int i, p, processed, full;
+
+	for(;;){
+		/* Procesamiento optimista de un lote, sin pasar de la ventana */
+		limit = gvt > engine->horizon - window ? engine->horizon : gvt + window;
+		rollbacks = lp->rollbacks;
+		for(i = 0, full = 0; i < TW_BATCH; i++){
+			tw_receive(lp);
+			event = tw_peek(lp);
+			if(!event || event->key >= limit){
+				full = event && limit < engine->horizon;
+				break;
+			}
+			heap_extract(lp->pending, NULL);
+			tw_execute(lp, event);
+		}
+		processed = i;
+
+		/* GVT: con todos los hilos parados se reciben los mensajes en tránsito. Los deshechos
+		 * que eso provoque solo envían antimensajes, que no pueden adelantar el GVT. */
+		pthread_barrier_wait(&engine->barrier);
+		for(p = 0; p < engine->count; p++){
+			if(lp->outputs[p])
+				tw_flush(lp->outputs[p]);
+		}
+		pthread_barrier_wait(&engine->barrier);
+		tw_receive(lp);
+		event = tw_peek(lp);
+		engine->local_min[lp->id] = event ? event->key : LLONG_MAX;
+		for(p = 0; p < engine->count; p++){
+			for(i = 0; lp->outputs[p] && i < lp->outputs[p]->overflow_count; i++){
+				event = lp->outputs[p]->overflow[i].event;
+				if(!lp->outputs[p]->overflow[i].anti && event->key < engine->local_min[lp->id])
+					engine->local_min[lp->id] = event->key;
+			}
+		}
+		pthread_barrier_wait(&engine->barrier);
+
+		for(p = 0, gvt = LLONG_MAX; p < engine->count; p++){
+			if(engine->local_min[p] < gvt)
+				gvt = engine->local_min[p];
+		}
+		tw_fossil_collect(lp, gvt);
+		if(gvt >= engine->horizon)
+			break;
+
+		/* Ventana adaptativa: se estrecha si se deshace mucho y se ensancha si limita sin deshacer */
+		rollbacks = lp->rollbacks - rollbacks;
+		if(processed && rollbacks * 4 > processed && window > 2)
+			window /= 2;
+		else if(full && rollbacks * 16 <= processed && window < engine->horizon)
+			window *= 2;
+	}
+	return NULL;
+}
+
+
+/* Simula la red durante \horizon_ms con \threads hilos que avanzan de forma optimista.
+ * No usa la cola de eventos ni las estaciones de la librería, que no necesita estar inicializada.
+ * Los resultados son los mismos que los de macsim_network_run y, a diferencia del motor
+ * conservador, no dependen del lookahead.
+ * @return Número de eventos deshechos */
+long long macsim_network_run_optimistic(struct macsim_network_t *net, double horizon_ms, int threads, struct macsim_result_t *results){
+	struct tw_engine_t engine;
+	struct tw_lp_t *lp;
+	struct tw_channel_t *ch;
+	struct tw_event_t *event;
+	struct tw_message_t *message;
+	long *service_streams, *arrival_streams;
+	long long id, rollbacks = 0;
+	unsigned long tail;
+	int k, p, q, r, j;
+
+	macsim_network_check_simple(net, __func__);
+	if(threads < 1)
+		threads = 1;
+	if(threads > net->count)
+		threads = net->count;
+
+	memset(&engine, 0, sizeof(engine));
+	engine.net = net;
+	engine.count = threads;
+	engine.horizon = 2 * (long long) (horizon_ms * 1000000);
+	if(pthread_barrier_init(&engine.barrier, NULL, threads))
+		fatal("%s: can't create barrier", __func__);
+
+	engine.stations = (struct tw_station_t *) calloc(net->count, sizeof(struct tw_station_t));
+	engine.partition = (int *) malloc(net->count * sizeof(int));
+	engine.lps = (struct tw_lp_t *) calloc(threads, sizeof(struct tw_lp_t));
+	engine.channels = (struct tw_channel_t **) calloc(threads * threads, sizeof(struct tw_channel_t *));
+	engine.local_min = (long long *) calloc(threads, sizeof(long long));
+	service_streams = (long *) malloc(net->count * sizeof(long));
+	arrival_streams = (long *) malloc(net->count * sizeof(long));
+	if(!engine.stations || !engine.partition || !engine.lps || !engine.channels || !engine.local_min || !service_streams || !arrival_streams)
+		fatal("%s: out of memory", __func__);
+
+	/* Streams de cada estación */
+	macsim_network_streams(net, service_streams, arrival_streams);
+	for(k = 0; k < net->count; k++){
+		engine.stations[k].state.service_stream = service_streams[k];
+		engine.stations[k].state.arrival_stream = arrival_streams[k];
+	}
+
+	/* Particiones contiguas */
+	for(p = 0; p < threads; p++){
+		lp = &engine.lps[p];
+		lp->engine = &engine;
+		lp->id = p;
+		lp->committed = -1;
+		lp->pending = heap_create(64);
+		lp->outputs = (struct tw_channel_t **) calloc(threads, sizeof(struct tw_channel_t *));
+		lp->inputs = (struct tw_channel_t **) calloc(threads, sizeof(struct tw_channel_t *));
+		if(!lp->pending || !lp->outputs || !lp->inputs)
+			fatal("%s: out of memory", __func__);
+		for(k = (long long) net->count * p / threads; k < (long long) net->count * (p + 1) / threads; k++)
+			engine.partition[k] = p;
+	}
+
+	/* Canales entre particiones con encaminamiento */
+	for(k = 0; k < net->count; k++){
+		for(r = 0; r < net->stations[k].route_count; r++){
+			p = engine.partition[k];
+			q = engine.partition[net->stations[k].routes[r].to];
+			if(p == q || engine.channels[p * threads + q])
+				continue;
+			ch = (struct tw_channel_t *) aligned_alloc(64, sizeof(struct tw_channel_t));
+			if(!ch)
+				fatal("%s: out of memory", __func__);
+			memset(ch, 0, sizeof(*ch));
+			ch->messages = (struct tw_message_t *) malloc(TW_RING_SIZE * sizeof(struct tw_message_t));
+			if(!ch->messages)
+				fatal("%s: out of memory", __func__);
+			atomic_init(&ch->head, 0);
+			atomic_init(&ch->tail, 0);
+			engine.channels[p * threads + q] = ch;
+			engine.lps[p].outputs[q] = ch;
+			engine.lps[q].inputs[engine.lps[q].input_count++] = ch;
+		}
+	}
+
+	/* Clientes iniciales y primera llegada de cada fuente; los ids son los de macsim_network_run */
+	for(k = 0, id = 0; k < net->count; k++){
+		lp = &engine.lps[engine.partition[k]];
+		for(j = 0; j < net->stations[k].population; j++)
+			tw_insert(lp, tw_event_create(1, TW_ARRIVE, k, id++));
+	}
+	for(k = 0; k < net->count; k++){
+		lp = &engine.lps[engine.partition[k]];
+		if(net->stations[k].arrivals.type != MACSIM_DIST_NONE)
+			tw_insert(lp, tw_event_create(2 * tw_delay(0, macsim_dist_sample(&net->stations[k].arrivals, &engine.stations[k].state.arrival_stream)) + 1,
+				TW_SOURCE, k, id + k));
+	}
+
+	for(p = 0; p < threads; p++){
+		if(pthread_create(&engine.lps[p].thread, NULL, tw_worker, &engine.lps[p]))
+			fatal("%s: can't create thread", __func__);
+	}
+	for(p = 0; p < threads; p++)
+		pthread_join(engine.lps[p].thread, NULL);
+
+	for(k = 0; k < net->count; k++){
+		macsim_network_result(&results[k], net->stations[k].name, engine.stations[k].state.clients,
+			engine.stations[k].state.response, engine.stations[k].state.service, engine.horizon / 2);
+		free(engine.stations[k].queue);
+	}
+
+	/* Liberar. Los eventos que queden en los canales ya pertenecen a la cola de su destino. */
+	for(p = 0; p < threads; p++){
+		lp = &engine.lps[p];
+		rollbacks += lp->rollbacks;
+		while(heap_count(lp->pending)){
+			heap_extract(lp->pending, (void **) &event);
+			free(event);
+		}
+		for(r = 0; r < lp->log_count; r++)
+			free(lp->log[r]);
+		heap_free(lp->pending);
+		free(lp->log);
+		free(lp->inputs);
+		free(lp->outputs);
+	}
+	for(p = 0; p < threads * threads; p++){
+		if(!(ch = engine.channels[p]))
+			continue;
+		for(tail = atomic_load(&ch->tail); tail != atomic_load(&ch->head); tail++){
+			message = &ch->messages[tail & TW_RING_MASK];
+			if(!message->anti)
+				free(message->event);
+		}
+		free(ch->messages);
+		free(ch->overflow);
+		free(ch);
+	}
+	pthread_barrier_destroy(&engine.barrier);
+	free(engine.channels);
+	free(engine.local_min);
+	free(engine.lps);
+	free(engine.partition);
+	free(engine.stations);
+	free(service_streams);
+	free(arrival_streams);
+	return rollbacks;
+}
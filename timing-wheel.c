@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include "timing-wheel.h"
+
+
+#define TIMING_WHEEL_WORDS	(TIMING_WHEEL_SLOTS / 64)
+
+struct timing_wheel_slot_t {
+	struct timing_wheel_node_t *head, *tail;
+};
+
+struct timing_wheel_t {
+	int levels;
+	int count;
+	long long now;  /* no key in the wheel is smaller */
+	unsigned long long *bitmap;  /* non-empty slots, TIMING_WHEEL_WORDS per level */
+	struct timing_wheel_slot_t *slot;  /* TIMING_WHEEL_SLOTS per level */
+};
+
+
+
+
+/* Private Methods */
+
+/* append a node to the slot of its key */
+static void timing_wheel_place(struct timing_wheel_t *wheel, struct timing_wheel_node_t *node)
+{
+	unsigned long long diff = (unsigned long long) (node->time ^ wheel->now);
+	int level = diff ? (63 - __builtin_clzll(diff)) / TIMING_WHEEL_BITS : 0;
+	int index = (node->time >> (level * TIMING_WHEEL_BITS)) & (TIMING_WHEEL_SLOTS - 1);
+	struct timing_wheel_slot_t *slot;
+
+	node->slot = level * TIMING_WHEEL_SLOTS + index;
+	slot = &wheel->slot[node->slot];
+	node->next = NULL;
+	node->prev = slot->tail;
+	if (slot->tail)
+		slot->tail->next = node;
+	else
+		slot->head = node;
+	slot->tail = node;
+	wheel->bitmap[node->slot / 64] |= 1ULL << (node->slot % 64);
+}
+
+
+/* lowest non-empty slot of a level, or -1 */
+static int timing_wheel_first(struct timing_wheel_t *wheel, int level)
+{
+	unsigned long long *bitmap = &wheel->bitmap[level * TIMING_WHEEL_WORDS];
+	int w;
+
+	for (w = 0; w < TIMING_WHEEL_WORDS; w++)
+		if (bitmap[w])
+			return w * 64 + __builtin_ctzll(bitmap[w]);
+	return -1;
+}
+
+
+
+
+/* Public Methods */
+
+/* creation */
+struct timing_wheel_t *timing_wheel_create(int levels)
+{
+	struct timing_wheel_t *wheel;
+
+	if (levels < 1 || levels > TIMING_WHEEL_MAX_LEVELS)
+		return NULL;
+	wheel = calloc(1, sizeof(struct timing_wheel_t));
+	if (!wheel)
+		return NULL;
+	wheel->levels = levels;
+	wheel->bitmap = calloc(levels * TIMING_WHEEL_WORDS, sizeof(unsigned long long));
+	wheel->slot = calloc(levels * TIMING_WHEEL_SLOTS, sizeof(struct timing_wheel_slot_t));
+	if (!wheel->bitmap || !wheel->slot) {
+		timing_wheel_free(wheel);
+		return NULL;
+	}
+	return wheel;
+}
+
+
+/* destruction; the nodes belong to the caller */
+void timing_wheel_free(struct timing_wheel_t *wheel)
+{
+	free(wheel->bitmap);
+	free(wheel->slot);
+	free(wheel);
+}
+
+
+int timing_wheel_count(struct timing_wheel_t *wheel)
+{
+	return wheel->count;
+}
+
+
+int timing_wheel_insert(struct timing_wheel_t *wheel, long long time, struct timing_wheel_node_t *node)
+{
+	/* an empty wheel starts over from the key */
+	if (!wheel->count)
+		wheel->now = time;
+
+	/* key out of range */
+	if (time < wheel->now || (unsigned long long) (time ^ wheel->now) >> (wheel->levels * TIMING_WHEEL_BITS))
+		return 0;
+
+	node->time = time;
+	timing_wheel_place(wheel, node);
+	wheel->count++;
+	return 1;
+}
+
+
+void timing_wheel_remove(struct timing_wheel_t *wheel, struct timing_wheel_node_t *node)
+{
+	struct timing_wheel_slot_t *slot = &wheel->slot[node->slot];
+
+	if (node->prev)
+		node->prev->next = node->next;
+	else
+		slot->head = node->next;
+	if (node->next)
+		node->next->prev = node->prev;
+	else
+		slot->tail = node->prev;
+	if (!slot->head)
+		wheel->bitmap[node->slot / 64] &= ~(1ULL << (node->slot % 64));
+	node->prev = node->next = NULL;
+	wheel->count--;
+}
+
+
+struct timing_wheel_node_t *timing_wheel_peek(struct timing_wheel_t *wheel)
+{
+	struct timing_wheel_node_t *node, *next;
+	struct timing_wheel_slot_t *slot;
+	int level, index, shift;
+
+	if (!wheel->count)
+		return NULL;
+
+	/* cascade until level 0 has a key: the lowest slot of the lowest
+	 * non-empty level holds the smallest keys, and moving the current time
+	 * to the start of that slot sends them all to lower levels */
+	while ((index = timing_wheel_first(wheel, 0)) < 0) {
+		for (level = 1; (index = timing_wheel_first(wheel, level)) < 0; level++);
+		shift = (level + 1) * TIMING_WHEEL_BITS;
+		wheel->now = (wheel->now >> shift << shift) | ((long long) index << (level * TIMING_WHEEL_BITS));
+
+		slot = &wheel->slot[level * TIMING_WHEEL_SLOTS + index];
+		node = slot->head;
+		slot->head = slot->tail = NULL;
+		wheel->bitmap[(level * TIMING_WHEEL_SLOTS + index) / 64] &= ~(1ULL << (index % 64));
+		for (; node; node = next) {
+			next = node->next;
+			timing_wheel_place(wheel, node);
+		}
+	}
+	return wheel->slot[index].head;
+}
+
+
+struct timing_wheel_node_t *timing_wheel_extract(struct timing_wheel_t *wheel)
+{
+	struct timing_wheel_node_t *node = timing_wheel_peek(wheel);
+
+	if (node) {
+		timing_wheel_remove(wheel, node);
+		wheel->now = node->time;
+	}
+	return node;
+}
@@ -0,0 +1,39 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#define TIMING_WHEEL_BITS	8	/* bits of the key per level */
+#define TIMING_WHEEL_SLOTS	(1 << TIMING_WHEEL_BITS)
+#define TIMING_WHEEL_MAX_LEVELS	7
+
+/* Hierarchical timing wheel for integer keys (nanoseconds) close to the
+ * current time. Level 'l' has TIMING_WHEEL_SLOTS slots, each covering
+ * 2^(8l) keys; a key is stored in the level of the highest byte in which it
+ * differs from the wheel's current time, so level 0 slots hold a single key
+ * and are plain FIFO lists. When level 0 runs out, the next slot of the
+ * lowest non-empty level is cascaded down. Insertion and removal are O(1);
+ * nodes are embedded in the caller's structures. Keys smaller than the
+ * current time or too far from it are rejected, and the caller keeps them
+ * elsewhere. */
+struct timing_wheel_t;
+
+/* node embedded in the caller's element */
+struct timing_wheel_node_t {
+	struct timing_wheel_node_t *prev, *next;
+	long long time;
+	int slot;
+};
+
+/* creation and destruction; 'levels' between 1 and TIMING_WHEEL_MAX_LEVELS
+ * gives a range of 2^(8 * levels) keys */
+struct timing_wheel_t *timing_wheel_create(int levels);
+void timing_wheel_free(struct timing_wheel_t *wheel);
+
+/* operations; insert returns 0 if the key does not fit in the wheel */
+int timing_wheel_count(struct timing_wheel_t *wheel);
+int timing_wheel_insert(struct timing_wheel_t *wheel, long long time, struct timing_wheel_node_t *node);
+void timing_wheel_remove(struct timing_wheel_t *wheel, struct timing_wheel_node_t *node);
+struct timing_wheel_node_t *timing_wheel_peek(struct timing_wheel_t *wheel);  /* NULL if empty */
+struct timing_wheel_node_t *timing_wheel_extract(struct timing_wheel_t *wheel);  /* NULL if empty */
+
+
+#endif
@@ -0,0 +1,172 @@
+/* Simula un modelo descrito en un fichero (ver model.c) y muestra los resultados de cada
+ * estación y, con el motor closed, los tiempos de ciclo de cada clase.
+ * Los argumentos clave=valor cambian asignaciones del fichero sin editarlo, por ejemplo
+ * model.horizon=50000 station.cpu.service="exponential 0.8".
+ *
+ * Con -s se hace un barrido de una clave, con una lista de valores separados por comas
+ * (-s model.horizon=1000,10000) o con n valores entre dos extremos (-s station.cpu.service=0.5:0.9:5,
+ * que si la clave es una distribución cambia su primer parámetro), y -j reparte los puntos entre
+ * varios hilos. El resultado es una sola tabla con todos los puntos.
+ *
+ * Con -o los resultados de las estaciones se escriben además en un fichero (ver report.h) en
+ * CSV (.csv), JSON lines (.json o .jsonl) o binario (.bin) según su extensión; cada punto de
+ * un barrido es una ejecución.
+ *
+ * Con -p se escribe en otro fichero, en CSV o JSON lines, la instrumentación de la librería
+ * (macsim_profile) tras una simulación con el motor sequential; la librería tiene que estar
+ * compilada con make PROFILE=1.
+ *
+ * Con -m la simulación publica cada segundo sus estadísticas en vivo con ese nombre
+ * (macsim_monitor), que se pueden seguir con macsim-top; solo con el motor sequential.
+ *
+ * Uso: macsim-run [-s clave=valores] [-j hilos] [-o fichero] [-p fichero] [-m nombre] <modelo> [clave=valor ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "model.h"
+#include "sweep.h"
+#include "report.h"
+#include "debug.h"
+
+
+static void usage(const char *name){
+	fprintf(stderr, "uso: %s [-s clave=valores] [-j hilos] [-o fichero] [-p fichero] [-m nombre] <modelo> [clave=valor ...]\n", name);
+	exit(1);
+}
+
+
+/* Añade los puntos de "clave=v1,v2,..." o "clave=ini:fin:n" */
+static struct macsim_sweep_t * sweep_parse(struct macsim_model_t *model, char *spec){
+	struct macsim_sweep_t *sweep;
+	char *values = strchr(spec, '='), *value;
+	double from, to;
+	int points;
+
+	if(!values)
+		fatal("barrido sin valores: \"%s\"", spec);
+	*values++ = 0;
+	sweep = macsim_sweep_create(model, spec);
+	if(sscanf(values, "%lf:%lf:%d", &from, &to, &points) == 3)
+		macsim_sweep_range(sweep, from, to, points);
+	else{
+		for(value = strtok(values, ","); value; value = strtok(NULL, ","))
+			macsim_sweep_add(sweep, value);
+	}
+	return sweep;
+}
+
+
+int main(int argc, char **argv){
+	struct macsim_model_t *model;
+	struct macsim_network_t *net;
+	struct macsim_result_t *results;
+	struct macsim_network_class_result_t *class_results;
+	struct macsim_sweep_t *sweep;
+	struct macsim_report_t *report = NULL;
+	struct macsim_report_t *profile_report = NULL;
+	struct macsim_profile_entry_t *profile;
+	char *spec = NULL, *output = NULL, *profile_output = NULL, *monitor = NULL;
+	int i, k, opt, threads = 1, count;
+
+	while((opt = getopt(argc, argv, "s:j:o:p:m:")) != -1){
+		switch(opt){
+		case 's':
+			spec = optarg;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'p':
+			profile_output = optarg;
+			break;
+		case 'm':
+			monitor = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if(optind >= argc)
+		usage(argv[0]);
+	model = macsim_model_load(argv[optind]);
+	if(!model)
+		fatal("no se puede abrir \"%s\"", argv[optind]);
+	for(i = optind + 1; i < argc; i++)
+		macsim_model_override(model, argv[i]);
+	if(output && !(report = macsim_report_open(output, macsim_report_format(output))))
+		fatal("no se puede crear \"%s\"", output);
+	if(profile_output && spec)
+		fatal("-p no se puede usar con -s");
+	if(profile_output && macsim_report_format(profile_output) == MACSIM_REPORT_BINARY)
+		fatal("la instrumentación se escribe en CSV o JSON lines: \"%s\"", profile_output);
+	if(profile_output && !(profile_report = macsim_report_open(profile_output, macsim_report_format(profile_output))))
+		fatal("no se puede crear \"%s\"", profile_output);
+	if(monitor)
+		macsim_monitor(monitor, 1); //Se cierra en el macsim_exit de la simulación
+
+	if(spec){
+		sweep = sweep_parse(model, spec);
+		macsim_sweep_run(sweep, threads);
+		macsim_sweep_print(sweep, stdout);
+		for(i = 0; report && i < sweep->count; i++)
+			macsim_report_write(report, i, sweep->points[i].results, sweep->points[i].station_count);
+		if(report)
+			macsim_report_close(report);
+		macsim_sweep_free(sweep);
+		macsim_model_free(model);
+		macsim_monitor(NULL, 0);
+		return 0;
+	}
+
+	net = macsim_model_compile(model);
+	results = (struct macsim_result_t *) calloc(net->count, sizeof(struct macsim_result_t));
+	class_results = (struct macsim_network_class_result_t *) calloc(net->class_count, sizeof(struct macsim_network_class_result_t));
+	if(!results || !class_results)
+		fatal("out of memory");
+	macsim_model_run(model, results, class_results);
+
+	for(k = 0; k < net->count; k++){
+		printf("\n");
+		printf("ESTACION: %s\n", results[k].name);
+		printf("Tiempo de servicio    Tiempo de respuesta   Tiempo en cola        Clientes totales      Productividad         Utilización\n");
+		printf("%-20.4f  %-20.4f  %-20.4f  %-20lld  %-20.4f  %-20.4f\n", results[k].service_time, results[k].response_time,
+			results[k].queue_time, results[k].total_clients, results[k].throughput, results[k].utilization);
+	}
+	if(model->engine == MACSIM_ENGINE_CLOSED){
+		for(k = 0; k < net->class_count; k++){
+			printf("\n");
+			printf("CLASE: %s\n", class_results[k].name);
+			printf("Ciclos                Tiempo de ciclo       Productividad\n");
+			printf("%-20lld  %-20.4f  %-20.4f\n", class_results[k].cycles, class_results[k].cycle_time, class_results[k].throughput);
+		}
+	}
+	printf("\n");
+	if(report){
+		macsim_report_write(report, 0, results, net->count);
+		macsim_report_close(report);
+	}
+	if(profile_report){
+		count = macsim_profile(NULL, 0);
+		if(!count)
+			fprintf(stderr, "%s: la librería no tiene instrumentación (make PROFILE=1)\n", argv[0]);
+		else if(model->engine != MACSIM_ENGINE_SEQUENTIAL)
+			fprintf(stderr, "%s: la instrumentación solo mide el motor sequential\n", argv[0]);
+		profile = (struct macsim_profile_entry_t *) calloc(count ? count : 1, sizeof(struct macsim_profile_entry_t));
+		if(!profile)
+			fatal("out of memory");
+		macsim_report_profile(profile_report, 0, profile, macsim_profile(profile, count));
+		macsim_report_close(profile_report);
+		free(profile);
+	}
+
+	free(results);
+	free(class_results);
+	macsim_model_free(model);
+	macsim_monitor(NULL, 0);
+	return 0;
+}
@@ -0,0 +1,106 @@
+/* Muestra las estadísticas en vivo que publica una simulación con macsim_monitor (o con
+ * macsim-run -m): instante de la simulación, eventos por segundo, eventos pendientes, progreso
+ * de batch means y una fila por estación. Solo lee el segmento de memoria compartida, así que
+ * no frena la simulación.
+ *
+ * Cada \intervalo segundos (1 por defecto) imprime una nueva tabla, hasta que la simulación
+ * termina; con -1 imprime una sola.
+ *
+ * Uso: macsim-top [-n intervalo] [-1] <nombre>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include "monitor.h"
+#include "debug.h"
+
+
+static void usage(const char *name){
+	fprintf(stderr, "uso: %s [-n intervalo] [-1] <nombre>\n", name);
+	exit(1);
+}
+
+
+/* Imprime una copia del segmento */
+static void print_segment(const struct macsim_monitor_segment_t *s){
+	const struct macsim_monitor_station_t *station;
+	int k, count = s->station_count < MACSIM_MONITOR_STATIONS ? s->station_count : MACSIM_MONITOR_STATIONS;
+
+	printf("pid %d  %s  %.1f s  t = %.3f ms  %lld eventos  %.0f eventos/s  %lld pendientes\n", s->pid,
+		s->state == MACSIM_MONITOR_FINISHED ? "terminada" : "en marcha", s->wall_seconds, s->time_ms,
+		s->events, s->events_per_second, s->pending);
+	if(s->precision > 0){
+		printf("batch means: %d lotes", s->batches);
+		if(s->batches >= 10)
+			printf("  media %.6g ± %.6g (%.4f, objetivo %.4f)", s->mean, s->half_width,
+				s->mean ? s->half_width / s->mean : 0, s->precision);
+		printf("\n");
+	}
+	printf("%-20s  %-14s  %-14s  %-14s  %-14s  %-14s  %-14s  %-14s\n", "Estación", "En estación", "T. servicio",
+		"T. respuesta", "T. en cola", "Clientes", "Productividad", "Utilización");
+	for(k = 0; k < count; k++){
+		station = &s->stations[k];
+		printf("%-20s  %-14lld  %-14.4f  %-14.4f  %-14.4f  %-14lld  %-14.4f  %-14.4f\n", station->name, station->queue_length,
+			station->service_time, station->response_time, station->queue_time, station->total_clients,
+			station->throughput, station->utilization);
+	}
+	if(count < s->station_count)
+		printf("(%d estaciones más)\n", s->station_count - count);
+	printf("\n");
+	fflush(stdout);
+}
+
+
+int main(int argc, char **argv){
+	const struct macsim_monitor_segment_t *segment;
+	struct macsim_monitor_segment_t *copy;
+	struct timespec wait;
+	double interval = 1;
+	int opt, once = 0;
+
+	while((opt = getopt(argc, argv, "n:1")) != -1){
+		switch(opt){
+		case 'n':
+			interval = atof(optarg);
+			break;
+		case '1':
+			once = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if(optind != argc - 1 || interval <= 0)
+		usage(argv[0]);
+	segment = macsim_monitor_attach(argv[optind]);
+	if(!segment)
+		fatal("no hay estadísticas en vivo con el nombre \"%s\"", argv[optind]);
+	copy = (struct macsim_monitor_segment_t *) calloc(1, sizeof(struct macsim_monitor_segment_t));
+	if(!copy)
+		fatal("out of memory");
+	wait.tv_sec = (time_t) interval;
+	wait.tv_nsec = (long) ((interval - wait.tv_sec) * 1e9);
+
+	for(;;){
+		if(macsim_monitor_read(segment, copy))
+			print_segment(copy);
+		else
+			fprintf(stderr, "%s: el segmento está cambiando, se vuelve a intentar\n", argv[0]);
+		if(once || copy->state == MACSIM_MONITOR_FINISHED)
+			break;
+
+		/* Sin publicar el estado final el proceso ha terminado de mala manera */
+		if(kill(copy->pid, 0) && errno == ESRCH){
+			fprintf(stderr, "%s: el proceso %d ha terminado\n", argv[0], copy->pid);
+			break;
+		}
+		nanosleep(&wait, NULL);
+	}
+
+	free(copy);
+	macsim_monitor_detach(segment);
+	return 0;
+}
@@ -0,0 +1,102 @@
+/* Decodificador de trazas binarias de macsim.
+ * Imprime los mismos mensajes que la traza textual a partir del fichero
+ * generado con macsim_trace_binary().
+ *
+ * Uso: macsim-trace <fichero>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "debug.h"
+
+#define BLOCK 4096 //Registros leídos de cada vez
+
+static char **names; //Nombre de cada estación, indexado por id
+static int names_size;
+
+
+/* Guarda el nombre de la estación \id */
+static void set_name(int id, char *name){
+	if(id >= names_size){
+		int size = names_size ? names_size : 64;
+		while(size <= id)
+			size *= 2;
+		names = (char **) realloc(names, size * sizeof(char *));
+		if(!names)
+			fatal("%s: out of memory", __func__);
+		memset(names + names_size, 0, (size - names_size) * sizeof(char *));
+		names_size = size;
+	}
+	free(names[id]);
+	names[id] = name;
+}
+
+
+/* Lee un registro; los registros se leen por bloques para no hacer una llamada por registro
+ * @return 1 si se ha leído, 0 al final del fichero */
+static int read_record(FILE *f, struct macsim_trace_record_t *record){
+	static struct macsim_trace_record_t block[BLOCK];
+	static size_t count, pos;
+
+	if(pos == count){
+		count = fread(block, sizeof(struct macsim_trace_record_t), BLOCK, f);
+		pos = 0;
+		if(!count)
+			return 0;
+	}
+	*record = block[pos++];
+	return 1;
+}
+
+
+int main(int argc, char **argv){
+	struct macsim_trace_header_t header;
+	struct macsim_trace_record_t record;
+	char msg[1024], unknown[32], *name;
+	const char *station_name;
+	int len, done;
+	FILE *f;
+
+	if(argc != 2){
+		fprintf(stderr, "uso: %s <fichero de traza>\n", argv[0]);
+		return 1;
+	}
+
+	f = fopen(argv[1], "rb");
+	if(!f)
+		fatal("no se puede abrir \"%s\"", argv[1]);
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, MACSIM_TRACE_MAGIC, sizeof(header.magic)))
+		fatal("\"%s\" no es una traza de macsim", argv[1]);
+	if(header.version != MACSIM_TRACE_VERSION || header.record_size != sizeof(struct macsim_trace_record_t))
+		fatal("\"%s\": versión de traza no soportada (%d)", argv[1], header.version);
+
+	while(read_record(f, &record)){
+		/* Definición de estación: el nombre ocupa los registros siguientes */
+		if(record.op == MACSIM_TRACE_STATION){
+			len = (int) record.client;
+			name = (char *) malloc(len + sizeof(record));
+			if(!name)
+				fatal("%s: out of memory", __func__);
+			for(done = 0; done < len; done += sizeof(record)){
+				if(!read_record(f, (struct macsim_trace_record_t *) (name + done)))
+					fatal("\"%s\": traza truncada", argv[1]);
+			}
+			name[len] = '\0';
+			set_name(record.station, name);
+			continue;
+		}
+
+		if(record.station >= 0 && record.station < names_size && names[record.station])
+			station_name = names[record.station];
+		else{
+			snprintf(unknown, sizeof(unknown), "#%d", record.station);
+			station_name = unknown;
+		}
+		macsim_trace_format(msg, sizeof(msg), &record, station_name);
+		printf("%f %s\n", record.time / 1000000.0, msg);
+	}
+
+	fclose(f);
+	return 0;
+}
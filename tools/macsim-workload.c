@@ -0,0 +1,49 @@
+/* Conversor de cargas en texto al formato binario por columnas de macsim.
+ * Cada línea de la entrada contiene el instante de llegada y la demanda de servicio,
+ * ambos en milisegundos, como los reciben macsim_schedule y compañía.
+ * Las líneas vacías y las que empiezan por '#' se ignoran.
+ *
+ * Uso: macsim-workload <salida> [entrada]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "workload.h"
+#include "debug.h"
+
+
+int main(int argc, char **argv){
+	struct macsim_workload_writer_t *writer;
+	double arrival, service;
+	char line[256];
+	long long n = 0;
+	FILE *in = stdin;
+
+	if(argc < 2 || argc > 3){
+		fprintf(stderr, "uso: %s <salida> [entrada]\n", argv[0]);
+		return 1;
+	}
+	if(argc == 3){
+		in = fopen(argv[2], "r");
+		if(!in)
+			fatal("no se puede abrir \"%s\"", argv[2]);
+	}
+
+	writer = macsim_workload_writer_create(argv[1]);
+	if(!writer)
+		fatal("no se puede crear \"%s\"", argv[1]);
+
+	while(fgets(line, sizeof(line), in)){
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+		if(sscanf(line, "%lf %lf", &arrival, &service) != 2)
+			fatal("línea %lld: se esperaba \"llegada servicio\"", n + 1);
+		macsim_workload_writer_append(writer, (long long) (arrival * 1000000), (long long) (service * 1000000));
+		n++;
+	}
+
+	macsim_workload_writer_close(writer);
+	if(in != stdin)
+		fclose(in);
+	fprintf(stderr, "%lld registros\n", n);
+	return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "trace.h"
+#include "debug.h"
+
+#define MACSIM_TRACE_MASK (MACSIM_TRACE_RING_SIZE - 1)
+#define MACSIM_TRACE_IDLE_NS 200000 //Espera del hilo escritor cuando no hay registros
+
+/* Estructuras */
+/* Buffer circular de un productor (la simulación) y un consumidor (el hilo escritor).
+ * Las posiciones crecen indefinidamente, el índice real se obtiene con la máscara. */
+struct macsim_trace_t {
+	struct macsim_trace_record_t *records; //MACSIM_TRACE_RING_SIZE registros
+	FILE *file; //Fichero de salida
+	pthread_t writer; //Hilo que vacía el buffer en el fichero
+	atomic_int stop; //Indica al hilo escritor que debe terminar
+
+	_Alignas(64) atomic_ulong head; //Siguiente posición a escribir (productor)
+	unsigned long cached_tail; //Última cola vista por el productor
+
+	_Alignas(64) atomic_ulong tail; //Siguiente posición a leer (consumidor)
+};
+
+
+/* Prototipos */
+static void * macsim_trace_writer(void *arg);
+
+
+/* Funciones */
+/* Crea el fichero de traza y lanza el hilo escritor
+ * @return La traza o NULL si no se puede crear el fichero */
+struct macsim_trace_t * macsim_trace_open(const char *path){
+	struct macsim_trace_t *trace;
+	struct macsim_trace_header_t header;
+
+	trace = (struct macsim_trace_t *) calloc(1, sizeof(struct macsim_trace_t));
+	if(!trace)
+		fatal("%s: out of memory", __func__);
+	trace->records = (struct macsim_trace_record_t *) calloc(MACSIM_TRACE_RING_SIZE, sizeof(struct macsim_trace_record_t));
+	if(!trace->records)
+		fatal("%s: out of memory", __func__);
+
+	trace->file = fopen(path, "wb");
+	if(!trace->file){
+		free(trace->records);
+		free(trace);
+		return NULL;
+	}
+
+	/* Cabecera */
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MACSIM_TRACE_MAGIC, sizeof(header.magic));
+	header.version = MACSIM_TRACE_VERSION;
+	header.record_size = sizeof(struct macsim_trace_record_t);
+	if(fwrite(&header, sizeof(header), 1, trace->file) != 1)
+		fatal("%s: can't write trace header", __func__);
+
+	if(pthread_create(&trace->writer, NULL, macsim_trace_writer, trace))
+		fatal("%s: can't create writer thread", __func__);
+	return trace;
+}
+
+
+/* Vacía lo que quede en el buffer, detiene el hilo escritor y cierra el fichero */
+void macsim_trace_close(struct macsim_trace_t *trace){
+	atomic_store_explicit(&trace->stop, 1, memory_order_release);
+	pthread_join(trace->writer, NULL);
+	if(fclose(trace->file))
+		fatal("%s: can't write trace file", __func__);
+	free(trace->records);
+	free(trace);
+}
+
+
+/* Añade un registro al buffer. Si el buffer está lleno se espera a que el hilo escritor
+ * libere espacio, de modo que nunca se pierden registros. */
+void macsim_trace_push(struct macsim_trace_t *trace, const struct macsim_trace_record_t *record){
+	unsigned long head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+
+	if(head - trace->cached_tail == MACSIM_TRACE_RING_SIZE){
+		while((trace->cached_tail = atomic_load_explicit(&trace->tail, memory_order_acquire)) + MACSIM_TRACE_RING_SIZE == head)
+			sched_yield();
+	}
+	trace->records[head & MACSIM_TRACE_MASK] = *record;
+	atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+
+/* Añade la definición de una estación para que el decodificador pueda mostrar su nombre.
+ * El nombre se guarda a continuación del registro, ocupando tantos registros como haga falta. */
+void macsim_trace_push_station(struct macsim_trace_t *trace, int id, const char *name){
+	struct macsim_trace_record_t record;
+	int len = strlen(name), done;
+
+	memset(&record, 0, sizeof(record));
+	record.op = MACSIM_TRACE_STATION;
+	record.station = id;
+	record.client = len;
+	macsim_trace_push(trace, &record);
+
+	for(done = 0; done < len; done += sizeof(record)){
+		memset(&record, 0, sizeof(record));
+		memcpy(&record, name + done, len - done < (int) sizeof(record) ? len - done : (int) sizeof(record));
+		macsim_trace_push(trace, &record);
+	}
+}
+
+
+/* Escribe en \buf el mensaje legible correspondiente a un registro, sin el instante.
+ * Es el mismo texto que produce la traza textual.
+ * @return Número de caracteres escritos, como snprintf */
+int macsim_trace_format(char *buf, int size, const struct macsim_trace_record_t *record, const char *station_name){
+	switch(record->op){
+	case MACSIM_TRACE_ENTER:
+		return snprintf(buf, size, "El cliente %lld entra en la estación \"%s\"", record->client, station_name);
+	case MACSIM_TRACE_ENTER_QUEUED:
+		return snprintf(buf, size, "El cliente %lld entra en la estación \"%s\", en la que estaba encolado", record->client, station_name);
+	case MACSIM_TRACE_QUEUE:
+		return snprintf(buf, size, "El cliente %lld se encola en la estación \"%s\"", record->client, station_name);
+	case MACSIM_TRACE_LEAVE:
+		return snprintf(buf, size, "El cliente %lld sale de la estación \"%s\" tresp = %f tserv = %f", record->client, station_name, record->response_time / 1000000.0, record->service_time / 1000000.0);
+	}
+	return snprintf(buf, size, "Registro desconocido %d", record->op);
+}
+
+
+/* Hilo escritor: vuelca en el fichero los registros disponibles en bloques contiguos */
+static void * macsim_trace_writer(void *arg){
+	struct macsim_trace_t *trace = (struct macsim_trace_t *) arg;
+	struct timespec idle = {0, MACSIM_TRACE_IDLE_NS};
+	unsigned long head, tail, count;
+	int stop;
+
+	tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+	for(;;){
+		stop = atomic_load_explicit(&trace->stop, memory_order_acquire);
+		head = atomic_load_explicit(&trace->head, memory_order_acquire);
+		if(head == tail){
+			if(stop)
+				break;
+			nanosleep(&idle, NULL);
+			continue;
+		}
+
+		/* Hasta el final del buffer como mucho, el resto en la siguiente vuelta */
+		count = head - tail;
+		if((tail & MACSIM_TRACE_MASK) + count > MACSIM_TRACE_RING_SIZE)
+			count = MACSIM_TRACE_RING_SIZE - (tail & MACSIM_TRACE_MASK);
+		if(fwrite(&trace->records[tail & MACSIM_TRACE_MASK], sizeof(struct macsim_trace_record_t), count, trace->file) != count)
+			fatal("%s: can't write trace file", __func__);
+		tail += count;
+		atomic_store_explicit(&trace->tail, tail, memory_order_release);
+	}
+	return NULL;
+}
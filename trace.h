@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define MACSIM_TRACE_MAGIC "MACSIMTR"
+#define MACSIM_TRACE_VERSION 1
+#define MACSIM_TRACE_RING_SIZE (1 << 16) //Registros en el buffer circular (potencia de 2)
+
+/* Tipos de registro de la traza binaria */
+enum macsim_trace_op_t {
+	MACSIM_TRACE_STATION = 1, //Definición de estación: station = id, client = longitud del nombre, le siguen los bytes del nombre
+	MACSIM_TRACE_ENTER, //El cliente entra en la estación
+	MACSIM_TRACE_ENTER_QUEUED, //El cliente entra en la estación, en la que estaba encolado
+	MACSIM_TRACE_QUEUE, //El cliente se encola en la estación
+	MACSIM_TRACE_LEAVE //El cliente sale de la estación
+};
+
+/* Cabecera del fichero de traza */
+struct macsim_trace_header_t {
+	char magic[8]; //MACSIM_TRACE_MAGIC
+	int version; //MACSIM_TRACE_VERSION
+	int record_size; //sizeof(struct macsim_trace_record_t)
+};
+
+/* Registro de tamaño fijo de la traza binaria */
+struct macsim_trace_record_t {
+	long long time; //Instante del suceso en ns
+	long long client; //Id del cliente
+	long long response_time; //Tiempo de respuesta en ns (solo MACSIM_TRACE_LEAVE)
+	long long service_time; //Tiempo de servicio en ns (solo MACSIM_TRACE_LEAVE)
+	int kind; //Tipo del evento en curso
+	int station; //Id de la estación
+	int op; //enum macsim_trace_op_t
+	int reserved;
+};
+
+struct macsim_trace_t;
+
+/* Prototipos */
+struct macsim_trace_t * macsim_trace_open(const char *path);
+void macsim_trace_close(struct macsim_trace_t *trace);
+void macsim_trace_push(struct macsim_trace_t *trace, const struct macsim_trace_record_t *record);
+void macsim_trace_push_station(struct macsim_trace_t *trace, int id, const char *name);
+int macsim_trace_format(char *buf, int size, const struct macsim_trace_record_t *record, const char *station_name);
+
+#endif /* TRACE_H */
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "workload.h"
+#include "debug.h"
+
+#define MACSIM_WORKLOAD_BUFFER 4096 //Registros acumulados por el escritor antes de volcarlos
+
+/* Estructuras */
+/* Fichero de carga proyectado en memoria. Las columnas se leen directamente del fichero,
+ * así que solo están en RAM las páginas que el sistema operativo decida mantener. */
+struct macsim_workload_t {
+	void *map; //Proyección del fichero completo
+	size_t map_size;
+	long long count; //Número de registros
+	const long long *arrivals; //Instantes de llegada en ns
+	const long long *services; //Demandas de servicio en ns
+};
+
+/* Escritor de ficheros de carga. La columna de llegadas se escribe directamente en su sitio
+ * y la de servicios en un fichero temporal que se copia al cerrar. */
+struct macsim_workload_writer_t {
+	FILE *file;
+	FILE *services; //Fichero temporal con la columna de servicios
+	long long count;
+	long long last_arrival;
+	int arrival_count, service_count;
+	long long arrival_buffer[MACSIM_WORKLOAD_BUFFER];
+	long long service_buffer[MACSIM_WORKLOAD_BUFFER];
+};
+
+
+/* Funciones */
+/* Abre y proyecta en memoria un fichero de carga
+ * @return La carga o NULL si el fichero no existe o no es válido */
+struct macsim_workload_t * macsim_workload_open(const char *path){
+	struct macsim_workload_t *workload;
+	const struct macsim_workload_header_t *header;
+	struct stat st;
+	size_t column_size; //Registros que caben tras la cabecera
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) || st.st_size < (off_t) sizeof(struct macsim_workload_header_t)){
+		close(fd);
+		return NULL;
+	}
+
+	workload = (struct macsim_workload_t *) calloc(1, sizeof(struct macsim_workload_t));
+	if(!workload)
+		fatal("%s: out of memory", __func__);
+	workload->map_size = st.st_size;
+	workload->map = mmap(NULL, workload->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(workload->map == MAP_FAILED){
+		free(workload);
+		return NULL;
+	}
+
+	/* Comprobar la cabecera y que las columnas caben en el fichero. La cabecera viene de fuera, así
+	 * que se acotan el número de registros y las posiciones antes de operar con ellos, para que
+	 * ninguna cuenta se desborde. */
+	header = (const struct macsim_workload_header_t *) workload->map;
+	column_size = (workload->map_size - sizeof(*header)) / sizeof(long long);
+	if(memcmp(header->magic, MACSIM_WORKLOAD_MAGIC, sizeof(header->magic)) || header->version != MACSIM_WORKLOAD_VERSION ||
+			header->count < 0 || (unsigned long long) header->count > column_size ||
+			header->arrival_offset < (long long) sizeof(*header) || (unsigned long long) header->arrival_offset > workload->map_size ||
+			header->service_offset < (long long) sizeof(*header) || (unsigned long long) header->service_offset > workload->map_size ||
+			header->arrival_offset % sizeof(long long) || header->service_offset % sizeof(long long) ||
+			(workload->map_size - header->arrival_offset) / sizeof(long long) < (unsigned long long) header->count ||
+			(workload->map_size - header->service_offset) / sizeof(long long) < (unsigned long long) header->count){
+		macsim_workload_close(workload);
+		return NULL;
+	}
+	workload->count = header->count;
+	workload->arrivals = (const long long *) ((const char *) workload->map + header->arrival_offset);
+	workload->services = (const long long *) ((const char *) workload->map + header->service_offset);
+
+	/* La carga se recorre en orden */
+	madvise(workload->map, workload->map_size, MADV_SEQUENTIAL);
+	return workload;
+}
+
+
+/* Deshace la proyección y libera la carga */
+void macsim_workload_close(struct macsim_workload_t *workload){
+	munmap(workload->map, workload->map_size);
+	free(workload);
+}
+
+
+/* Devuelve el número de registros de la carga */
+long long macsim_workload_count(struct macsim_workload_t *workload){
+	return workload->count;
+}
+
+
+/* Devuelve el instante de llegada del registro \i en ns, tal como figura en el fichero */
+long long macsim_workload_arrival_ns(struct macsim_workload_t *workload, long long i){
+	if(i < 0 || i >= workload->count)
+		fatal("%s: record %lld out of bounds", __func__, i);
+	return workload->arrivals[i];
+}
+
+
+/* Devuelve la demanda de servicio del registro \i en ns */
+long long macsim_workload_service_ns(struct macsim_workload_t *workload, long long i){
+	if(i < 0 || i >= workload->count)
+		fatal("%s: record %lld out of bounds", __func__, i);
+	return workload->services[i];
+}
+
+
+/* Devuelve la demanda de servicio del registro \i en ms, como espera macsim_schedule */
+double macsim_workload_service(struct macsim_workload_t *workload, long long i){
+	return macsim_workload_service_ns(workload, i) / 1000000.0;
+}
+
+
+/* Crea un fichero de carga vacío
+ * @return El escritor o NULL si no se puede crear el fichero */
+struct macsim_workload_writer_t * macsim_workload_writer_create(const char *path){
+	struct macsim_workload_writer_t *writer;
+	struct macsim_workload_header_t header;
+
+	writer = (struct macsim_workload_writer_t *) calloc(1, sizeof(struct macsim_workload_writer_t));
+	if(!writer)
+		fatal("%s: out of memory", __func__);
+	writer->file = fopen(path, "wb");
+	if(!writer->file){
+		free(writer);
+		return NULL;
+	}
+	writer->services = tmpfile();
+	if(!writer->services)
+		fatal("%s: can't create temporary file", __func__);
+
+	/* La cabecera definitiva se escribe al cerrar */
+	memset(&header, 0, sizeof(header));
+	if(fwrite(&header, sizeof(header), 1, writer->file) != 1)
+		fatal("%s: can't write workload file", __func__);
+	return writer;
+}
+
+
+/* Añade un registro. Los instantes de llegada deben ser no decrecientes. */
+void macsim_workload_writer_append(struct macsim_workload_writer_t *writer, long long arrival_ns, long long service_ns){
+	if(writer->count && arrival_ns < writer->last_arrival)
+		fatal("%s: arrivals must be non-decreasing", __func__);
+	if(service_ns < 0)
+		fatal("%s: negative service demand", __func__);
+
+	writer->arrival_buffer[writer->arrival_count++] = arrival_ns;
+	writer->service_buffer[writer->service_count++] = service_ns;
+	writer->last_arrival = arrival_ns;
+	writer->count++;
+
+	if(writer->arrival_count == MACSIM_WORKLOAD_BUFFER){
+		if(fwrite(writer->arrival_buffer, sizeof(long long), writer->arrival_count, writer->file) != writer->arrival_count ||
+				fwrite(writer->service_buffer, sizeof(long long), writer->service_count, writer->services) != writer->service_count)
+			fatal("%s: can't write workload file", __func__);
+		writer->arrival_count = writer->service_count = 0;
+	}
+}
+
+
+/* Completa el fichero de carga: añade la columna de servicios y escribe la cabecera */
+void macsim_workload_writer_close(struct macsim_workload_writer_t *writer){
+	struct macsim_workload_header_t header;
+	size_t n;
+
+	/* Vaciar los buffers */
+	if(fwrite(writer->arrival_buffer, sizeof(long long), writer->arrival_count, writer->file) != writer->arrival_count ||
+			fwrite(writer->service_buffer, sizeof(long long), writer->service_count, writer->services) != writer->service_count)
+		fatal("%s: can't write workload file", __func__);
+
+	/* Copiar la columna de servicios */
+	rewind(writer->services);
+	while((n = fread(writer->service_buffer, sizeof(long long), MACSIM_WORKLOAD_BUFFER, writer->services)) > 0){
+		if(fwrite(writer->service_buffer, sizeof(long long), n, writer->file) != n)
+			fatal("%s: can't write workload file", __func__);
+	}
+	fclose(writer->services);
+
+	/* Cabecera */
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MACSIM_WORKLOAD_MAGIC, sizeof(header.magic));
+	header.version = MACSIM_WORKLOAD_VERSION;
+	header.count = writer->count;
+	header.arrival_offset = sizeof(header);
+	header.service_offset = sizeof(header) + writer->count * sizeof(long long);
+	rewind(writer->file);
+	if(fwrite(&header, sizeof(header), 1, writer->file) != 1 || fclose(writer->file))
+		fatal("%s: can't write workload file", __func__);
+	free(writer);
+}
@@ -0,0 +1,34 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#define MACSIM_WORKLOAD_MAGIC "MACSIMWL"
+#define MACSIM_WORKLOAD_VERSION 1
+
+/* Cabecera del fichero de carga.
+ * Tras la cabecera van dos columnas de \count enteros de 64 bits:
+ * los instantes de llegada en ns (no decrecientes) y las demandas de servicio en ns. */
+struct macsim_workload_header_t {
+	char magic[8]; //MACSIM_WORKLOAD_MAGIC
+	int version; //MACSIM_WORKLOAD_VERSION
+	int reserved;
+	long long count; //Número de registros
+	long long arrival_offset; //Posición en bytes de la columna de llegadas
+	long long service_offset; //Posición en bytes de la columna de servicios
+};
+
+struct macsim_workload_t;
+struct macsim_workload_writer_t;
+
+/* Prototipos */
+struct macsim_workload_t * macsim_workload_open(const char *path);
+void macsim_workload_close(struct macsim_workload_t *workload);
+long long macsim_workload_count(struct macsim_workload_t *workload);
+long long macsim_workload_arrival_ns(struct macsim_workload_t *workload, long long i);
+long long macsim_workload_service_ns(struct macsim_workload_t *workload, long long i);
+double macsim_workload_service(struct macsim_workload_t *workload, long long i);
+
+struct macsim_workload_writer_t * macsim_workload_writer_create(const char *path);
+void macsim_workload_writer_append(struct macsim_workload_writer_t *writer, long long arrival_ns, long long service_ns);
+void macsim_workload_writer_close(struct macsim_workload_writer_t *writer);
+
+#endif /* WORKLOAD_H */